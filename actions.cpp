@@ -0,0 +1,55 @@
+#include "objectdata.h"
+#include "proximity.h"
+
+#include <algorithm>
+#include <vector>
+
+using namespace ObjData;
+
+void Seek::execute(State &st, int self, const CollisionEvts &, const ProximityIndex &near) const
+{
+    auto &so = st.slots_[self];
+    Point2D direction = direction_;
+    if (object_)
+    {
+        // the index is the one of the start of the phase : skip what was
+        // freed since, or spawned again as another type
+        auto sought = [&](int slot)
+        {
+            return slot != self && st.live(slot) && (target_ < 0 || st.slots_[slot].type_ == target_);
+        };
+        // reused by every call of the thread
+        thread_local std::vector<int> found;
+        found.clear();
+        auto target = found.end();
+        for (int k = 2; target == found.end() && k <= 2 * near.count(target_); k *= 2)
+        {
+            found.clear();
+            near.nearest(target_, near.pos(self), k, found);
+            target = std::find_if(found.begin(), found.end(), sought);
+        }
+        if (target != found.end())
+        {
+            auto delta = st.slots_[*target].pos_ - so.pos_;
+            auto norm = hypot(delta);
+            if (norm != 0)
+                direction = delta / norm;
+        }
+    }
+
+    // turns by max_rotation_ grads a tick at most, 0 for no limit
+    auto speed = hypot(so.speed_);
+    if (max_rotation_ > 0 && speed != 0 && direction != Point2D())
+    {
+        auto heading = so.speed_ / speed;
+        auto turn = direction * conj(heading);
+        if (turn.real() < cos(max_rotation_))
+            direction = heading * expj(turn.imag() < 0 ? -max_rotation_ : max_rotation_);
+    }
+
+    so.speed_ += direction * acceleration_;
+    speed = hypot(so.speed_);
+    if (speed > max_speed_)
+        so.speed_ = so.speed_ * max_speed_ / speed;
+    so.pos_ += so.speed_;
+}
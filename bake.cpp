@@ -0,0 +1,377 @@
+#include "bake.h"
+#include "mask_names.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <random>
+#include <sstream>
+
+using namespace ObjData;
+namespace fs = std::filesystem;
+
+namespace
+{
+    constexpr uint32_t image_magic = 0x31474d49; // IMG1
+    // to be bumped when the baked data change, invalidates the cache
+    constexpr uint64_t version = 1;
+
+    struct Layer
+    {
+        // "" for the colour, "depth" or the name of a mask
+        std::string suffix_;
+        fs::path path_;
+    };
+
+    struct Asset
+    {
+        std::string name_;
+        std::vector<Layer> layers_;
+        std::vector<std::string> contents_;
+        uint64_t hash_{0};
+    };
+
+    struct Pam
+    {
+        int w_{0}, h_{0}, depth_{0};
+        const uint8_t *data_{nullptr};
+    };
+
+    bool read_file(const fs::path &path, std::string &content)
+    {
+        FILE *file = std::fopen(path.c_str(), "rb");
+        if (!file)
+            return false;
+        content.clear();
+        char buffer[1 << 16];
+        size_t n;
+        while ((n = std::fread(buffer, 1, sizeof(buffer), file)))
+            content.append(buffer, n);
+        bool ok = !std::ferror(file);
+        std::fclose(file);
+        return ok;
+    }
+
+    bool write_file(const fs::path &path, const std::string &content)
+    {
+        FILE *file = std::fopen(path.c_str(), "wb");
+        if (!file)
+            return false;
+        bool ok = std::fwrite(content.data(), 1, content.size(), file) == content.size();
+        return std::fclose(file) == 0 && ok;
+    }
+
+    /* P7 with a MAXVAL of 255 only */
+    bool parse_pam(const std::string &content, Pam &pam)
+    {
+        size_t end = content.find("ENDHDR\n");
+        if (content.compare(0, 3, "P7\n") || end == std::string::npos)
+            return false;
+        std::istringstream header(content.substr(3, end - 3));
+        std::string token;
+        int maxval = 0;
+        while (header >> token)
+        {
+            if (token == "WIDTH")
+                header >> pam.w_;
+            else if (token == "HEIGHT")
+                header >> pam.h_;
+            else if (token == "DEPTH")
+                header >> pam.depth_;
+            else if (token == "MAXVAL")
+                header >> maxval;
+            else
+                std::getline(header, token);
+        }
+        size_t offset = end + 7;
+        if (maxval != 255 || pam.w_ <= 0 || pam.h_ <= 0 || pam.depth_ <= 0
+            || content.size() - offset < size_t(pam.w_) * pam.h_ * pam.depth_)
+            return false;
+        pam.data_ = reinterpret_cast<const uint8_t *>(content.data() + offset);
+        return true;
+    }
+
+    // FNV-1a
+    uint64_t hash(uint64_t result, const void *data, size_t size)
+    {
+        auto bytes = static_cast<const uint8_t *>(data);
+        for (size_t i = 0; i != size; ++i)
+        {
+            result ^= bytes[i];
+            result *= 0x100000001b3;
+        }
+        return result;
+    }
+
+    std::string hex(uint64_t number)
+    {
+        char buffer[17];
+        std::snprintf(buffer, sizeof(buffer), "%016" PRIx64, number);
+        return buffer;
+    }
+
+    /* the sources grouped by asset, in name order */
+    std::vector<Asset> assets(const fs::path &source)
+    {
+        std::map<std::string, Asset> result;
+        std::error_code error;
+        for (const auto &entry : fs::directory_iterator(source, error))
+        {
+            const auto &path = entry.path();
+            if (!entry.is_regular_file() || path.extension() != ".pam")
+                continue;
+            std::string stem = path.stem().string();
+            size_t dot = stem.find('.');
+            std::string name = stem.substr(0, dot);
+            std::string suffix = dot == std::string::npos ? "" : stem.substr(dot + 1);
+            auto &asset = result[name];
+            asset.name_ = name;
+            asset.layers_.push_back({suffix, path});
+        }
+
+        std::vector<Asset> sorted;
+        for (auto &[name, asset] : result)
+        {
+            std::sort(asset.layers_.begin(),
+                      asset.layers_.end(),
+                      [](const Layer &layer1, const Layer &layer2)
+                      {
+                          return layer1.suffix_ < layer2.suffix_;
+                      });
+            sorted.push_back(std::move(asset));
+        }
+        return sorted;
+    }
+
+    std::string sprites(const Image &image, int cell)
+    {
+        int w_cell = cell ? cell : image.w_;
+        int h_cell = cell ? cell : image.h_;
+        std::string result;
+        for (int y0 = 0; y0 < image.h_; y0 += h_cell)
+        {
+            for (int x0 = 0; x0 < image.w_; x0 += w_cell)
+            {
+                int x1 = INT32_MAX, y1 = INT32_MAX, x2 = -1, y2 = -1;
+                for (int y = y0; y < std::min(image.h_, y0 + h_cell); ++y)
+                {
+                    for (int x = x0; x < std::min(image.w_, x0 + w_cell); ++x)
+                    {
+                        if (!image.content_[x + y * image.stride_].a_)
+                            continue;
+                        x1 = std::min(x1, x);
+                        y1 = std::min(y1, y);
+                        x2 = std::max(x2, x);
+                        y2 = std::max(y2, y);
+                    }
+                }
+                if (x2 >= 0)
+                    result += std::to_string(x1) + ' ' + std::to_string(y1) + ' '
+                              + std::to_string(x2) + ' ' + std::to_string(y2) + '\n';
+            }
+        }
+        return result;
+    }
+
+    bool bake(const Asset &asset,
+              int cell,
+              const fs::path &img,
+              const fs::path &sprites_path)
+    {
+        Pam colour;
+        if (asset.layers_.empty() || !asset.layers_[0].suffix_.empty()
+            || !parse_pam(asset.contents_[0], colour) || colour.depth_ != 4)
+            return false;
+
+        Image image;
+        image.w_ = colour.w_;
+        image.h_ = colour.h_;
+        image.stride_ = colour.w_;
+        image.content_.assign(size_t(image.w_) * image.h_, Pixel{});
+        for (size_t i = 0; i != image.content_.size(); ++i)
+        {
+            auto &pixel = image.content_[i];
+            pixel.r_ = colour.data_[i * 4];
+            pixel.g_ = colour.data_[i * 4 + 1];
+            pixel.b_ = colour.data_[i * 4 + 2];
+            pixel.a_ = colour.data_[i * 4 + 3];
+        }
+
+        const auto &masks = mask_names();
+        for (size_t l = 1; l != asset.layers_.size(); ++l)
+        {
+            const auto &suffix = asset.layers_[l].suffix_;
+            auto mask = masks.find(suffix);
+            Pam layer;
+            if ((suffix != "depth" && mask == masks.end())
+                || !parse_pam(asset.contents_[l], layer)
+                || layer.w_ != image.w_
+                || layer.h_ != image.h_)
+                return false;
+            for (size_t i = 0; i != image.content_.size(); ++i)
+            {
+                uint8_t value = layer.data_[i * layer.depth_];
+                auto &pixel = image.content_[i];
+                if (suffix == "depth")
+                    pixel.depth_ = value;
+                else if (value)
+                    pixel.masks_ |= 1 << mask->second;
+            }
+        }
+
+        return Bake::write_image(img, image) && write_file(sprites_path, sprites(image, cell));
+    }
+}
+
+bool Bake::write_image(const std::string &path, const Image &image)
+{
+    FILE *file = std::fopen(path.c_str(), "wb");
+    if (!file)
+        return false;
+    uint32_t header[3] = {image_magic, uint32_t(image.w_), uint32_t(image.h_)};
+    bool ok = std::fwrite(header, sizeof(header), 1, file) == 1;
+    for (int y = 0; ok && y != image.h_; ++y)
+        ok = std::fwrite(&image.content_[y * image.stride_], sizeof(Pixel), image.w_, file) == size_t(image.w_);
+    return std::fclose(file) == 0 && ok;
+}
+
+bool Bake::read_image(const std::string &path, Image &image)
+{
+    FILE *file = std::fopen(path.c_str(), "rb");
+    if (!file)
+        return false;
+    uint32_t header[3];
+    bool ok = std::fread(header, sizeof(header), 1, file) == 1
+              && header[0] == image_magic
+              && header[1] < 65536
+              && header[2] < 65536;
+    if (ok)
+    {
+        image.w_ = image.stride_ = header[1];
+        image.h_ = header[2];
+        image.content_.resize(size_t(image.w_) * image.h_);
+        ok = std::fread(image.content_.data(), sizeof(Pixel), image.content_.size(), file)
+             == image.content_.size();
+    }
+    std::fclose(file);
+    return ok;
+}
+
+Bake::Report Bake::run(const Options &options, ThreadPool &pool)
+{
+    auto start = std::chrono::steady_clock::now();
+    Report report;
+    const fs::path output(options.output_);
+    const fs::path cache(options.cache_);
+    std::error_code error;
+    fs::create_directories(output, error);
+    fs::create_directories(cache, error);
+    // temporary files are unique to the run and the asset : assets of
+    // the same contents, or other runs, bake into the same cache
+    std::random_device device;
+    const std::string run_id = hex(uint64_t(device()) << 32 | device());
+
+    // hash of every asset at the previous run
+    std::map<std::string, std::string> index;
+    std::string content;
+    if (read_file(cache / "index", content))
+    {
+        std::istringstream lines(content);
+        std::string name, h;
+        while (lines >> name >> h)
+            index[name] = h;
+    }
+
+    auto all = assets(options.source_);
+    enum Result { BAKED, CACHED, SKIPPED, FAILED };
+    std::vector<Result> results(all.size(), FAILED);
+
+    pool.run(all.size(), [&](int i)
+    {
+        auto &asset = all[i];
+        uint64_t h = hash(0xcbf29ce484222325, &version, sizeof(version));
+        h = hash(h, &options.cell_, sizeof(options.cell_));
+        asset.contents_.resize(asset.layers_.size());
+        for (size_t l = 0; l != asset.layers_.size(); ++l)
+        {
+            if (!read_file(asset.layers_[l].path_, asset.contents_[l]))
+                return;
+            const auto &suffix = asset.layers_[l].suffix_;
+            h = hash(h, suffix.c_str(), suffix.size() + 1);
+            h = hash(h, asset.contents_[l].data(), asset.contents_[l].size());
+        }
+        asset.hash_ = h;
+
+        auto img = output / (asset.name_ + ".img");
+        auto sprites_path = output / (asset.name_ + ".sprites");
+        auto it = index.find(asset.name_);
+        std::error_code error;
+        if (it != index.end() && it->second == hex(h)
+            && fs::exists(img, error) && fs::exists(sprites_path, error))
+        {
+            results[i] = SKIPPED;
+            return;
+        }
+
+        auto cached_img = cache / (hex(h) + ".img");
+        auto cached_sprites = cache / (hex(h) + ".sprites");
+        results[i] = CACHED;
+        if (!fs::exists(cached_img, error) || !fs::exists(cached_sprites, error))
+        {
+            // written aside then renamed, another run may read the cache
+            auto tmp = cache / (hex(h) + '.' + run_id + '.' + std::to_string(i));
+            auto tmp_img = tmp.string() + ".img.tmp";
+            auto tmp_sprites = tmp.string() + ".sprites.tmp";
+            bool baked = bake(asset, options.cell_, tmp_img, tmp_sprites);
+            std::error_code img_error, sprites_error;
+            if (baked)
+            {
+                fs::rename(tmp_img, cached_img, img_error);
+                fs::rename(tmp_sprites, cached_sprites, sprites_error);
+            }
+            if (!baked || img_error || sprites_error)
+            {
+                fs::remove(tmp_img, error);
+                fs::remove(tmp_sprites, error);
+                results[i] = FAILED;
+                return;
+            }
+            results[i] = BAKED;
+        }
+        std::error_code img_error, sprites_error;
+        fs::copy_file(cached_img, img, fs::copy_options::overwrite_existing, img_error);
+        fs::copy_file(cached_sprites, sprites_path, fs::copy_options::overwrite_existing, sprites_error);
+        if (img_error || sprites_error)
+            results[i] = FAILED;
+    });
+
+    std::string lines;
+    for (size_t i = 0; i != all.size(); ++i)
+    {
+        switch (results[i])
+        {
+        case BAKED:
+            report.baked_++;
+            break;
+        case CACHED:
+            report.cached_++;
+            break;
+        case SKIPPED:
+            report.skipped_++;
+            break;
+        case FAILED:
+            report.failed_++;
+            continue;
+        }
+        lines += all[i].name_ + ' ' + hex(all[i].hash_) + '\n';
+    }
+    write_file(cache / "index", lines);
+
+    report.seconds_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return report;
+}
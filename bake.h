@@ -0,0 +1,46 @@
+#pragma once
+
+#include <string>
+
+#include "objectdata.h"
+
+class ThreadPool;
+
+/* Offline baking of layered source art into the engine's images.
+
+   An asset "name" of the source directory is made of PAM files :
+   name.pam         colour, RGB_ALPHA, required
+   name.depth.pam   depth, from the first channel
+   name.<mask>.pam  one per mask ('wall', 'ground'...), set where the
+                    first channel is not 0
+
+   It bakes into name.img, see write_image, and name.sprites : one line
+   "x1 y1 x2 y2" per cell of the grid holding opaque pixels, the corners
+   included. Assets whose layers did not change are skipped, and known
+   contents are taken from the cache directory, keyed by their hash. */
+namespace Bake
+{
+    struct Options
+    {
+        std::string source_;
+        std::string output_;
+        std::string cache_;
+        // 0 for a single sprite per image
+        int cell_{0};
+    };
+
+    struct Report
+    {
+        int baked_{0};
+        int cached_{0};
+        int skipped_{0};
+        int failed_{0};
+        double seconds_{0};
+    };
+
+    /* "IMG1", width, height as uint32_t, then the pixels, row major */
+    bool write_image(const std::string &path, const ObjData::Image &image);
+    bool read_image(const std::string &path, ObjData::Image &image);
+
+    Report run(const Options &options, ThreadPool &pool);
+}
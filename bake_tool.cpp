@@ -0,0 +1,32 @@
+#include "bake.h"
+#include "thread_pool.h"
+
+#include <cstdio>
+#include <string>
+
+/* bake_tool source output cache [cell] */
+int main(int argc, char **argv)
+{
+    if (argc < 4)
+    {
+        std::fprintf(stderr, "usage : %s source output cache [cell]\n", argv[0]);
+        return 2;
+    }
+
+    Bake::Options options;
+    options.source_ = argv[1];
+    options.output_ = argv[2];
+    options.cache_ = argv[3];
+    if (argc > 4)
+        options.cell_ = std::stoi(argv[4]);
+
+    ThreadPool pool;
+    auto report = Bake::run(options, pool);
+    std::printf("%d baked, %d from the cache, %d unchanged, %d failed in %.3f s\n",
+                report.baked_,
+                report.cached_,
+                report.skipped_,
+                report.failed_,
+                report.seconds_);
+    return report.failed_ ? 1 : 0;
+}
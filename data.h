@@ -1,6 +1,9 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <cstdint>
+#include <cstring>
 #include "point.h"
 #include <vector>
 #include <map>
@@ -10,12 +13,17 @@ struct StateObject
     Point2D pos_;
     Point2D speed_;
     uint32_t state_ : 8;
-    uint32_t state_no_ : 7;
-    uint32_t src_ : 9;
+    uint32_t state_no_ : 8;
     uint32_t type_ : 8;
+    // ticks without change, see BasicState::asleep
+    uint32_t idle_ : 8;
     uint32_t action_;
     uint32_t mvt_[2];
-}; //32o
+    uint32_t src_;
+    // bit m - WALL set when a spot touched mask m at the previous
+    // collision pass, see BasicState::touching
+    uint32_t contacts_;
+}; //40o
 
 struct KeyStrokes
 {
@@ -34,45 +42,492 @@ struct Character
     StateObject state_;
 };
 
-struct State
+enum ID_RNG
 {
-    static constexpr int nb_slots_ = 256;
-    static constexpr int nb_vars_ = 256;
+    RNG_LCG,
+    RNG_COUNTER
+};
+
+namespace ObjData
+{
+    class Level;
+    class CollisionCache;
+}
+
+class DependencyLog;
+
+/* capacity is per build, see STATE_SLOTS : 256 objects for small levels,
+   up to 64k for large ones. A tick costs in proportion to the live
+   slots, not to the capacity */
+template <int NbSlots, int NbVars>
+struct BasicState
+{
+    static constexpr int nb_slots_ = NbSlots;
+    static constexpr int nb_vars_ = NbVars;
+    static constexpr int nb_players_ = 2;
+    // number of ticks without change before an object falls asleep
+    static constexpr int sleep_ticks_ = 16;
+    static constexpr int nb_words_ = (nb_slots_ + 63) / 64;
+    static constexpr int nb_summaries_ = (nb_words_ + 63) / 64;
+    static constexpr int max_touching_ = 2 * nb_slots_;
+
+    static_assert(nb_slots_ <= 65536);
+
     std::array<StateObject, nb_slots_> slots_;
     std::array<int32_t, nb_vars_> var_;
+    // occupancy : bit i of used_ is set when slot i is live, bit j of
+    // full_ (any_) when word j of used_ is full (not empty)
+    std::array<uint64_t, nb_words_> used_;
+    std::array<uint64_t, nb_summaries_> full_;
+    std::array<uint64_t, nb_summaries_> any_;
+    std::array<KeyStrokes, nb_players_> keys_;
     int32_t xscreen_;
     int32_t yscreen_;
     int32_t timestamp_;
+    // RNG_LCG : state of the shared generator, kept for the replays
+    // recorded with it. RNG_COUNTER : seed, never modified
     uint32_t rnd_;
+    uint32_t rng_;
+    // scratch of compute : the draws of every slot this tick, the rules'
+    // last, and the slot executing, see rnd(slot). compute zeroes the
+    // live slots' at the start of a tick, allocate a spawn's
+    std::array<uint32_t, nb_slots_ + 1> draws_;
+    int32_t drawing_;
+    // touching_key of the contacts of the previous collision pass,
+    // sorted. Past max_touching_, the last ones are dropped : they
+    // enter again at the next pass and never exit
+    std::array<uint64_t, max_touching_> touching_;
+    uint32_t nb_touching_;
+    // one past the highest slot allocate() gave since it was last
+    // reset. Scratch of compute : where a block may have spawned
+    int32_t allocated_;
+
+    void clear()
+    {
+        for (auto &so : slots_)
+        {
+            so = StateObject{};
+            so.type_ = 255;
+        }
+        var_.fill(0);
+        used_.fill(0);
+        full_.fill(0);
+        any_.fill(0);
+        draws_.fill(0);
+        drawing_ = nb_slots_;
+        nb_touching_ = 0;
+        allocated_ = 0;
+        // slots past the capacity are never free
+        if (nb_slots_ % 64)
+            used_.back() = ~uint64_t(0) << (nb_slots_ % 64);
+        for (int word = 0; word != nb_words_; ++word)
+            update_summaries(word);
+        keys_.fill(KeyStrokes{});
+        xscreen_ = 0;
+        yscreen_ = 0;
+        timestamp_ = 0;
+        rnd_ = 0;
+        rng_ = RNG_LCG;
+    }
+
+    bool live(int slot) const
+    {
+        return used_[slot / 64] >> (slot % 64) & 1;
+    }
+
+    /* first live slot from slot on, nb_slots_ if none */
+    int next_live(int slot) const
+    {
+        if (slot >= nb_slots_)
+            return nb_slots_;
+        int word = slot / 64;
+        uint64_t bits = used_[word] & (~uint64_t(0) << (slot % 64));
+        while (!bits)
+        {
+            word = next_word(any_, word + 1, false);
+            if (word == nb_words_)
+                return nb_slots_;
+            bits = used_[word];
+        }
+        int result = word * 64 + __builtin_ctzll(bits);
+        return result < nb_slots_ ? result : nb_slots_;
+    }
+
+    int nb_live() const
+    {
+        int result = 0;
+        for (uint64_t word : used_)
+            result += __builtin_popcountll(word);
+        if (nb_slots_ % 64)
+            result -= 64 - nb_slots_ % 64;
+        return result;
+    }
+
+    /* writes a slot, live or not depending on so.type_ */
+    void set(int slot, const StateObject &so)
+    {
+        slots_[slot] = so;
+        uint64_t bit = uint64_t(1) << (slot % 64);
+        if (so.type_ == 255)
+            used_[slot / 64] &= ~bit;
+        else
+            used_[slot / 64] |= bit;
+        update_summaries(slot / 64);
+    }
 
     int allocate(StateObject so)
     {
-        for (int i = 0; i != nb_slots_; ++i)
-            if (slots_[i].type_ == 255)
-            {
-                slots_[i] = so;
-                return i;
-            }
+        for (int word = next_word(full_, 0, true);
+             word != nb_words_;
+             word = next_word(full_, word + 1, true))
+        {
+            uint64_t free_bits = ~used_[word];
+            if (!free_bits)
+                continue;
+            int slot = word * 64 + __builtin_ctzll(free_bits);
+            so.idle_ = 0;
+            so.contacts_ = 0;
+            set(slot, so);
+            draws_[slot] = 0;
+            allocated_ = std::max(allocated_, slot + 1);
+            return slot;
+        }
         return -1;
     }
 
     bool free(int slot)
     {
-        if (slots_[slot].type_ == -1)
+        if (!live(slot))
             return false;
-        slots_[slot].type_ = 255;
+        StateObject so = slots_[slot];
+        so.type_ = 255;
+        set(slot, so);
         return true;
     }
 
+    /* mask_owner -1 for the map */
+    static uint64_t touching_key(int spot_owner, int mask_owner, int mask)
+    {
+        return uint64_t(spot_owner) << 32 | uint64_t(mask_owner + 1) << 8 | uint32_t(mask);
+    }
+
+    /* spot_owner touched mask of mask_owner at the previous collision
+       pass, or a slot since freed did */
+    bool touching(int spot_owner, int mask_owner, int mask) const
+    {
+        return std::binary_search(touching_.begin(),
+                                  touching_.begin() + nb_touching_,
+                                  touching_key(spot_owner, mask_owner, mask));
+    }
+
+    bool asleep(int slot) const
+    {
+        return slots_[slot].idle_ >= sleep_ticks_;
+    }
+
+    void wake(int slot)
+    {
+        slots_[slot].idle_ = 0;
+    }
+
+    /* FNV-1a, field by field to stay clear of padding */
+    uint64_t hash() const
+    {
+        return hash(true);
+    }
+
+    /* what hash() reads, compared : tells a collision of hash() apart */
+    bool same(const BasicState &other) const
+    {
+        if (used_ != other.used_ || nb_touching_ != other.nb_touching_)
+            return false;
+        for (int slot = next_live(0); slot != nb_slots_; slot = next_live(slot + 1))
+            if (std::memcmp(&slots_[slot], &other.slots_[slot], sizeof(StateObject)))
+                return false;
+        return std::equal(touching_.begin(), touching_.begin() + nb_touching_, other.touching_.begin())
+               && var_ == other.var_
+               && !std::memcmp(keys_.data(), other.keys_.data(), sizeof(keys_))
+               && xscreen_ == other.xscreen_
+               && yscreen_ == other.yscreen_
+               && timestamp_ == other.timestamp_
+               && rnd_ == other.rnd_
+               && rng_ == other.rng_;
+    }
+
+    /* hash() but for timestamp_ : the same position reached at another
+       tick. Tile animations and RNG_COUNTER draws depend on the tick,
+       such positions only play the same way most of the time */
+    uint64_t position_hash() const
+    {
+        return hash(false);
+    }
+
+    /* only live slots and non null vars are written, the size follows
+       the number of objects and not the capacity */
+    std::vector<uint8_t> serialize() const
+    {
+        std::vector<uint8_t> result;
+        auto put = [&result](const void *data, size_t size)
+        {
+            auto *bytes = static_cast<const uint8_t *>(data);
+            result.insert(result.end(), bytes, bytes + size);
+        };
+        put(keys_.data(), sizeof(keys_));
+        put(&xscreen_, sizeof(xscreen_));
+        put(&yscreen_, sizeof(yscreen_));
+        put(&timestamp_, sizeof(timestamp_));
+        put(&rnd_, sizeof(rnd_));
+
+        uint32_t nb_vars = 0;
+        for (int32_t value : var_)
+            nb_vars += value != 0;
+        put(&nb_vars, sizeof(nb_vars));
+        for (uint32_t var = 0; var != nb_vars_; ++var)
+        {
+            if (!var_[var])
+                continue;
+            put(&var, sizeof(var));
+            put(&var_[var], sizeof(int32_t));
+        }
+
+        uint32_t nb_live = this->nb_live();
+        put(&nb_live, sizeof(nb_live));
+        for (uint32_t slot = next_live(0); slot != nb_slots_; slot = next_live(slot + 1))
+        {
+            put(&slot, sizeof(slot));
+            put(&slots_[slot], sizeof(StateObject));
+        }
+        put(&nb_touching_, sizeof(nb_touching_));
+        put(touching_.data(), nb_touching_ * sizeof(uint64_t));
+        if (rng_ != RNG_LCG)
+            put(&rng_, sizeof(rng_));
+        return result;
+    }
+
+    bool deserialize(const std::vector<uint8_t> &data)
+    {
+        size_t offset = 0;
+        auto get = [&data, &offset](void *value, size_t size)
+        {
+            if (offset + size > data.size())
+                return false;
+            std::memcpy(value, data.data() + offset, size);
+            offset += size;
+            return true;
+        };
+
+        clear();
+        uint32_t count;
+        if (!get(keys_.data(), sizeof(keys_))
+            || !get(&xscreen_, sizeof(xscreen_))
+            || !get(&yscreen_, sizeof(yscreen_))
+            || !get(&timestamp_, sizeof(timestamp_))
+            || !get(&rnd_, sizeof(rnd_))
+            || !get(&count, sizeof(count)))
+            return false;
+        for (uint32_t i = 0; i != count; ++i)
+        {
+            uint32_t var;
+            int32_t value;
+            if (!get(&var, sizeof(var)) || !get(&value, sizeof(value)) || var >= nb_vars_)
+                return false;
+            var_[var] = value;
+        }
+        if (!get(&count, sizeof(count)))
+            return false;
+        for (uint32_t i = 0; i != count; ++i)
+        {
+            uint32_t slot;
+            StateObject so;
+            if (!get(&slot, sizeof(slot)) || !get(&so, sizeof(so)) || slot >= nb_slots_)
+                return false;
+            set(slot, so);
+        }
+        if (!get(&count, sizeof(count))
+            || count > max_touching_
+            || !get(touching_.data(), count * sizeof(uint64_t)))
+            return false;
+        nb_touching_ = count;
+        // absent for RNG_LCG
+        if (offset != data.size() && !get(&rng_, sizeof(rng_)))
+            return false;
+        return offset == data.size();
+    }
+
+    /* RNG_LCG : the shared generator. RNG_COUNTER : rnd(slot) for the
+       slot executing, the rules counting as slot nb_slots_ */
     uint32_t rnd()
     {
+        if (rng_ != RNG_LCG)
+            return rnd(drawing_);
         //Borland C https://en.wikipedia.org/wiki/Linear_congruential_generator
         rnd_ = rnd_ * 22695477 + 1;
         return rnd_;
     }
+
+    /* the next draw of slot, compute numbering the calls of every slot
+       from 0 each tick in draws_. Not to be mixed with explicit call
+       numbers for the same slot */
+    uint32_t rnd(int slot)
+    {
+        return rnd(slot, draws_[slot]++);
+    }
+
+    /* draw number call of slot during this tick. With RNG_COUNTER it only
+       depends on (rnd_, timestamp_, slot, call) : objects draw in any
+       order, on any thread, and resimulating one slot replays its draws.
+       With RNG_LCG call is ignored and the shared generator advances */
+    uint32_t rnd(int slot, uint32_t call)
+    {
+        if (rng_ == RNG_LCG)
+            return rnd();
+        return squares(counter(call), key(slot));
+    }
+
+    /* draws call to call + n - 1 of slot into out */
+    void rnd(int slot, uint32_t call, uint32_t *out, int n)
+    {
+        if (rng_ == RNG_LCG)
+        {
+            for (int i = 0; i != n; ++i)
+                out[i] = rnd();
+            return;
+        }
+        // independent lanes, left to the vectorizer
+        uint64_t first = counter(call);
+        uint64_t k = key(slot);
+        for (int i = 0; i != n; ++i)
+            out[i] = squares(first + uint32_t(i), k);
+    }
+
+private:
+    uint64_t hash(bool timestamp) const
+    {
+        uint64_t result = 14695981039346656037ull;
+        auto add = [&result](const void *data, size_t size)
+        {
+            auto *bytes = static_cast<const uint8_t *>(data);
+            for (size_t i = 0; i != size; ++i)
+                result = (result ^ bytes[i]) * 1099511628211ull;
+        };
+        for (int slot = next_live(0); slot != nb_slots_; slot = next_live(slot + 1))
+        {
+            add(&slot, sizeof(slot));
+            add(&slots_[slot], sizeof(StateObject));
+        }
+        add(&nb_touching_, sizeof(nb_touching_));
+        add(touching_.data(), nb_touching_ * sizeof(uint64_t));
+        add(var_.data(), sizeof(var_));
+        add(keys_.data(), sizeof(keys_));
+        add(&xscreen_, sizeof(xscreen_));
+        add(&yscreen_, sizeof(yscreen_));
+        if (timestamp)
+            add(&timestamp_, sizeof(timestamp_));
+        add(&rnd_, sizeof(rnd_));
+        // absent for RNG_LCG
+        if (rng_ != RNG_LCG)
+            add(&rng_, sizeof(rng_));
+        return result;
+    }
+
+    uint64_t counter(uint32_t call) const
+    {
+        return uint64_t(uint32_t(timestamp_)) << 32 | call;
+    }
+
+    /* splitmix64 of (seed, slot), odd */
+    uint64_t key(int slot) const
+    {
+        uint64_t z = (uint64_t(rnd_) << 32 | uint32_t(slot)) + 0x9E3779B97F4A7C15ull;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return (z ^ (z >> 31)) | 1;
+    }
+
+    // Squares, Widynski 2020 https://arxiv.org/abs/2004.06278
+    static uint32_t squares(uint64_t ctr, uint64_t key)
+    {
+        uint64_t x = ctr * key;
+        uint64_t y = x;
+        uint64_t z = y + key;
+        x = x * x + y;
+        x = (x >> 32) | (x << 32);
+        x = x * x + z;
+        x = (x >> 32) | (x << 32);
+        x = x * x + y;
+        x = (x >> 32) | (x << 32);
+        return (x * x + z) >> 32;
+    }
+
+    void update_summaries(int word)
+    {
+        uint64_t bit = uint64_t(1) << (word % 64);
+        if (used_[word] == ~uint64_t(0))
+            full_[word / 64] |= bit;
+        else
+            full_[word / 64] &= ~bit;
+        // ignores the slots past the capacity
+        uint64_t live_bits = used_[word];
+        if (word == nb_words_ - 1 && nb_slots_ % 64)
+            live_bits &= ~(~uint64_t(0) << (nb_slots_ % 64));
+        if (live_bits)
+            any_[word / 64] |= bit;
+        else
+            any_[word / 64] &= ~bit;
+    }
+
+    /* first word from word on whose summary bit is (not if negate) set */
+    static int next_word(const std::array<uint64_t, nb_summaries_> &summary,
+                         int word,
+                         bool negate)
+    {
+        for (int i = word / 64; i < nb_summaries_; ++i)
+        {
+            uint64_t bits = negate ? ~summary[i] : summary[i];
+            if (i == word / 64)
+                bits &= ~uint64_t(0) << (word % 64);
+            if (bits)
+            {
+                int result = i * 64 + __builtin_ctzll(bits);
+                return result < nb_words_ ? result : nb_words_;
+            }
+        }
+        return nb_words_;
+    }
 };
 
-State compute(const State &, std::vector<KeyStrokes> k);
+/* the number of slots of State, -DSTATE_SLOTS=65536 for large levels.
+   Every source of a program is to be built with the same one */
+#ifndef STATE_SLOTS
+#define STATE_SLOTS 256
+#endif
+
+using State = BasicState<STATE_SLOTS, 256>;
+
+class ThreadPool;
+
+/* Objects run in slot order on the state itself, each seeing what the
+   previous ones wrote ; an object spawned into a later slot runs in the
+   same phase. With a pool, blocks of 32 slots run ahead on copies of the
+   state as of the start of the phase, then are taken in slot order : a
+   block none of whose reads (see Action::reads, Object::vars) was
+   written by an earlier one gives its writes as they are, the others
+   run again in place. The result is the one of the sequential loop,
+   whatever the pool and the number of threads.
+   The cache, kept from one tick to the next, saves the collision tests
+   of the objects that did not move ; it does not change the result.
+   With RNG_LCG, whose every draw would send the later blocks back, the
+   objects run in place whatever the pool, as they do with a log, what
+   each of them writes being logged, see DependencyLog.
+   The state is returned by value : at -DSTATE_SLOTS=65536, where it
+   weighs about 4MB, the library steps states on the heap in place with
+   a Stepper instead, and so should its callers on a pool thread. */
+State compute(const ObjData::Level &,
+              const State &,
+              std::vector<KeyStrokes> k,
+              ThreadPool *pool = nullptr,
+              ObjData::CollisionCache *cache = nullptr,
+              DependencyLog *log = nullptr);
 
 class Arc
 {
@@ -87,11 +542,11 @@ public:
     fixed angle1_;
     fixed angle2_;
 
-    Arc()
+    constexpr Arc()
     {
     }
 
-    Arc(Point2D p1, fixed speed, fixed radius, fixed angle1, fixed angle2)
+    constexpr Arc(Point2D p1, fixed speed, fixed radius, fixed angle1, fixed angle2)
         : p1_(p1)
         , speed_(speed)
         , curved_(true)
@@ -106,7 +561,7 @@ public:
         length_ /= speed_;
     }
     
-    Arc(Point2D p1, Point2D p2, fixed speed)
+    constexpr Arc(Point2D p1, Point2D p2, fixed speed)
         : p1_(p1), p2_(p2), speed_(speed), curved_(false)
     {
         Point2D delta = p2 - p1;
@@ -121,7 +576,7 @@ public:
         return result;
     }
 
-    Point2D at(fixed param) const
+    constexpr Point2D at(fixed param) const
     {
         fixed k = param / length_;
         fixed l = 1 - k;
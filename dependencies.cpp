@@ -0,0 +1,416 @@
+#include "dependencies.h"
+#include "stepper.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+
+using namespace ObjData;
+
+namespace
+{
+    /* FNV-1a on words */
+    uint64_t hash(const void *data, size_t size)
+    {
+        uint64_t result = 14695981039346656037ull;
+        auto *bytes = static_cast<const unsigned char *>(data);
+        for (size_t i = 0; i < size; i += sizeof(uint32_t))
+        {
+            uint32_t word;
+            std::memcpy(&word, bytes + i, sizeof(word));
+            result = (result ^ word) * 1099511628211ull;
+        }
+        return result;
+    }
+
+    uint64_t hash(const CollisionEvts &evts)
+    {
+        uint64_t result = 14695981039346656037ull;
+        for (const auto &evt : evts)
+        {
+            int32_t fields[5] = {evt.id_spot_, evt.obj_spot_, evt.id_mask_, evt.obj_mask_, evt.contact_};
+            result = (result ^ hash(fields, sizeof(fields))) * 1099511628211ull;
+        }
+        return result;
+    }
+}
+
+const DependencyLog::Dirty &DependencyLog::slots()
+{
+    static const Dirty mask = []
+    {
+        Dirty result;
+        for (int slot = 0; slot != State::nb_slots_; ++slot)
+            result.set(slot);
+        return result;
+    }();
+    return mask;
+}
+
+int DependencyLog::resource(uint32_t offset)
+{
+    constexpr uint32_t slots = offsetof(State, slots_);
+    constexpr uint32_t vars = offsetof(State, var_);
+    constexpr uint32_t keys = offsetof(State, keys_);
+    constexpr uint32_t draws = offsetof(State, draws_);
+    if (offset - slots < sizeof(State::slots_))
+        return (offset - slots) / sizeof(StateObject);
+    if (offset - vars < sizeof(State::var_))
+        return State::nb_slots_ + (offset - vars) / sizeof(int32_t);
+    // the draws of a slot go with it, the rules' with the globals
+    if (offset - draws < State::nb_slots_ * sizeof(uint32_t))
+        return (offset - draws) / sizeof(uint32_t);
+    // the word may hold some padding too
+    if (offset < keys + sizeof(State::keys_) && keys < offset + sizeof(uint32_t))
+        return keys_;
+    return globals_;
+}
+
+void DependencyLog::add(const State &before,
+                        const State &after,
+                        uint32_t offset,
+                        uint32_t size,
+                        Writes &writes)
+{
+    static_assert(sizeof(State) % sizeof(uint32_t) == 0);
+    static_assert(sizeof(StateObject) % sizeof(uint32_t) == 0);
+    const auto *bytes_before = reinterpret_cast<const unsigned char *>(&before);
+    const auto *bytes_after = reinterpret_cast<const unsigned char *>(&after);
+
+    // 32 bytes at a time, most of the state being unchanged
+    constexpr uint32_t block = 32;
+    for (uint32_t end = offset + size; offset < end; offset += block)
+    {
+        uint32_t length = std::min(block, end - offset);
+        if (length == block)
+        {
+            uint64_t a[4], b[4];
+            std::memcpy(a, bytes_before + offset, block);
+            std::memcpy(b, bytes_after + offset, block);
+            if (!((a[0] ^ b[0]) | (a[1] ^ b[1]) | (a[2] ^ b[2]) | (a[3] ^ b[3])))
+                continue;
+        }
+        for (uint32_t word = offset; word != offset + length; word += sizeof(uint32_t))
+        {
+            Write write;
+            write.offset_ = word;
+            std::memcpy(&write.value_, bytes_after + word, sizeof(uint32_t));
+            if (std::memcmp(bytes_before + word, &write.value_, sizeof(uint32_t)))
+                writes.push_back(write);
+        }
+    }
+}
+
+void DependencyLog::apply(State &st, const Writes &writes, uint32_t first, uint32_t count)
+{
+    auto *bytes = reinterpret_cast<unsigned char *>(&st);
+    for (uint32_t i = first; i != first + count; ++i)
+        std::memcpy(bytes + writes[i].offset_, &writes[i].value_, sizeof(uint32_t));
+}
+
+void DependencyLog::summarize(const State &st, Tick &tick)
+{
+    tick.slots_.clear();
+    for (int slot = st.next_live(0); slot != State::nb_slots_; slot = st.next_live(slot + 1))
+        tick.slots_.emplace_back(slot, hash(&st.slots_[slot], sizeof(StateObject)));
+    tick.vars_ = hash(st.var_.data(), sizeof(st.var_));
+    // what resource() calls the globals, the scratch of allocate aside
+    uint64_t globals[] = {hash(st.used_.data(), sizeof(st.used_)),
+                          hash(st.full_.data(), sizeof(st.full_)),
+                          hash(st.any_.data(), sizeof(st.any_)),
+                          uint64_t(uint32_t(st.xscreen_)) << 32 | uint32_t(st.yscreen_),
+                          uint64_t(uint32_t(st.timestamp_)) << 32 | st.rnd_,
+                          st.rng_};
+    tick.globals_ = hash(globals, sizeof(globals));
+}
+
+void DependencyLog::snapshot(const State &st, int slot, const CollisionEvts &evts)
+{
+    auto &before = *before_;
+    watched_.clear();
+    // the rules may write anything, the slots spawned and freed aside
+    // every live slot is watched
+    bool whole = slot < 0 || level_.object(st.slots_[slot].type_).reads() & READ_OTHERS;
+    if (whole)
+    {
+        for (int live = st.next_live(0); live != State::nb_slots_; live = st.next_live(live + 1))
+            watched_.push_back(live);
+    }
+    else
+    {
+        watched_.push_back(slot);
+        for (const auto &evt : evts)
+        {
+            if (evt.obj_spot_ >= 0)
+                watched_.push_back(evt.obj_spot_);
+            if (evt.obj_mask_ >= 0)
+                watched_.push_back(evt.obj_mask_);
+        }
+        std::sort(watched_.begin(), watched_.end());
+        watched_.erase(std::unique(watched_.begin(), watched_.end()), watched_.end());
+    }
+    for (int watched : watched_)
+    {
+        before.slots_[watched] = st.slots_[watched];
+        before.draws_[watched] = st.draws_[watched];
+    }
+
+    // the globals, touching_ being only written between the executions
+    constexpr size_t vars = offsetof(State, var_);
+    std::memcpy(reinterpret_cast<unsigned char *>(&before) + vars,
+                reinterpret_cast<const unsigned char *>(&st) + vars,
+                offsetof(State, draws_) - vars);
+    before.draws_[State::nb_slots_] = st.draws_[State::nb_slots_];
+}
+
+void DependencyLog::begin(const State &st, const std::vector<CollisionEvts> &evts)
+{
+    int32_t tick = st.timestamp_;
+    if (ticks_.empty() || tick < first_tick_ || tick > end_tick())
+    {
+        ticks_.clear();
+        first_tick_ = tick;
+    }
+    else if (!partial_)
+    {
+        truncate(tick);
+    }
+    old_ = partial_ && tick < end_tick() ? &ticks_[tick - first_tick_] : nullptr;
+    cursor_ = 0;
+
+    current_ = Tick{};
+    current_.keys_ = st.keys_;
+    for (int slot = st.next_live(0); slot != State::nb_slots_; slot = st.next_live(slot + 1))
+        if (!evts[slot].empty())
+            current_.evts_.emplace_back(slot, hash(evts[slot]));
+    if (!old_)
+        return;
+
+    // keys_ are written again every tick
+    bool keys = dirty_[keys_];
+    dirty_[keys_] = std::memcmp(&old_->keys_, &current_.keys_, sizeof(current_.keys_)) != 0;
+    // step woke the objects reading keys_ if it changed since the last
+    // tick, outside of any execution
+    if (keys || dirty_[keys_])
+        for (int slot = st.next_live(0); slot != State::nb_slots_; slot = st.next_live(slot + 1))
+            if (level_.object(st.slots_[slot].type_).reads() & READ_KEYS)
+                dirty_.set(slot);
+
+    // slots whose events differ, both lists being sorted
+    auto it = old_->evts_.begin();
+    for (const auto &[slot, h] : current_.evts_)
+    {
+        for (; it != old_->evts_.end() && it->first < slot; ++it)
+            dirty_.set(it->first);
+        if (it != old_->evts_.end() && it->first == slot && it->second == h)
+            ++it;
+        else
+            dirty_.set(slot);
+    }
+    for (; it != old_->evts_.end(); ++it)
+        dirty_.set(it->first);
+}
+
+const DependencyLog::Execution *DependencyLog::match(int slot, int phase)
+{
+    if (!old_)
+        return nullptr;
+    // rules come after the objects of their phase
+    auto key = [](int slot, int phase)
+    {
+        return std::make_pair(phase, slot < 0 ? State::nb_slots_ : slot);
+    };
+    const auto &executions = old_->executions_;
+    for (; cursor_ != executions.size()
+           && key(executions[cursor_].slot_, executions[cursor_].phase_) < key(slot, phase);
+         ++cursor_)
+        touch(*old_, executions[cursor_]);
+    if (cursor_ != executions.size()
+        && executions[cursor_].slot_ == slot
+        && executions[cursor_].phase_ == phase)
+        return &executions[cursor_++];
+    return nullptr;
+}
+
+bool DependencyLog::affected(const State &st,
+                             int slot,
+                             const CollisionEvts &evts,
+                             const Execution &old) const
+{
+    // the rules may read anything
+    if (slot < 0)
+        return dirty_.any();
+    if (dirty_[slot])
+        return true;
+
+    const auto &object = level_.object(st.slots_[slot].type_);
+    for (int var : object.vars())
+        if (dirty_[State::nb_slots_ + var])
+            return true;
+    for (const auto &evt : evts)
+        if ((evt.obj_spot_ >= 0 && dirty_[evt.obj_spot_])
+            || (evt.obj_mask_ >= 0 && dirty_[evt.obj_mask_]))
+            return true;
+    if (object.reads() & READ_KEYS && dirty_[keys_])
+        return true;
+    if (object.reads() & READ_OTHERS && (dirty_[globals_] || (dirty_ & slots()).any()))
+        return true;
+
+    // a word written over a dirty one may keep some of its bits
+    for (uint32_t i = old.first_; i != old.first_ + old.count_; ++i)
+        if (dirty_[resource(old_->writes_[i].offset_)])
+            return true;
+    return false;
+}
+
+void DependencyLog::copy(State &st, int slot, int phase, const Execution &old)
+{
+    current_.executions_.push_back({slot, phase, uint32_t(current_.writes_.size()), old.count_});
+    apply(st, old_->writes_, old.first_, old.count_);
+    current_.writes_.insert(current_.writes_.end(),
+                            old_->writes_.begin() + old.first_,
+                            old_->writes_.begin() + old.first_ + old.count_);
+    stats_.copied_++;
+}
+
+void DependencyLog::record(const State &st, int slot, int phase, const Execution *old)
+{
+    constexpr uint32_t slots = offsetof(State, slots_);
+    constexpr uint32_t vars = offsetof(State, var_);
+    constexpr uint32_t draws = offsetof(State, draws_);
+    const auto &before = *before_;
+    auto &writes = current_.writes_;
+    Execution execution{slot, phase, uint32_t(writes.size()), 0};
+    for (int watched : watched_)
+    {
+        add(before, st, slots + watched * sizeof(StateObject), sizeof(StateObject), writes);
+        add(before, st, draws + watched * sizeof(uint32_t), sizeof(uint32_t), writes);
+    }
+    add(before, st, vars, draws - vars, writes);
+    add(before, st, draws + State::nb_slots_ * sizeof(uint32_t), sizeof(uint32_t), writes);
+
+    // a spawn or a free writes the whole slot, whatever a free slot held,
+    // and a spawn its draws
+    auto *bytes = reinterpret_cast<const unsigned char *>(&st);
+    auto whole = [&](uint32_t offset, uint32_t size)
+    {
+        for (uint32_t i = 0; i != size; i += sizeof(uint32_t))
+        {
+            Write write;
+            write.offset_ = offset + i;
+            std::memcpy(&write.value_, bytes + offset + i, sizeof(uint32_t));
+            writes.push_back(write);
+        }
+    };
+    for (int word = 0; word != State::nb_words_; ++word)
+    {
+        for (uint64_t bits = before.used_[word] ^ st.used_[word]; bits; bits &= bits - 1)
+        {
+            int changed = word * 64 + __builtin_ctzll(bits);
+            whole(slots + changed * sizeof(StateObject), sizeof(StateObject));
+            if (st.live(changed))
+                whole(draws + changed * sizeof(uint32_t), sizeof(uint32_t));
+        }
+    }
+
+    execution.count_ = writes.size() - execution.first_;
+    current_.executions_.push_back(execution);
+    stats_.executed_++;
+
+    if (!partial_)
+        return;
+    touch(current_, execution);
+    if (old)
+        touch(*old_, *old);
+}
+
+void DependencyLog::touch(const Tick &tick, const Execution &execution)
+{
+    for (uint32_t i = execution.first_; i != execution.first_ + execution.count_; ++i)
+        dirty_.set(resource(tick.writes_[i].offset_));
+}
+
+void DependencyLog::clean(const Tick &tick)
+{
+    // both lists are sorted, a slot free in both is clean, what a free
+    // slot holds being never read
+    dirty_ &= ~slots();
+    auto now = current_.slots_.begin();
+    auto then = tick.slots_.begin();
+    while (now != current_.slots_.end() || then != tick.slots_.end())
+    {
+        if (then == tick.slots_.end() || (now != current_.slots_.end() && now->first < then->first))
+            dirty_.set((now++)->first);
+        else if (now == current_.slots_.end() || then->first < now->first)
+            dirty_.set((then++)->first);
+        else
+        {
+            dirty_[now->first] = now->second != then->second;
+            ++now;
+            ++then;
+        }
+    }
+    // a var_ entry only changes in an execution, which dirtied it
+    if (current_.vars_ == tick.vars_)
+        for (int var = 0; var != State::nb_vars_; ++var)
+            dirty_.reset(State::nb_slots_ + var);
+    dirty_[globals_] = current_.globals_ != tick.globals_;
+}
+
+void DependencyLog::end(const State &st)
+{
+    summarize(st, current_);
+    if (old_)
+    {
+        // what ran in the old timeline only
+        for (; cursor_ != old_->executions_.size(); ++cursor_)
+            touch(*old_, old_->executions_[cursor_]);
+        // a write of var_ wakes the objects reading it
+        for (int slot = st.next_live(0); slot != State::nb_slots_; slot = st.next_live(slot + 1))
+            for (int var : level_.object(st.slots_[slot].type_).vars())
+                if (dirty_[State::nb_slots_ + var])
+                    dirty_.set(slot);
+        // the timelines meet again where the tick ends the same
+        clean(*old_);
+        ticks_[st.timestamp_ - first_tick_] = std::move(current_);
+        old_ = nullptr;
+    }
+    else
+    {
+        ticks_.push_back(std::move(current_));
+    }
+}
+
+void DependencyLog::resimulate(State &st,
+                               const std::vector<std::vector<KeyStrokes>> &inputs,
+                               bool verify)
+{
+    partial_ = true;
+    dirty_.reset();
+    // one stepper and its collision cache for every tick
+    Stepper stepper(level_);
+    std::unique_ptr<State> full;
+    std::unique_ptr<Stepper> full_stepper;
+    if (verify)
+    {
+        full = std::make_unique<State>(st);
+        full_stepper = std::make_unique<Stepper>(level_);
+    }
+    for (const auto &k : inputs)
+    {
+        stepper.step(st, k.data(), k.size(), this);
+        if (!verify)
+            continue;
+        full_stepper->step(*full, k.data(), k.size());
+        if (stats_.mismatch_ < 0 && full->hash() != st.hash())
+            stats_.mismatch_ = st.timestamp_;
+    }
+    partial_ = false;
+}
+
+void DependencyLog::truncate(int32_t tick)
+{
+    if (tick < end_tick())
+        ticks_.resize(std::max(tick - first_tick_, 0));
+}
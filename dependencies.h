@@ -0,0 +1,172 @@
+#pragma once
+
+#include <bitset>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "data.h"
+#include "memory.h"
+#include "objectdata.h"
+
+/* What every object wrote at every tick, for partial resimulation after
+   an edit of the inputs.
+
+   Given to compute, the log records, for each execution of an object
+   (and for the rules of each phase), the words of State it changed.
+   Reads are the declared ones : the object's own slot, the other side of
+   its collision events, Object::vars() and Object::reads(). Writes are
+   looked for in its own slot, the other side of its collision events,
+   var_, the globals and the slots it spawns or frees. An object writing
+   any other slot declares READ_OTHERS : its executions, like the rules',
+   are compared over every live slot. Only what is compared is copied
+   before the execution.
+
+   resimulate() then replays ticks already logged with new inputs. A
+   slot, var_ entry, keys_ or the other globals are dirty once they may
+   differ from the old timeline. An execution none of whose reads and
+   writes are dirty is not run again : its old writes are copied. The
+   others run and dirty whatever they or their old run wrote. A slot,
+   var_ or the globals ending a tick as they did in the old timeline are
+   clean again, so that timelines meeting again go back to copying. */
+class DependencyLog
+{
+public:
+    struct Write
+    {
+        uint32_t offset_;
+        uint32_t value_;
+    };
+
+    using Writes = std::vector<Write, TaggedAllocator<Write, MEMORY_HISTORY>>;
+
+    struct Execution
+    {
+        // -1 for the rules of the phase
+        int32_t slot_;
+        int32_t phase_;
+        uint32_t first_;
+        uint32_t count_;
+    };
+
+    struct Tick
+    {
+        std::array<KeyStrokes, State::nb_players_> keys_;
+        // hash of the collision events of every slot
+        std::vector<std::pair<int, uint64_t>> evts_;
+        std::vector<Execution> executions_;
+        Writes writes_;
+        // hashes at the end of the tick : of every live slot, of var_
+        // and of the globals
+        std::vector<std::pair<int, uint64_t>> slots_;
+        uint64_t vars_{0};
+        uint64_t globals_{0};
+    };
+
+    struct Stats
+    {
+        uint64_t executed_{0};
+        uint64_t copied_{0};
+        // first tick where a verified resimulation differs, -1 if none
+        int32_t mismatch_{-1};
+    };
+
+private:
+    static constexpr int keys_ = State::nb_slots_ + State::nb_vars_;
+    static constexpr int globals_ = keys_ + 1;
+    using Dirty = std::bitset<globals_ + 1>;
+
+    const ObjData::Level &level_;
+    // timestamp of the state computed by the first tick
+    int32_t first_tick_{0};
+    std::vector<Tick> ticks_;
+
+    // during a compute
+    Tick current_;
+    bool partial_{false};
+    const Tick *old_{nullptr};
+    size_t cursor_{0};
+    Dirty dirty_;
+    // st as of the start of the execution : the watched slots, their
+    // draws and the globals. On the heap, as it follows the capacity
+    std::unique_ptr<State> before_{std::make_unique<State>()};
+    std::vector<int> watched_;
+    Stats stats_;
+
+    /* the bits of the slots in a Dirty */
+    static const Dirty &slots();
+
+    static int resource(uint32_t offset);
+    static void add(const State &before,
+                    const State &after,
+                    uint32_t offset,
+                    uint32_t size,
+                    Writes &writes);
+    static void apply(State &st, const Writes &writes, uint32_t first, uint32_t count);
+    static void summarize(const State &st, Tick &tick);
+
+    void snapshot(const State &st, int slot, const ObjData::CollisionEvts &evts);
+
+    const Execution *match(int slot, int phase);
+    bool affected(const State &st, int slot, const ObjData::CollisionEvts &evts, const Execution &old) const;
+    void copy(State &st, int slot, int phase, const Execution &old);
+    void record(const State &st, int slot, int phase, const Execution *old);
+    void touch(const Tick &tick, const Execution &execution);
+    void clean(const Tick &tick);
+
+public:
+    explicit DependencyLog(const ObjData::Level &level)
+        : level_(level)
+    {
+    }
+
+    /* hooks of compute */
+    void begin(const State &st, const std::vector<ObjData::CollisionEvts> &evts);
+
+    template <typename Run>
+    void execute(State &st, int slot, int phase, const ObjData::CollisionEvts &evts, Run &&run)
+    {
+        const Execution *old = match(slot, phase);
+        if (old && !affected(st, slot, evts, *old))
+        {
+            copy(st, slot, phase, *old);
+            return;
+        }
+        snapshot(st, slot, evts);
+        run();
+        record(st, slot, phase, old);
+    }
+
+    void end(const State &st);
+
+    /* Computes the ticks after st with inputs, in place, st being a
+       state of the logged timeline, and logs them in place of the old
+       ones. With verify, every tick is also fully computed and compared */
+    void resimulate(State &st,
+                    const std::vector<std::vector<KeyStrokes>> &inputs,
+                    bool verify = false);
+
+    /* forgets tick and the following ones */
+    void truncate(int32_t tick);
+
+    int32_t first_tick() const
+    {
+        return first_tick_;
+    }
+
+    /* one past the last tick logged */
+    int32_t end_tick() const
+    {
+        return first_tick_ + int32_t(ticks_.size());
+    }
+
+    const Stats &stats() const
+    {
+        return stats_;
+    }
+
+    void reset_stats()
+    {
+        stats_ = Stats{};
+    }
+};
@@ -0,0 +1,156 @@
+#include "divergence.h"
+#include "stepper.h"
+
+#include <algorithm>
+#include <cstring>
+
+Branch::Branch(const ObjData::Level &level,
+               const State &start,
+               std::vector<std::vector<KeyStrokes>> inputs,
+               int interval)
+    : level_(level),
+      start_(start.timestamp_),
+      inputs_(std::move(inputs)),
+      interval_(std::max(interval, 1)),
+      hashes_(inputs_.size() + 1),
+      cursor_(std::make_unique<State>(start)),
+      cursor_tick_(start_),
+      stepper_(std::make_unique<Stepper>(level))
+{
+    checkpoints_.emplace(start_, start);
+    hashes_[0] = start.hash();
+}
+
+Branch::~Branch() = default;
+
+void Branch::set_hash(int32_t tick, uint64_t hash)
+{
+    if (tick >= start_ && tick < end_tick())
+        hashes_[tick - start_] = hash;
+}
+
+uint64_t Branch::hash(int32_t tick)
+{
+    auto &cached = hashes_[tick - start_];
+    if (!cached)
+        cached = advance(tick).hash();
+    return *cached;
+}
+
+const State &Branch::state(int32_t tick)
+{
+    return advance(tick);
+}
+
+const State &Branch::advance(int32_t tick)
+{
+    auto it = std::prev(checkpoints_.upper_bound(tick));
+    if (cursor_tick_ < it->first || cursor_tick_ > tick)
+    {
+        *cursor_ = it->second;
+        cursor_tick_ = it->first;
+    }
+    for (; cursor_tick_ != tick; ++cursor_tick_)
+    {
+        const auto &k = inputs_[cursor_tick_ - start_];
+        stepper_->step(*cursor_, k.data(), k.size());
+        simulated_++;
+        int i = cursor_tick_ + 1 - start_;
+        if (!hashes_[i])
+            hashes_[i] = cursor_->hash();
+        if (i % interval_ == 0)
+            checkpoints_.emplace(cursor_tick_ + 1, *cursor_);
+    }
+    return *cursor_;
+}
+
+std::vector<FieldDiff> diff(const State &first, const State &second)
+{
+    std::vector<FieldDiff> result;
+    auto add = [&result](int slot, const char *field, int64_t value1, int64_t value2)
+    {
+        if (value1 != value2)
+            result.push_back({slot, field, value1, value2});
+    };
+
+    // slots live in either state, skipping the empty words of both
+    auto next = [&first, &second](int slot)
+    {
+        return std::min(first.next_live(slot), second.next_live(slot));
+    };
+    for (int slot = next(0); slot != State::nb_slots_; slot = next(slot + 1))
+    {
+        const auto &so1 = first.slots_[slot];
+        const auto &so2 = second.slots_[slot];
+        add(slot, "type_", so1.type_, so2.type_);
+        add(slot, "pos_.x", so1.pos_.real().value_, so2.pos_.real().value_);
+        add(slot, "pos_.y", so1.pos_.imag().value_, so2.pos_.imag().value_);
+        add(slot, "speed_.x", so1.speed_.real().value_, so2.speed_.real().value_);
+        add(slot, "speed_.y", so1.speed_.imag().value_, so2.speed_.imag().value_);
+        add(slot, "state_", so1.state_, so2.state_);
+        add(slot, "state_no_", so1.state_no_, so2.state_no_);
+        add(slot, "idle_", so1.idle_, so2.idle_);
+        add(slot, "action_", so1.action_, so2.action_);
+        add(slot, "mvt_[0]", so1.mvt_[0], so2.mvt_[0]);
+        add(slot, "mvt_[1]", so1.mvt_[1], so2.mvt_[1]);
+        add(slot, "src_", so1.src_, so2.src_);
+        add(slot, "contacts_", so1.contacts_, so2.contacts_);
+    }
+
+    for (int var = 0; var != State::nb_vars_; ++var)
+        if (first.var_[var] != second.var_[var])
+            result.push_back({-1, "var_[" + std::to_string(var) + "]", first.var_[var], second.var_[var]});
+    for (int player = 0; player != State::nb_players_; ++player)
+    {
+        uint8_t keys1, keys2;
+        std::memcpy(&keys1, &first.keys_[player], 1);
+        std::memcpy(&keys2, &second.keys_[player], 1);
+        if (keys1 != keys2)
+            result.push_back({-1, "keys_[" + std::to_string(player) + "]", keys1, keys2});
+    }
+    add(-1, "xscreen_", first.xscreen_, second.xscreen_);
+    add(-1, "yscreen_", first.yscreen_, second.yscreen_);
+    add(-1, "timestamp_", first.timestamp_, second.timestamp_);
+    add(-1, "rnd_", first.rnd_, second.rnd_);
+    add(-1, "rng_", first.rng_, second.rng_);
+    return result;
+}
+
+std::optional<Divergence> bisect(Branch &first, Branch &second)
+{
+    int simulated = first.simulated() + second.simulated();
+    int32_t low = std::max(first.first_tick(), second.first_tick());
+    int32_t end = std::min(first.end_tick(), second.end_tick());
+    if (low >= end)
+        return {};
+
+    auto differ = [&](int32_t tick)
+    {
+        return first.hash(tick) != second.hash(tick);
+    };
+
+    // the ticks known to both, agreeing then differing
+    std::vector<int32_t> known;
+    for (int32_t tick = low; tick != end; ++tick)
+        if (first.known(tick) && second.known(tick))
+            known.push_back(tick);
+    auto it = std::partition_point(known.begin(), known.end(), [&](int32_t tick) { return !differ(tick); });
+    int32_t agree = it == known.begin() ? low - 1 : *std::prev(it);
+    int32_t differs = it == known.end() ? end : *it;
+
+    // then forward together from the last agreeing one
+    int32_t tick = agree + 1;
+    while (tick != differs && !differ(tick))
+        ++tick;
+    if (tick == end)
+        return {};
+
+    Divergence result;
+    result.tick_ = tick;
+    result.fields_ = diff(first.state(tick), second.state(tick));
+    for (const auto &field : result.fields_)
+        if (field.slot_ >= 0 && (result.slots_.empty() || result.slots_.back() != field.slot_))
+            result.slots_.push_back(field.slot_);
+    result.simulated_ = first.simulated() + second.simulated() - simulated;
+    return result;
+}
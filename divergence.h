@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "data.h"
+#include "memory.h"
+
+class Stepper;
+
+/* One timeline : a start state and the inputs of the ticks after it.
+   The state of any tick is simulated again from the closest checkpoint
+   before it, or from the last tick asked for when it is closer : moving
+   forward a tick at a time costs a compute per tick. Checkpoints are
+   kept every interval ticks on the way, and the hash of every tick
+   simulated is remembered. */
+class Branch
+{
+    using Checkpoints = std::map<int32_t,
+                                 State,
+                                 std::less<int32_t>,
+                                 TaggedAllocator<std::pair<const int32_t, State>, MEMORY_HISTORY>>;
+
+    const ObjData::Level &level_;
+    int32_t start_;
+    std::vector<std::vector<KeyStrokes>> inputs_;
+    int interval_;
+    Checkpoints checkpoints_;
+    // indexed by tick - start_
+    std::vector<std::optional<uint64_t>> hashes_;
+    // the last tick asked for, on the heap as the checkpoints
+    std::unique_ptr<State> cursor_;
+    int32_t cursor_tick_;
+    std::unique_ptr<Stepper> stepper_;
+    int simulated_{0};
+
+    const State &advance(int32_t tick);
+
+public:
+    Branch(const ObjData::Level &level,
+           const State &start,
+           std::vector<std::vector<KeyStrokes>> inputs,
+           int interval = 64);
+    ~Branch();
+
+    int32_t first_tick() const
+    {
+        return start_;
+    }
+
+    /* one past the last tick that can be reached */
+    int32_t end_tick() const
+    {
+        return start_ + int32_t(inputs_.size()) + 1;
+    }
+
+    /* a hash recorded elsewhere (a replay, the other peer...), trusted
+       instead of simulating tick */
+    void set_hash(int32_t tick, uint64_t hash);
+
+    /* the hash of tick is there without simulating */
+    bool known(int32_t tick) const
+    {
+        return tick >= start_ && tick < end_tick() && hashes_[tick - start_];
+    }
+
+    uint64_t hash(int32_t tick);
+    /* valid until the branch is asked for another tick */
+    const State &state(int32_t tick);
+
+    /* number of computes so far */
+    int simulated() const
+    {
+        return simulated_;
+    }
+};
+
+struct FieldDiff
+{
+    // -1 for var_ and the other globals
+    int slot_;
+    // "pos_.x", "var_[12]", "rnd_"...
+    std::string field_;
+    int64_t first_;
+    int64_t second_;
+};
+
+/* fields of the live slots (in either state) and globals that differ */
+std::vector<FieldDiff> diff(const State &first, const State &second);
+
+struct Divergence
+{
+    // first tick whose states differ
+    int32_t tick_;
+    std::vector<int> slots_;
+    std::vector<FieldDiff> fields_;
+    // computes of both branches during the bisection
+    int simulated_;
+};
+
+/* First tick both branches reach whose hashes differ, assuming that
+   once they differ they never meet again. A binary search on the ticks
+   whose hashes both branches already know (set_hash, earlier bisections)
+   narrows it down, then both step forward together from the last one
+   agreeing : a divergence d ticks after the closest checkpoint costs
+   2 * d computes, however long the branches. Empty if they agree up to
+   the last common tick. */
+std::optional<Divergence> bisect(Branch &first, Branch &second);
@@ -0,0 +1,208 @@
+#include "objectdata.h"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <tuple>
+
+using namespace ObjData;
+
+namespace
+{
+    using Key = std::tuple<int, int, int, int>;
+
+    Key key(const IRectangle &rect)
+    {
+        return {rect.first.real(), rect.first.imag(), rect.second.real(), rect.second.imag()};
+    }
+
+    /* the rectangle lies in its image : its pixels can be read */
+    bool readable(const Sprite &sprite)
+    {
+        const auto &[first, second] = sprite.coor_;
+        const Image *image = sprite.image_;
+        return image
+               && first.real() >= 0 && first.imag() >= 0
+               && second.real() < image->w_ && second.imag() < image->h_
+               && second.real() >= first.real() && second.imag() >= first.imag();
+    }
+
+    /* every field of a pixel, clear of padding */
+    uint64_t word(const Pixel &pixel)
+    {
+        return pixel.r_
+               | uint64_t(pixel.g_) << 8
+               | uint64_t(pixel.b_) << 16
+               | uint64_t(pixel.a_) << 24
+               | uint64_t(pixel.masks_) << 32
+               | uint64_t(pixel.depth_) << 56;
+    }
+
+    const Pixel *row(const Sprite &sprite, int y)
+    {
+        const auto &first = sprite.coor_.first;
+        const auto &image = *sprite.image_;
+        return &image.content_[first.real() + (first.imag() + y) * image.stride_];
+    }
+
+    /* the same pixels, wherever they lie. A rectangle out of its image
+       only equals itself */
+    bool operator==(const FrameData &frame1, const FrameData &frame2)
+    {
+        const auto &sprite1 = frame1.sprite_;
+        const auto &sprite2 = frame2.sprite_;
+        if (frame1.spots_ != frame2.spots_)
+            return false;
+        bool readable1 = readable(sprite1);
+        if (readable1 != readable(sprite2))
+            return false;
+        if (!readable1)
+            return sprite1.image_ == sprite2.image_
+                   && sprite1.id_image_ == sprite2.id_image_
+                   && sprite1.coor_ == sprite2.coor_;
+
+        auto size = sprite1.coor_.second - sprite1.coor_.first;
+        if (size != sprite2.coor_.second - sprite2.coor_.first)
+            return false;
+        for (int y = 0; y <= size.imag(); ++y)
+        {
+            const Pixel *row1 = row(sprite1, y);
+            const Pixel *row2 = row(sprite2, y);
+            for (int x = 0; x <= size.real(); ++x)
+                if (word(row1[x]) != word(row2[x]))
+                    return false;
+        }
+        return true;
+    }
+}
+
+uint64_t FrameStore::hash(const FrameData &frame)
+{
+    // FNV-1a
+    uint64_t result = 0xcbf29ce484222325;
+    auto add = [&result](uint64_t word)
+    {
+        for (int i = 0; i != 8; ++i)
+        {
+            result ^= (word >> (i * 8)) & 0xff;
+            result *= 0x100000001b3;
+        }
+    };
+
+    const auto &sprite = frame.sprite_;
+    if (readable(sprite))
+    {
+        auto size = sprite.coor_.second - sprite.coor_.first;
+        add(uint32_t(size.real()) | uint64_t(uint32_t(size.imag())) << 32);
+        for (int y = 0; y <= size.imag(); ++y)
+        {
+            const Pixel *pixels = row(sprite, y);
+            for (int x = 0; x <= size.real(); ++x)
+                add(word(pixels[x]));
+        }
+    }
+    else
+    {
+        add(reinterpret_cast<uintptr_t>(sprite.image_));
+        add(sprite.id_image_);
+        auto [a, b, c, d] = key(sprite.coor_);
+        add(uint32_t(a) | uint64_t(uint32_t(b)) << 32);
+        add(uint32_t(c) | uint64_t(uint32_t(d)) << 32);
+    }
+    for (const auto &spot : frame.spots_)
+        add(uint32_t(spot.real().value_) | uint64_t(uint32_t(spot.imag().value_)) << 32);
+    return result;
+}
+
+const FrameData *FrameStore::intern(const FrameData &frame)
+{
+    requests_++;
+    uint64_t h = hash(frame);
+    for (auto [begin, end] = by_hash_.equal_range(h); begin != end; ++begin)
+        if (*begin->second == frame)
+            return begin->second;
+
+    frames_.push_back(frame);
+    by_hash_.emplace(h, &frames_.back());
+    return &frames_.back();
+}
+
+void FrameStore::compact(Image &image)
+{
+    // distinct rectangles of image in use
+    std::map<Key, IPoint2D> placement;
+    for (const auto &frame : frames_)
+    {
+        const auto &sprite = frame.sprite_;
+        if (sprite.image_ != &image)
+            continue;
+        // leaves alone a rectangle not inside the image
+        if (!readable(sprite))
+            return;
+        placement.emplace(key(sprite.coor_), IPoint2D());
+    }
+
+    // shelves as wide as the image, highest rectangles first
+    std::vector<std::map<Key, IPoint2D>::iterator> order;
+    for (auto it = placement.begin(); it != placement.end(); ++it)
+        order.push_back(it);
+    auto height = [](const Key &k) { return std::get<3>(k) - std::get<1>(k) + 1; };
+    auto width = [](const Key &k) { return std::get<2>(k) - std::get<0>(k) + 1; };
+    std::stable_sort(order.begin(),
+                     order.end(),
+                     [&height](const auto &it1, const auto &it2)
+                     {
+                         return height(it1->first) > height(it2->first);
+                     });
+
+    int x = 0;
+    int y = 0;
+    int shelf = 0;
+    for (auto it : order)
+    {
+        if (x + width(it->first) > image.w_)
+        {
+            y += shelf;
+            x = 0;
+            shelf = 0;
+        }
+        it->second = IPoint2D(x, y);
+        x += width(it->first);
+        shelf = std::max(shelf, height(it->first));
+    }
+    if (y + shelf >= image.h_)
+        return;
+
+    Image packed;
+    packed.w_ = image.w_;
+    packed.h_ = y + shelf;
+    packed.stride_ = packed.w_;
+    packed.content_.assign(packed.w_ * packed.h_, Pixel{});
+    for (const auto &[k, to] : placement)
+    {
+        auto [x1, y1, x2, y2] = k;
+        for (int row = 0; row <= y2 - y1; ++row)
+            std::memcpy(&packed.content_[to.real() + (to.imag() + row) * packed.stride_],
+                        &image.content_[x1 + (y1 + row) * image.stride_],
+                        (x2 - x1 + 1) * sizeof(Pixel));
+    }
+
+    for (auto &frame : frames_)
+    {
+        auto &coor = frame.sprite_.coor_;
+        if (frame.sprite_.image_ != &image)
+            continue;
+        auto to = placement[key(coor)];
+        coor = {to, to + (coor.second - coor.first)};
+    }
+    // the pixels did not change, nor the hashes
+    image = std::move(packed);
+}
+
+size_t FrameStore::bytes() const
+{
+    return sizeof(*this)
+           + frames_.size() * sizeof(FrameData)
+           + by_hash_.size() * (sizeof(std::pair<const uint64_t, FrameData *>) + 2 * sizeof(void *))
+           + by_hash_.bucket_count() * sizeof(void *);
+}
@@ -0,0 +1,160 @@
+#include "journal.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+void Journal::Snapshot::take(const State &st)
+{
+    slots_.clear();
+    objects_.clear();
+    draws_.clear();
+    for (int slot = st.next_live(0); slot != State::nb_slots_; slot = st.next_live(slot + 1))
+    {
+        slots_.push_back(slot);
+        objects_.push_back(st.slots_[slot]);
+        draws_.push_back(st.draws_[slot]);
+    }
+
+    constexpr size_t vars = offsetof(State, var_);
+    auto *bytes = reinterpret_cast<const unsigned char *>(&st);
+    globals_.assign(bytes + vars, bytes + offsetof(State, draws_));
+    rules_draws_ = st.draws_[State::nb_slots_];
+    drawing_ = st.drawing_;
+    nb_touching_ = st.nb_touching_;
+    touching_.assign(st.touching_.begin(), st.touching_.begin() + nb_touching_);
+}
+
+void Journal::push(uint32_t offset, uint32_t old)
+{
+    if (runs_.empty() || runs_.back().offset_ + runs_.back().count_ * sizeof(uint32_t) != offset)
+        runs_.push_back({offset, uint32_t(words_.size()), 0});
+    runs_.back().count_++;
+    words_.push_back(old);
+}
+
+void Journal::add(const State &after, uint32_t offset, const void *old, uint32_t size)
+{
+    const auto *bytes_before = static_cast<const unsigned char *>(old);
+    const auto *bytes_after = reinterpret_cast<const unsigned char *>(&after) + offset;
+
+    // skip unchanged areas 8 bytes at a time
+    uint32_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+    {
+        if (!std::memcmp(bytes_before + i, bytes_after + i, sizeof(uint64_t)))
+            continue;
+        for (uint32_t word = i; word != i + sizeof(uint64_t); word += sizeof(uint32_t))
+        {
+            uint32_t value;
+            std::memcpy(&value, bytes_before + word, sizeof(uint32_t));
+            if (std::memcmp(&value, bytes_after + word, sizeof(uint32_t)))
+                push(offset + word, value);
+        }
+    }
+    if (i != size && std::memcmp(bytes_before + i, bytes_after + i, sizeof(uint32_t)))
+    {
+        uint32_t value;
+        std::memcpy(&value, bytes_before + i, sizeof(uint32_t));
+        push(offset + i, value);
+    }
+}
+
+void Journal::keep(uint32_t offset, const void *old, uint32_t size)
+{
+    const auto *bytes = static_cast<const unsigned char *>(old);
+    for (uint32_t word = 0; word != size; word += sizeof(uint32_t))
+    {
+        uint32_t value;
+        std::memcpy(&value, bytes + word, sizeof(uint32_t));
+        push(offset + word, value);
+    }
+}
+
+void Journal::record(const Snapshot &before, const State &after)
+{
+    constexpr uint32_t slots = offsetof(State, slots_);
+    constexpr uint32_t draws = offsetof(State, draws_);
+    runs_.clear();
+    words_.clear();
+    for (size_t i = 0; i != before.slots_.size(); ++i)
+    {
+        int slot = before.slots_[i];
+        // a slot freed is not looked at by the next journals, which may
+        // spawn into it : it is kept whole
+        if (after.live(slot))
+        {
+            add(after, slots + slot * sizeof(StateObject), &before.objects_[i], sizeof(StateObject));
+            add(after, draws + slot * sizeof(uint32_t), &before.draws_[i], sizeof(uint32_t));
+        }
+        else
+        {
+            keep(slots + slot * sizeof(StateObject), &before.objects_[i], sizeof(StateObject));
+            keep(draws + slot * sizeof(uint32_t), &before.draws_[i], sizeof(uint32_t));
+        }
+    }
+    // a slot spawned into goes back to what free() leaves, the type
+    // telling a free slot from a live one within a tick
+    constexpr uint32_t used = offsetof(State, used_) - offsetof(State, var_);
+    for (int word = 0; word != State::nb_words_; ++word)
+    {
+        uint64_t before_used;
+        std::memcpy(&before_used, before.globals_.data() + used + word * sizeof(uint64_t), sizeof(uint64_t));
+        for (uint64_t bits = after.used_[word] & ~before_used; bits; bits &= bits - 1)
+        {
+            int slot = word * 64 + __builtin_ctzll(bits);
+            StateObject so = after.slots_[slot];
+            so.type_ = 255;
+            keep(slots + slot * sizeof(StateObject), &so, sizeof(StateObject));
+        }
+    }
+    add(after, offsetof(State, var_), before.globals_.data(), before.globals_.size());
+    add(after, draws + State::nb_slots_ * sizeof(uint32_t), &before.rules_draws_, sizeof(uint32_t));
+    add(after, offsetof(State, drawing_), &before.drawing_, sizeof(int32_t));
+    add(after, offsetof(State, nb_touching_), &before.nb_touching_, sizeof(uint32_t));
+    // likewise for the contacts past the new count
+    uint32_t common = std::min(before.nb_touching_, after.nb_touching_);
+    add(after, offsetof(State, touching_), before.touching_.data(), common * sizeof(uint64_t));
+    keep(offsetof(State, touching_) + common * sizeof(uint64_t),
+         before.touching_.data() + common,
+         (before.nb_touching_ - common) * sizeof(uint64_t));
+}
+
+void Journal::undo(State &st) const
+{
+    // no two runs overlap
+    auto *bytes = reinterpret_cast<unsigned char *>(&st);
+    for (const auto &run : runs_)
+        std::memcpy(bytes + run.offset_, &words_[run.first_], run.count_ * sizeof(uint32_t));
+}
+
+void UndoHistory::step(State &st, const KeyStrokes *k, size_t nb_keys)
+{
+    if (!max_ticks_)
+    {
+        stepper_.step(st, k, nb_keys);
+        return;
+    }
+    before_.take(st);
+    stepper_.step(st, k, nb_keys);
+    if (journals_.size() == max_ticks_)
+    {
+        // recycle the oldest journal and its buffer
+        journals_.push_back(std::move(journals_.front()));
+        journals_.pop_front();
+    }
+    else
+    {
+        journals_.emplace_back();
+    }
+    journals_.back().record(before_, st);
+}
+
+bool UndoHistory::step_back(State &st)
+{
+    if (journals_.empty())
+        return false;
+    journals_.back().undo(st);
+    journals_.pop_back();
+    return true;
+}
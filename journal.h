@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <type_traits>
+#include <vector>
+
+#include "data.h"
+#include "memory.h"
+#include "stepper.h"
+
+static_assert(std::is_trivially_copyable_v<State>);
+static_assert(sizeof(State) % sizeof(uint32_t) == 0);
+
+/* The old value of every word of State written during one tick, by runs
+   of consecutive words, replayed backward to step back without any
+   checkpoint.
+
+   What a tick may change is saved before it in a Snapshot : the live
+   slots and their draws, what lies between var_ and draws_ (var_, the
+   bitmaps, keys_ and the globals), the rules' draws and the contacts.
+   Only that is compared once the tick is over, the cost following the
+   number of objects and not the capacity. A slot spawned into was free,
+   its old contents are not kept : step_back frees it again, as free()
+   would. Nor is allocated_, scratch of compute. What a later tick may
+   overwrite without the journal of this one seeing it, a slot freed or
+   contacts past the new count, is kept whole */
+class Journal
+{
+public:
+    // count_ words of words_ from first_, to be written back at offset_
+    struct Run
+    {
+        uint32_t offset_;
+        uint32_t first_;
+        uint32_t count_;
+    };
+
+    class Snapshot
+    {
+        friend class Journal;
+
+        template <typename T>
+        using Buffer = std::vector<T, TaggedAllocator<T, MEMORY_HISTORY>>;
+
+        Buffer<int> slots_;
+        Buffer<StateObject> objects_;
+        Buffer<uint32_t> draws_;
+        Buffer<uint64_t> touching_;
+        Buffer<unsigned char> globals_;
+        uint32_t rules_draws_{0};
+        int32_t drawing_{0};
+        uint32_t nb_touching_{0};
+
+    public:
+        void take(const State &st);
+    };
+
+private:
+    std::vector<Run, TaggedAllocator<Run, MEMORY_HISTORY>> runs_;
+    std::vector<uint32_t, TaggedAllocator<uint32_t, MEMORY_HISTORY>> words_;
+
+    /* the word of old at offset, the run going on if it follows the last */
+    void push(uint32_t offset, uint32_t old);
+    /* the words of after at offset differing from old */
+    void add(const State &after, uint32_t offset, const void *old, uint32_t size);
+    /* every word of old, whatever after holds at offset */
+    void keep(uint32_t offset, const void *old, uint32_t size);
+
+public:
+    void record(const Snapshot &before, const State &after);
+    void undo(State &st) const;
+
+    /* bytes the runs and the words take */
+    size_t size() const
+    {
+        return runs_.size() * sizeof(Run) + words_.size() * sizeof(uint32_t);
+    }
+};
+
+/* journals of the last max_ticks_ ticks, stepped in place */
+class UndoHistory
+{
+    Stepper stepper_;
+    Journal::Snapshot before_;
+    std::deque<Journal> journals_;
+    size_t max_ticks_;
+
+public:
+    UndoHistory(const ObjData::Level &level, size_t max_ticks, ThreadPool *pool = nullptr)
+        : stepper_(level, pool), max_ticks_(max_ticks)
+    {
+    }
+
+    /* computes the next tick in place, see Stepper::step, and journals
+       it */
+    void step(State &st, const KeyStrokes *k, size_t nb_keys);
+
+    /* false if the journal is exhausted */
+    bool step_back(State &st);
+
+    size_t depth() const
+    {
+        return journals_.size();
+    }
+
+    /* see Journal::size */
+    size_t size() const
+    {
+        size_t result = 0;
+        for (const auto &journal : journals_)
+            result += journal.size();
+        return result;
+    }
+
+    void clear()
+    {
+        journals_.clear();
+    }
+};
@@ -0,0 +1,668 @@
+#include "dependencies.h"
+#include "objectdata.h"
+#include "proximity.h"
+#include "stepper.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cstring>
+#include <set>
+#include <tuple>
+
+using namespace ObjData;
+
+namespace
+{
+    /* resting against something is no change */
+    bool wakes(const CollisionEvts &evts)
+    {
+        return std::any_of(evts.begin(), evts.end(), [](const CollisionEvt &evt)
+        {
+            return evt.contact_ != CONTACT_STAY;
+        });
+    }
+
+    void execute_slot(const Level &level,
+                      State &st,
+                      int self,
+                      const CollisionEvts &evts,
+                      const ProximityIndex &near,
+                      int phase)
+    {
+        const auto &so = st.slots_[self];
+        if (so.type_ == 255)
+            return;
+        // a sleeping object only wakes up on a contact starting or ending
+        if (st.asleep(self) && !wakes(evts))
+            return;
+        level.object(so.type_).execute(st, self, evts, near, phase);
+    }
+}
+
+void Stepper::execute(State &st, int self, int phase, DependencyLog *log)
+{
+    st.drawing_ = self;
+    if (log)
+        log->execute(st, self, phase, evts_[self], [&]
+        {
+            execute_slot(level_, st, self, evts_[self], near_, phase);
+        });
+    else
+        execute_slot(level_, st, self, evts_[self], near_, phase);
+}
+
+/* the objects of block in slot order, those spawned into it during the
+   phase included, as the sequential loop runs them */
+void Stepper::run_block(State &local, int block, int phase, Buffer<std::pair<int, int>> &executed)
+{
+    executed.clear();
+    int end = (block + 1) * block_size_;
+    for (int self = local.next_live(block * block_size_); self < end; self = local.next_live(self + 1))
+    {
+        executed.emplace_back(self, int(local.slots_[self].type_));
+        execute(local, self, phase, nullptr);
+    }
+}
+
+/* what the blocks may read of st : the slots live in either, the
+   occupancy, var_, the draws of the live slots and the globals */
+void Stepper::sync(State &lane, const State &st)
+{
+    for (int slot = lane.next_live(0); slot != State::nb_slots_; slot = lane.next_live(slot + 1))
+        if (!st.live(slot))
+            lane.slots_[slot] = st.slots_[slot];
+    for (int slot = st.next_live(0); slot != State::nb_slots_; slot = st.next_live(slot + 1))
+    {
+        lane.slots_[slot] = st.slots_[slot];
+        lane.draws_[slot] = st.draws_[slot];
+    }
+    lane.var_ = st.var_;
+    lane.used_ = st.used_;
+    lane.full_ = st.full_;
+    lane.any_ = st.any_;
+    lane.keys_ = st.keys_;
+    lane.xscreen_ = st.xscreen_;
+    lane.yscreen_ = st.yscreen_;
+    lane.timestamp_ = st.timestamp_;
+    lane.rnd_ = st.rnd_;
+    lane.rng_ = st.rng_;
+    lane.draws_[State::nb_slots_] = st.draws_[State::nb_slots_];
+    lane.drawing_ = st.drawing_;
+    lane.nb_touching_ = st.nb_touching_;
+    std::copy_n(st.touching_.begin(), st.nb_touching_, lane.touching_.begin());
+}
+
+/* takes what block wrote out of the lane, st being the state as of the
+   start of the phase, and what it may have read. An object reads and
+   writes its own slot, the other side of its collision events, its
+   vars() and the slots it spawns, or declares READ_OTHERS. The block
+   also reads its whole range, where an earlier block may spawn */
+void Stepper::collect(Lane &lane, const State &st, int block, Block &result) const
+{
+    auto &local = lane.st_;
+    auto &read = result.read_slots_;
+    read.clear();
+    result.read_vars_.clear();
+    result.others_ = false;
+    for (int slot = block * block_size_; slot != (block + 1) * block_size_; ++slot)
+        read.push_back(slot);
+    for (auto [self, type] : lane.executed_)
+    {
+        for (const auto &evt : evts_[self])
+        {
+            if (evt.obj_spot_ >= 0)
+                read.push_back(evt.obj_spot_);
+            if (evt.obj_mask_ >= 0)
+                read.push_back(evt.obj_mask_);
+        }
+        const auto &object = level_.object(type);
+        result.others_ = result.others_ || object.reads() & READ_OTHERS;
+        result.read_vars_.insert(result.read_vars_.end(), object.vars().begin(), object.vars().end());
+    }
+    if (result.others_)
+        for (int slot = st.next_live(0); slot != State::nb_slots_; slot = st.next_live(slot + 1))
+            read.push_back(slot);
+    // allocate only gives the first free slots
+    for (int word = 0; word * 64 < local.allocated_; ++word)
+    {
+        uint64_t bits = ~st.used_[word];
+        if (local.allocated_ - word * 64 < 64)
+            bits &= ~(~uint64_t(0) << (local.allocated_ - word * 64));
+        for (; bits; bits &= bits - 1)
+            read.push_back(word * 64 + __builtin_ctzll(bits));
+    }
+
+    // a slot found twice is put back the first time
+    result.slots_.clear();
+    for (int slot : read)
+    {
+        if (local.draws_[slot] == st.draws_[slot]
+            && !std::memcmp(&local.slots_[slot], &st.slots_[slot], sizeof(StateObject)))
+            continue;
+        result.slots_.push_back({slot, local.slots_[slot], local.draws_[slot]});
+        local.set(slot, st.slots_[slot]);
+        local.draws_[slot] = st.draws_[slot];
+    }
+    result.vars_.clear();
+    if (local.var_ != st.var_)
+    {
+        // written, maybe read first
+        for (int var = 0; var != State::nb_vars_; ++var)
+            if (local.var_[var] != st.var_[var])
+            {
+                result.vars_.emplace_back(var, local.var_[var]);
+                result.read_vars_.push_back(var);
+            }
+        local.var_ = st.var_;
+    }
+    result.globals_ = local.xscreen_ != st.xscreen_ || local.yscreen_ != st.yscreen_ || local.rnd_ != st.rnd_;
+    result.xscreen_ = local.xscreen_;
+    result.yscreen_ = local.yscreen_;
+    result.rnd_ = local.rnd_;
+    local.xscreen_ = st.xscreen_;
+    local.yscreen_ = st.yscreen_;
+    local.rnd_ = st.rnd_;
+    result.allocated_ = local.allocated_;
+    local.drawing_ = st.drawing_;
+}
+
+/* the block ran on what the sequential loop would have given it */
+bool Stepper::valid(const Block &block) const
+{
+    if (dirty_.all_ || dirty_.globals_ || (block.allocated_ && dirty_.occupancy_))
+        return false;
+    if (block.others_ && (dirty_.any_slot_ || dirty_.vars_.any()))
+        return false;
+    return std::none_of(block.read_slots_.begin(), block.read_slots_.end(), [this](int slot) { return dirty_.marked(slot); })
+           && std::none_of(block.read_vars_.begin(), block.read_vars_.end(), [this](int var) { return dirty_.vars_[var]; });
+}
+
+void Stepper::apply(State &st, const Block &block)
+{
+    for (const auto &[slot, after, draws] : block.slots_)
+    {
+        dirty_.occupancy_ = dirty_.occupancy_ || st.live(slot) != (after.type_ != 255);
+        dirty_.mark(slot);
+        st.set(slot, after);
+        st.draws_[slot] = draws;
+    }
+    for (auto [var, value] : block.vars_)
+    {
+        st.var_[var] = value;
+        dirty_.vars_[var] = true;
+    }
+    if (block.globals_)
+    {
+        st.xscreen_ = block.xscreen_;
+        st.yscreen_ = block.yscreen_;
+        st.rnd_ = block.rnd_;
+        dirty_.globals_ = true;
+    }
+}
+
+/* the block on st itself, what it wrote being found against what it may
+   write, saved before */
+void Stepper::run_in_place(State &st, int block, int phase)
+{
+    auto &saved = saved_;
+    saved.clear();
+    auto keep = [&](int slot)
+    {
+        saved.push_back({slot, st.slots_[slot], st.draws_[slot]});
+    };
+    for (int slot = block * block_size_; slot != (block + 1) * block_size_; ++slot)
+    {
+        keep(slot);
+        if (!st.live(slot))
+            continue;
+        for (const auto &evt : evts_[slot])
+        {
+            if (evt.obj_spot_ >= 0)
+                keep(evt.obj_spot_);
+            if (evt.obj_mask_ >= 0)
+                keep(evt.obj_mask_);
+        }
+    }
+    saved_vars_.assign(st.var_.begin(), st.var_.end());
+    int32_t xscreen = st.xscreen_;
+    int32_t yscreen = st.yscreen_;
+    uint32_t rnd = st.rnd_;
+
+    st.allocated_ = 0;
+    run_block(st, block, phase, executed_);
+
+    for (auto [self, type] : executed_)
+        dirty_.all_ = dirty_.all_ || level_.object(type).reads() & READ_OTHERS;
+    for (const auto &[slot, before, draws] : saved)
+    {
+        if (st.draws_[slot] == draws && !std::memcmp(&st.slots_[slot], &before, sizeof(StateObject)))
+            continue;
+        dirty_.occupancy_ = dirty_.occupancy_ || (before.type_ != 255) != st.live(slot);
+        dirty_.mark(slot);
+    }
+    // the spawns lie among the live slots below allocated_
+    if (st.allocated_)
+    {
+        dirty_.occupancy_ = true;
+        for (int slot = st.next_live(0); slot < st.allocated_; slot = st.next_live(slot + 1))
+            dirty_.mark(slot);
+    }
+    for (int var = 0; var != State::nb_vars_; ++var)
+        if (st.var_[var] != saved_vars_[var])
+            dirty_.vars_[var] = true;
+    dirty_.globals_ = dirty_.globals_ || st.xscreen_ != xscreen || st.yscreen_ != yscreen || st.rnd_ != rnd;
+}
+
+void Stepper::execute_phase(State &st, int phase, ThreadPool *pool, DependencyLog *log)
+{
+    int nb_active = 0;
+    for (int slot = st.next_live(0);
+         slot != State::nb_slots_;
+         slot = st.next_live((slot / block_size_ + 1) * block_size_))
+        active_[nb_active++] = slot / block_size_;
+
+    // the sequential loop, on the state itself. The shared generator
+    // draws in slot order : any draw sends the blocks after it back
+    if (!pool || log || nb_active <= 1 || st.rng_ == RNG_LCG)
+    {
+        for (int self = st.next_live(0); self != State::nb_slots_; self = st.next_live(self + 1))
+            execute(st, self, phase, log);
+        return;
+    }
+
+    // the blocks run ahead on a lane per thread, st staying as of the
+    // start of the phase
+    int nb_lanes = std::min(nb_active, pool->size() + 1);
+    if (blocks_.size() < size_t(nb_blocks_))
+        blocks_.resize(nb_blocks_);
+    for (size_t lane = lanes_.size(); lane < size_t(nb_lanes); ++lane)
+    {
+        lanes_.emplace_back();
+        lanes_.back().st_.clear();
+    }
+    pool->run(nb_lanes, [&](int i)
+    {
+        auto &lane = lanes_[i];
+        sync(lane.st_, st);
+        for (int a = i * nb_active / nb_lanes; a != (i + 1) * nb_active / nb_lanes; ++a)
+        {
+            lane.st_.allocated_ = 0;
+            run_block(lane.st_, active_[a], phase, lane.executed_);
+            collect(lane, st, active_[a], blocks_[active_[a]]);
+        }
+    });
+
+    // then in slot order on st : a block run ahead is taken when nothing
+    // it read was written since the start of the phase, otherwise it
+    // runs again in place, as do the blocks only spawned into
+    for (int a = 0; a != nb_active; ++a)
+        ahead_[active_[a]] = true;
+    std::fill(dirty_.slots_.begin(), dirty_.slots_.end(), 0);
+    dirty_.vars_.reset();
+    dirty_.any_slot_ = dirty_.occupancy_ = dirty_.globals_ = dirty_.all_ = false;
+    for (int slot = st.next_live(0);
+         slot != State::nb_slots_;
+         slot = st.next_live((slot / block_size_ + 1) * block_size_))
+    {
+        int block = slot / block_size_;
+        if (ahead_[block] && valid(blocks_[block]))
+            apply(st, blocks_[block]);
+        else
+            run_in_place(st, block, phase);
+    }
+    for (int a = 0; a != nb_active; ++a)
+        ahead_[active_[a]] = false;
+}
+
+void Level::prepare()
+{
+    std::set<int> phases;
+    for (auto &object : object_)
+    {
+        object.prepare();
+        object.phases(phases);
+    }
+    for (const auto &rule : rules_)
+        phases.insert(rule.phase_);
+    phases_.assign(phases.begin(), phases.end());
+
+    static_sprites_.clear();
+    for (const auto &so : static_objects_)
+        static_sprites_.insert(object_[so.type_].instance(so, -1));
+}
+
+void Level::graphic(const State &st,
+                    Point2D camera,
+                    Point2D size,
+                    SpriteIndex &live,
+                    std::vector<SpriteInstance> &sis) const
+{
+    auto &found = live.scratch();
+    static_sprites_.query(camera, size, sis, found);
+
+    live.clear();
+    for (int self = st.next_live(0); self != State::nb_slots_; self = st.next_live(self + 1))
+        live.insert(object_[st.slots_[self].type_].graphic(st, self));
+    live.query(camera, size, sis, found);
+}
+
+namespace
+{
+    struct Box
+    {
+        fixed x1_, y1_, x2_, y2_;
+    };
+
+    bool overlap(const Box &box1, const Box &box2)
+    {
+        return box1.x1_ <= box2.x2_ && box2.x1_ <= box1.x2_
+               && box1.y1_ <= box2.y2_ && box2.y1_ <= box1.y2_;
+    }
+
+    Box spots_box(const SpriteInstance &si)
+    {
+        Box result{si.coor_.real(), si.coor_.imag(), si.coor_.real(), si.coor_.imag()};
+        for (const auto &spot : si.frame_->spots_)
+        {
+            auto pos = si.coor_ + spot;
+            result.x1_ = std::min(result.x1_, pos.real());
+            result.y1_ = std::min(result.y1_, pos.imag());
+            result.x2_ = std::max(result.x2_, pos.real());
+            result.y2_ = std::max(result.y2_, pos.imag());
+        }
+        return result;
+    }
+
+    // a pixel wider for the rounding
+    Box sprite_box(const SpriteInstance &si)
+    {
+        auto extent = si.extent();
+        return {si.coor_.real() - 1,
+                si.coor_.imag() - 1,
+                si.coor_.real() + (extent.real() + 1),
+                si.coor_.imag() + (extent.imag() + 1)};
+    }
+
+    CollisionCache::Contacts narrowphase(const SpriteInstance &spot_owner,
+                                         const SpriteInstance &mask_owner)
+    {
+        CollisionCache::Contacts result;
+        if (spot_owner.has_parallax_ || mask_owner.has_parallax_
+            || !overlap(spots_box(spot_owner), sprite_box(mask_owner)))
+            return result;
+        for (int spot = 0; spot != NUMBER_SPOTS; ++spot)
+            for (int mask = WALL; mask != NUMBER_MASKS; ++mask)
+                if (mask_owner.contains(static_cast<ID_MASK>(mask), spot_owner, static_cast<ID_SPOT>(spot)))
+                    result.set(spot * (NUMBER_MASKS - WALL) + mask - WALL);
+        return result;
+    }
+}
+
+void CollisionCache::update(const State &st, const SpriteInstances &sis)
+{
+    if (instances_.size() != size_t(State::nb_slots_))
+    {
+        instances_.assign(State::nb_slots_, Instance{});
+        moved_.assign(State::nb_slots_, false);
+    }
+    auto &moved = moved_;
+    previous_.swap(live_);
+    live_.clear();
+    bool any = false;
+    // the sprites of the previous pass gone since
+    for (int slot : previous_)
+    {
+        if (sis[slot].frame_)
+            continue;
+        moved[slot] = true;
+        any = true;
+        instances_[slot] = Instance{};
+    }
+    for (int slot = st.next_live(0); slot != State::nb_slots_; slot = st.next_live(slot + 1))
+    {
+        const auto &si = sis[slot];
+        if (!si.frame_)
+            continue;
+        Instance instance{si.frame_, si.coor_, si.has_parallax_};
+        live_.push_back(slot);
+        moved[slot] = !(instance == instances_[slot]);
+        any = any || moved[slot];
+        instances_[slot] = instance;
+    }
+    const auto &live = live_;
+    if (!any)
+        return;
+
+    pairs_.erase(std::remove_if(pairs_.begin(),
+                                pairs_.end(),
+                                [&moved](const Pair &pair)
+                                {
+                                    return moved[pair.spot_owner_] || moved[pair.mask_owner_];
+                                }),
+                 pairs_.end());
+
+    for (int slot : live)
+    {
+        if (!moved[slot])
+            continue;
+        for (int other : live)
+        {
+            // pairs of moved objects are done once
+            if (other == slot || (moved[other] && other < slot))
+                continue;
+            auto contacts = narrowphase(sis[slot], sis[other]);
+            if (contacts.any())
+                pairs_.push_back({slot, other, contacts});
+            contacts = narrowphase(sis[other], sis[slot]);
+            if (contacts.any())
+                pairs_.push_back({other, slot, contacts});
+            tested_ += 2;
+        }
+    }
+    std::sort(pairs_.begin(), pairs_.end(), [](const Pair &pair1, const Pair &pair2)
+    {
+        return std::tie(pair1.spot_owner_, pair1.mask_owner_) < std::tie(pair2.spot_owner_, pair2.mask_owner_);
+    });
+    for (int slot : previous_)
+        moved[slot] = false;
+    for (int slot : live)
+        moved[slot] = false;
+}
+
+void Level::collisions(const State &st,
+                       std::vector<CollisionEvts> &evts,
+                       CollisionCache *cache) const
+{
+    // without a cache, every object counts as moved
+    CollisionCache local;
+    auto &pairs = cache ? *cache : local;
+
+    // what the previous pass wrote is cleared, the buffers kept
+    auto &sis = pairs.sis_;
+    sis.resize(State::nb_slots_);
+    if (cache && evts.size() == size_t(State::nb_slots_))
+        for (int slot : pairs.live_)
+            evts[slot].clear();
+    else
+        evts.assign(State::nb_slots_, {});
+    for (int slot : pairs.live_)
+        sis[slot] = SpriteInstance{};
+    for (int self = st.next_live(0); self != State::nb_slots_; self = st.next_live(self + 1))
+        sis[self] = object_[st.slots_[self].type_].instance(st.slots_[self], self);
+    pairs.update(st, sis);
+
+    // a slot spawned since the previous pass touched nothing
+    auto touched = [&st](int spot_owner, int mask_owner, int mask)
+    {
+        return st.slots_[spot_owner].contacts_ >> (mask - WALL) & 1
+               && st.touching(spot_owner, mask_owner, mask);
+    };
+    auto &touching = pairs.touching_;
+    touching.clear();
+    auto it = pairs.pairs_.begin();
+    for (int self = st.next_live(0); self != State::nb_slots_; self = st.next_live(self + 1))
+    {
+        const auto &spot_owner = sis[self];
+        auto begin = it;
+        while (it != pairs.pairs_.end() && it->spot_owner_ == self)
+            ++it;
+        auto end = it;
+
+        for (int spot = 0; spot != NUMBER_SPOTS; ++spot)
+        {
+            for (int mask = WALL; mask != NUMBER_MASKS; ++mask)
+            {
+                CollisionEvt evt{static_cast<ID_SPOT>(spot), self, static_cast<ID_MASK>(mask), -1};
+                if (map_.contains(st.timestamp_, evt.id_mask_, spot_owner, evt.id_spot_))
+                {
+                    evt.contact_ = touched(self, -1, mask) ? CONTACT_STAY : CONTACT_ENTER;
+                    evts[self].push_back(evt);
+                    touching.push_back(State::touching_key(self, -1, mask));
+                }
+
+                for (auto pair = begin; pair != end; ++pair)
+                {
+                    if (!pair->contacts_.test(spot * (NUMBER_MASKS - WALL) + mask - WALL))
+                        continue;
+                    // the mask owner's copy tells the same transition
+                    evt.obj_mask_ = pair->mask_owner_;
+                    evt.contact_ = touched(self, evt.obj_mask_, mask) ? CONTACT_STAY : CONTACT_ENTER;
+                    evts[self].push_back(evt);
+                    evts[evt.obj_mask_].push_back(evt);
+                    touching.push_back(State::touching_key(self, evt.obj_mask_, mask));
+                }
+            }
+        }
+    }
+    std::sort(touching.begin(), touching.end());
+    touching.erase(std::unique(touching.begin(), touching.end()), touching.end());
+
+    // the contacts of the previous pass not found again, to both sides
+    for (uint32_t i = 0; i != st.nb_touching_; ++i)
+    {
+        uint64_t key = st.touching_[i];
+        int spot_owner = key >> 32;
+        int mask_owner = int(key >> 8 & 0xFFFFFF) - 1;
+        auto mask = static_cast<ID_MASK>(key & 0xFF);
+        if (!(st.slots_[spot_owner].contacts_ >> (mask - WALL) & 1)
+            || std::binary_search(touching.begin(), touching.end(), key))
+            continue;
+        CollisionEvt evt{NUMBER_SPOTS, spot_owner, mask, mask_owner, CONTACT_EXIT};
+        if (st.live(spot_owner))
+            evts[spot_owner].push_back(evt);
+        if (mask_owner >= 0 && mask_owner != spot_owner && st.live(mask_owner))
+            evts[mask_owner].push_back(evt);
+    }
+}
+
+void Stepper::step(State &st, const KeyStrokes *k, size_t nb_keys, DependencyLog *log)
+{
+    // the draws of the slots free now are zeroed when they spawn
+    live_ = st.used_;
+    for (int self = st.next_live(0); self != State::nb_slots_; self = st.next_live(self + 1))
+    {
+        const auto &so = st.slots_[self];
+        before_[self] = {so.pos_, so.speed_, uint8_t(so.type_), uint8_t(so.state_)};
+        st.draws_[self] = 0;
+    }
+    st.draws_[State::nb_slots_] = 0;
+    vars_ = st.var_;
+
+    level_.map().focus(st.xscreen_, st.yscreen_);
+    st.timestamp_++;
+    st.drawing_ = State::nb_slots_;
+    auto keys = st.keys_;
+    std::copy_n(k, std::min<size_t>(nb_keys, State::nb_players_), st.keys_.begin());
+    // a sleeping object reading the keys wakes up when they change
+    if (std::memcmp(&keys, &st.keys_, sizeof(keys)))
+        for (int self = st.next_live(0); self != State::nb_slots_; self = st.next_live(self + 1))
+            if (level_.object(st.slots_[self].type_).reads() & READ_KEYS)
+                st.wake(self);
+
+    auto &evts = evts_;
+    level_.collisions(st, evts, cache_);
+    for (int self = st.next_live(0); self != State::nb_slots_; self = st.next_live(self + 1))
+    {
+        uint32_t contacts = 0;
+        for (const auto &evt : evts[self])
+            if (evt.obj_spot_ == self && evt.contact_ != CONTACT_EXIT)
+                contacts |= 1 << (evt.id_mask_ - WALL);
+        st.slots_[self].contacts_ = contacts;
+    }
+    const auto &touching = cache_->touching();
+    st.nb_touching_ = std::min<size_t>(touching.size(), State::max_touching_);
+    std::copy_n(touching.begin(), st.nb_touching_, st.touching_.begin());
+    if (log)
+        log->begin(st, evts);
+
+    for (int phase : level_.phases())
+    {
+        near_.update(st);
+        execute_phase(st, phase, pool_, log);
+        st.drawing_ = State::nb_slots_;
+
+        // rules come after the objects, in the order they were added
+        auto run_rules = [&]
+        {
+            bool built = false;
+            for (const auto &rule : level_.rules())
+            {
+                if (rule.phase_ != phase)
+                    continue;
+                if (!built)
+                {
+                    slots_.build(st);
+                    near_.update(st);
+                }
+                built = true;
+                Rules::run(rule, st, evts, slots_, near_);
+            }
+        };
+        if (!log)
+            run_rules();
+        else if (std::any_of(level_.rules().begin(),
+                             level_.rules().end(),
+                             [phase](const Rules::Rule &rule) { return rule.phase_ == phase; }))
+            log->execute(st, -1, phase, {}, run_rules);
+    }
+
+    for (int self = st.next_live(0); self != State::nb_slots_; self = st.next_live(self + 1))
+    {
+        const auto &before = before_[self];
+        auto &after = st.slots_[self];
+
+        // a slot free at the start of the tick was of type 255
+        bool unchanged = (live_[self / 64] >> (self % 64) & 1)
+                         && before.type_ == after.type_
+                         && before.pos_ == after.pos_
+                         && before.speed_ == after.speed_
+                         && before.state_ == after.state_
+                         && !wakes(evts[self])
+                         && level_.object(after.type_).can_sleep();
+        if (!unchanged)
+            st.wake(self);
+        else if (!st.asleep(self))
+            after.idle_++;
+
+        for (int var : level_.object(after.type_).vars())
+            if (st.var_[var] != vars_[var])
+                st.wake(self);
+    }
+
+    if (log)
+        log->end(st);
+    if (monitor_)
+        monitor_->sample(st.timestamp_);
+}
+
+State compute(const Level &level,
+              const State &previous,
+              std::vector<KeyStrokes> k,
+              ThreadPool *pool,
+              CollisionCache *cache,
+              DependencyLog *log)
+{
+    State st = previous;
+    Stepper(level, pool, cache).step(st, k.data(), k.size(), log);
+    return st;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <map>
+#include <string>
+
+#include "objectdata.h"
+
+namespace ObjData
+{
+    /* masks by their lower case name : 'ground', 'wall'... as the rules
+       and the layers of the baked art name them */
+    inline const std::map<std::string, int> &mask_names()
+    {
+        static const std::map<std::string, int> names{{"wall", WALL},
+                                                      {"ground", GROUND},
+                                                      {"target", TARGET},
+                                                      {"attack", ATTACK},
+                                                      {"ladder", LADDER},
+                                                      {"shield", SHIELD},
+                                                      {"portal", PORTAL},
+                                                      {"destroy", DESTROY},
+                                                      {"unspawn", UNSPAWN}};
+        return names;
+    }
+}
@@ -0,0 +1,78 @@
+#include "memory.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+
+const char *name(MemoryTag tag)
+{
+    static const char *names[NUMBER_MEMORY_TAGS] = {"history", "assets", "tick", "caches"};
+    return names[tag];
+}
+
+int MemoryMonitor::track(MemoryTag tag, Probe probe)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    probes_.emplace(next_probe_, std::make_pair(tag, std::move(probe)));
+    return next_probe_++;
+}
+
+void MemoryMonitor::untrack(int id)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    probes_.erase(id);
+}
+
+void MemoryMonitor::sample(uint32_t tick)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::array<int64_t, NUMBER_MEMORY_TAGS> probed{};
+    for (const auto &[id, probe] : probes_)
+        probed[probe.first] += probe.second();
+
+    // a rollback samples earlier ticks again
+    int64_t ticks = std::max<int64_t>(tick - last_tick_, 1);
+    for (int tag = 0; tag != NUMBER_MEMORY_TAGS; ++tag)
+    {
+        int64_t allocated = MemoryCounters::allocated_[tag].load(std::memory_order_relaxed);
+        auto &stats = stats_[tag];
+        stats.current_ = MemoryCounters::current_[tag].load(std::memory_order_relaxed) + probed[tag];
+        stats.peak_ = std::max(stats.peak_, stats.current_);
+        // a probe only tells how much it grew
+        if (sampled_)
+            stats.rate_ = double(allocated - allocated_[tag] + std::max<int64_t>(probed[tag] - probed_[tag], 0))
+                          / ticks;
+        allocated_[tag] = allocated;
+    }
+    probed_ = probed;
+    last_tick_ = tick;
+    sampled_ = true;
+
+    if (record_)
+        series_.push_back({tick, stats_});
+}
+
+bool MemoryMonitor::write_csv(const std::string &path) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    FILE *file = std::fopen(path.c_str(), "w");
+    if (!file)
+        return false;
+
+    std::fprintf(file, "tick");
+    for (int tag = 0; tag != NUMBER_MEMORY_TAGS; ++tag)
+    {
+        const char *tag_name = name(static_cast<MemoryTag>(tag));
+        std::fprintf(file, ",%s_current,%s_peak,%s_rate", tag_name, tag_name, tag_name);
+    }
+    std::fprintf(file, "\n");
+
+    for (const auto &row : series_)
+    {
+        std::fprintf(file, "%" PRIu32, row.tick_);
+        for (const auto &stats : row.stats_)
+            std::fprintf(file, ",%" PRId64 ",%" PRId64 ",%.1f", stats.current_, stats.peak_, stats.rate_);
+        std::fprintf(file, "\n");
+    }
+    return std::fclose(file) == 0;
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+enum MemoryTag {
+    MEMORY_HISTORY,
+    MEMORY_ASSETS,
+    MEMORY_TICK,
+    MEMORY_CACHES,
+    NUMBER_MEMORY_TAGS
+};
+
+const char *name(MemoryTag tag);
+
+/* bytes held and allocated so far through the tagged allocators */
+struct MemoryCounters
+{
+    static inline std::array<std::atomic<int64_t>, NUMBER_MEMORY_TAGS> current_{};
+    static inline std::array<std::atomic<int64_t>, NUMBER_MEMORY_TAGS> allocated_{};
+
+    static void allocate(MemoryTag tag, size_t bytes)
+    {
+        current_[tag].fetch_add(bytes, std::memory_order_relaxed);
+        allocated_[tag].fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    static void deallocate(MemoryTag tag, size_t bytes)
+    {
+        current_[tag].fetch_sub(bytes, std::memory_order_relaxed);
+    }
+};
+
+/* std::allocator counted under Tag, for the containers of a subsystem */
+template <typename T, MemoryTag Tag>
+struct TaggedAllocator
+{
+    using value_type = T;
+
+    template <typename U>
+    struct rebind
+    {
+        using other = TaggedAllocator<U, Tag>;
+    };
+
+    TaggedAllocator() = default;
+
+    template <typename U>
+    TaggedAllocator(const TaggedAllocator<U, Tag> &)
+    {
+    }
+
+    T *allocate(size_t n)
+    {
+        MemoryCounters::allocate(Tag, n * sizeof(T));
+        return std::allocator<T>().allocate(n);
+    }
+
+    void deallocate(T *p, size_t n)
+    {
+        MemoryCounters::deallocate(Tag, n * sizeof(T));
+        std::allocator<T>().deallocate(p, n);
+    }
+
+    template <typename U>
+    bool operator==(const TaggedAllocator<U, Tag> &) const
+    {
+        return true;
+    }
+
+    template <typename U>
+    bool operator!=(const TaggedAllocator<U, Tag> &) const
+    {
+        return false;
+    }
+};
+
+/* Memory per tag, sampled once per tick : what the tagged allocators
+   hold plus what the probes report. Subsystems that already know their
+   size (caches...) register a probe rather than an allocator. Safe to
+   share between threads, a probe being called from the sampling one. */
+class MemoryMonitor
+{
+public:
+    using Probe = std::function<size_t ()>;
+
+    struct Stats
+    {
+        int64_t current_{0};
+        int64_t peak_{0};
+        // bytes allocated per tick since the previous sample
+        double rate_{0};
+    };
+
+private:
+    struct Row
+    {
+        uint32_t tick_;
+        std::array<Stats, NUMBER_MEMORY_TAGS> stats_;
+    };
+
+    mutable std::mutex mutex_;
+    std::map<int, std::pair<MemoryTag, Probe>> probes_;
+    int next_probe_{0};
+    std::array<Stats, NUMBER_MEMORY_TAGS> stats_;
+    std::array<int64_t, NUMBER_MEMORY_TAGS> allocated_{};
+    std::array<int64_t, NUMBER_MEMORY_TAGS> probed_{};
+    int64_t last_tick_{0};
+    bool sampled_{false};
+    bool record_;
+    std::vector<Row> series_;
+
+public:
+    /* record keeps every sample, for write_csv */
+    explicit MemoryMonitor(bool record = false)
+        : record_(record)
+    {
+    }
+
+    /* returns an id for untrack */
+    int track(MemoryTag tag, Probe probe);
+    void untrack(int id);
+
+    void sample(uint32_t tick);
+
+    Stats stats(MemoryTag tag) const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stats_[tag];
+    }
+
+    /* tick, then current, peak and rate of each tag */
+    bool write_csv(const std::string &path) const;
+};
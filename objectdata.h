@@ -1,13 +1,23 @@
 #pragma once
 
 #include <array>
+#include <bitset>
 #include <cstdint>
+#include <deque>
+#include <map>
 #include <vector>
 #include <memory>
+#include <optional>
 #include <set>
+#include <string>
+#include <unordered_map>
 
 #include "point.h"
 #include "data.h"
+#include "memory.h"
+#include "proximity.h"
+#include "rules.h"
+#include "tile_map.h"
 
 namespace ObjData
 {
@@ -40,15 +50,26 @@ namespace ObjData
     static constexpr int DEPTH_BITS = 4;
     static constexpr int NUMBER_ANIMATIONS = 256;
 
+    /* against the previous collision pass, for the spot owner, the mask
+       owner (-1 for the map) and the mask, whatever the spot. Both sides
+       get the events : an exit has no spot (NUMBER_SPOTS) */
+    enum ID_CONTACT {
+        CONTACT_ENTER,
+        CONTACT_STAY,
+        CONTACT_EXIT
+    };
+
     struct CollisionEvt
     {
         ID_SPOT id_spot_;
         int obj_spot_;
         ID_MASK id_mask_;
         int obj_mask_;
+        ID_CONTACT contact_{CONTACT_ENTER};
     };
 
-    using CollisionEvts = std::vector<CollisionEvt>;
+    // rebuilt every tick
+    using CollisionEvts = std::vector<CollisionEvt, TaggedAllocator<CollisionEvt, MEMORY_TICK>>;
 
     struct Pixel
     {
@@ -59,7 +80,7 @@ namespace ObjData
 
     struct Image
     {
-        std::vector<Pixel> content_;
+        std::vector<Pixel, TaggedAllocator<Pixel, MEMORY_ASSETS>> content_;
         int w_, h_, stride_; 
     };
 
@@ -99,31 +120,105 @@ namespace ObjData
         std::array<Point2D, NUMBER_SPOTS> spots_;
     };
 
+    /* Frames shared by every animation : the same pixels and spots are
+       stored once, wherever the rectangles lie and whatever the image.
+       A rectangle out of its image is told apart by its position. The
+       addresses stay valid */
+    class FrameStore
+    {
+        std::deque<FrameData, TaggedAllocator<FrameData, MEMORY_ASSETS>> frames_;
+        std::unordered_multimap<uint64_t,
+                                FrameData *,
+                                std::hash<uint64_t>,
+                                std::equal_to<uint64_t>,
+                                TaggedAllocator<std::pair<const uint64_t, FrameData *>, MEMORY_ASSETS>>
+            by_hash_;
+        size_t requests_{0};
+
+        static uint64_t hash(const FrameData &frame);
+
+    public:
+        const FrameData *intern(const FrameData &frame);
+
+        /* packs the rectangles of image used by the frames into a
+           smaller image, moving the sprites accordingly. To be done
+           before any RunLengths is baked */
+        void compact(Image &image);
+
+        size_t size() const
+        {
+            return frames_.size();
+        }
+
+        /* frames asked for, shared or not */
+        size_t requests() const
+        {
+            return requests_;
+        }
+
+        size_t bytes() const;
+    };
+
     class AnimationData
     {
         public:
-        std::vector<FrameData> frames_;
+        std::vector<const FrameData *, TaggedAllocator<const FrameData *, MEMORY_ASSETS>> frames_;
         bool loop_;
 
         const FrameData &get(uint32_t timestamp) const
         {
             if (loop_ || timestamp < frames_.size())
-                return frames_[timestamp % frames_.size()];
+                return *frames_[timestamp % frames_.size()];
             else
-                return frames_.back();
+                return *frames_.back();
         }
     };
 
+    /* the animations of an object, only those defined taking room */
     class GraphicData
     {
+        std::array<int16_t, NUMBER_ANIMATIONS> index_;
+        std::vector<AnimationData, TaggedAllocator<AnimationData, MEMORY_ASSETS>> animations_;
+
         public:
-        std::array<AnimationData, NUMBER_ANIMATIONS> animations_;
+        GraphicData()
+        {
+            index_.fill(-1);
+        }
+
+        AnimationData &add(int id)
+        {
+            if (index_[id] < 0)
+            {
+                index_[id] = animations_.size();
+                animations_.emplace_back();
+            }
+            return animations_[index_[id]];
+        }
+
+        const AnimationData *find(int id) const
+        {
+            return index_[id] < 0 ? nullptr : &animations_[index_[id]];
+        }
+
+        const AnimationData &animation(int id) const
+        {
+            return animations_[index_[id]];
+        }
+
+        size_t bytes() const
+        {
+            size_t result = sizeof(*this) + animations_.capacity() * sizeof(AnimationData);
+            for (const auto &animation : animations_)
+                result += animation.frames_.capacity() * sizeof(const FrameData *);
+            return result;
+        }
     };
 
     class SpriteInstance
     {
         public:
-            FrameData *frame_;
+            const FrameData *frame_;
             Point2D coor_;
             int order_;
             int id_;
@@ -136,7 +231,15 @@ namespace ObjData
                 Point2D delta = coor_ - camera;
                 fixed x = delta.real() * parallax_coeff_.real();
                 fixed y = delta.imag() * parallax_coeff_.imag();
-                return coor_ + (x, y);
+                return coor_ + Point2D(x, y);
+            }
+
+            /* size of the sprite on screen, its rectangle holding both
+               corners as inside() does */
+            IPoint2D extent() const
+            {
+                const auto &coor = frame_->sprite_.coor_;
+                return coor.second - coor.first + IPoint2D(1, 1);
             }
 
             bool contains(ID_MASK mask,
@@ -154,20 +257,79 @@ namespace ObjData
             }
     };
 
+    enum ID_SWEEP {
+        SWEEP_DOWN,
+        SWEEP_UP,
+        SWEEP_LEFT,
+        SWEEP_RIGHT,
+        NUMBER_SWEEPS
+    };
+
+    /* WALL and GROUND of a sprite baked, for each pixel and direction,
+       into the number of free pixels met before one of the mask, the
+       pixel itself included. A run reaching the border of the sprite
+       has edge_ set and its length to the border. */
+    class RunLengths
+    {
+        int x_{0}, y_{0}, w_{0}, h_{0};
+        std::array<std::vector<uint16_t, TaggedAllocator<uint16_t, MEMORY_ASSETS>>, 2 * NUMBER_SWEEPS> runs_;
+
+    public:
+        static constexpr uint16_t edge_ = 0x8000;
+
+        explicit RunLengths(const Sprite &sprite);
+
+        static bool baked(int mask)
+        {
+            return mask == WALL || mask == GROUND;
+        }
+
+        /* (x, y) in the image, inside the sprite */
+        uint16_t run(int mask, ID_SWEEP sweep, int x, int y) const
+        {
+            return runs_[(mask == GROUND) * NUMBER_SWEEPS + sweep][(x - x_) + (y - y_) * w_];
+        }
+    };
+
     class Map
     {
-        int w_cell_, h_cell_, w_, h_, stride_;
-        std::vector<const AnimationData *> map_;
+        int w_cell_{1}, h_cell_{1};
+        ChunkedMap cells_;
+        std::unordered_map<const Sprite *, RunLengths> runs_;
+
+    public:
+        /* nb_chunks resident at most, see ChunkedMap */
+        bool load(const std::string &path,
+                  int w_cell,
+                  int h_cell,
+                  std::vector<const AnimationData *> palette,
+                  size_t nb_chunks,
+                  ThreadPool *pool = nullptr)
+        {
+            w_cell_ = w_cell;
+            h_cell_ = h_cell;
+            runs_.clear();
+            for (const auto *animation : palette)
+                for (const auto *frame : animation->frames_)
+                    runs_.try_emplace(&frame->sprite_, frame->sprite_);
+            return cells_.open(path, std::move(palette), nb_chunks, pool);
+        }
+
+        /* to be called when xscreen_/yscreen_ change, the stepper does */
+        void focus(int32_t xscreen, int32_t yscreen) const
+        {
+            cells_.focus(xscreen / w_cell_, yscreen / h_cell_);
+        }
 
         std::pair<Point2D, const AnimationData *> get(Point2D pos) const
         {
             int x = (pos.real() / w_cell_).roundin();
             int y = (pos.imag() / h_cell_).roundin();
 
-            if (x >= 0 && y >= 0 && x < w_ && y < h_)
+            if (x >= 0 && y >= 0 && x < cells_.w() && y < cells_.h())
                 return {{pos.real() - x * w_cell_,
                          pos.imag() - y * h_cell_},
-                        map_[x + stride_ * y]};
+                        cells_.at(x, y)};
             else
                 return {{}, nullptr};
         }
@@ -187,10 +349,38 @@ namespace ObjData
                 return false;
 
             const auto &sprite = cell->get(timestamp).sprite_;
-            return sprite.contains(position, mask);
+            return sprite.contains(pos_in_cell, mask);
+        }
+
+        /* pixels pos can move by in sweep, up to length, before meeting
+           mask : the first i such that contains() holds at pos + i, or
+           length. A few lookups per tile crossed for WALL and GROUND */
+        int64_t sweep(uint32_t timestamp,
+                      ID_MASK mask,
+                      Point2D pos,
+                      ID_SWEEP sweep,
+                      int64_t length) const;
+
+        int64_t sweep(uint32_t timestamp,
+                      ID_MASK mask,
+                      const SpriteInstance &other,
+                      ID_SPOT spot,
+                      ID_SWEEP sweep,
+                      int64_t length) const
+        {
+            if (other.has_parallax_)
+                return length;
+            return this->sweep(timestamp, mask, other.coor_ + other.frame_->spots_[spot], sweep, length);
         }
     };
 
+    /* what an action reads besides its own slot, the other side of its
+       collision events and vars(), see DependencyLog */
+    enum ID_READ {
+        READ_KEYS = 1,   // keys_
+        READ_OTHERS = 2  // any other slot, the occupancy
+    };
+
     class Action
     {
     protected:
@@ -203,6 +393,8 @@ namespace ObjData
         {
         }
 
+        virtual ~Action() = default;
+
         /* order to execute, the lower the highest priority */
         int phase() const
         {
@@ -210,21 +402,48 @@ namespace ObjData
         }
 
         /* Initialisation on creation */
-        virtual void newobject(State &st, StateObject &) const
+        virtual void newobject(State &, StateObject &) const
         {
             return;
         }
 
-        /* do something */
-        virtual void execute(State &st, int self, const CollisionEvts &) const
+        /* true if newobject gives the same result for every spawn : it
+           reads neither the state, rnd, nor pos_ and src_. An action
+           whose newobject is such says so, the others run on every
+           spawn */
+        virtual bool spawn_constant() const
+        {
+            return false;
+        }
+
+        /* do something, the index being as of the start of the phase */
+        virtual void execute(State &, int, const CollisionEvts &, const ProximityIndex &) const
         {
         }
 
         /* render informaion */
-        virtual std::optional<SpriteInstance> graphic(const State &st, int self) const
+        virtual std::optional<SpriteInstance> graphic(const State &, int) const
         {
             return {};
         }
+
+        /* false if the action evolves on its own, without any change of
+           pos_, speed_ or state_ (timers...) */
+        virtual bool can_sleep() const
+        {
+            return true;
+        }
+
+        /* indices of var_ read by the action, a write wakes the object */
+        virtual void vars(std::vector<int> &) const
+        {
+        }
+
+        /* ID_READ flags */
+        virtual int reads() const
+        {
+            return 0;
+        }
     };
 
     class Object;
@@ -242,7 +461,7 @@ namespace ObjData
         }
 
         void newobject(State &st, StateObject &) const override;
-        void execute(State &st, int self, const CollisionEvts &) const override;
+        void execute(State &st, int self, const CollisionEvts &, const ProximityIndex &) const override;
     };
 
     class Walker : public Action //instance
@@ -259,7 +478,12 @@ namespace ObjData
         }
 
         void newobject(State &st, StateObject &) const override;
-        void execute(State &st, int self, const CollisionEvts &) const override;
+
+        bool spawn_constant() const override
+        {
+            return direction_ != RND;
+        }
+        void execute(State &st, int self, const CollisionEvts &, const ProximityIndex &) const override;
     };
 
     class CopyPosition : public Action //instance
@@ -271,7 +495,12 @@ namespace ObjData
         {
         }
 
-        void execute(State &st, int self, const CollisionEvts &) const override;
+        void execute(State &st, int self, const CollisionEvts &, const ProximityIndex &) const override;
+
+        int reads() const override
+        {
+            return READ_OTHERS;
+        }
     };
 
     class Fall : public Action //instance
@@ -301,7 +530,12 @@ namespace ObjData
         }
 
         void newobject(State &st, StateObject &) const override;
-        void execute(State &st, int self, const CollisionEvts &) const override;
+
+        bool spawn_constant() const override
+        {
+            return rnd_ == Point2D();
+        }
+        void execute(State &st, int self, const CollisionEvts &, const ProximityIndex &) const override;
     };
 
     class Seek : public Action //instance
@@ -309,30 +543,46 @@ namespace ObjData
         Point2D direction_; //must be normalized, 0 if no direction
         fixed acceleration_;
         fixed max_speed_;
-        fixed max_rotation_;
+        fixed max_rotation_; //grads per tick, 0 for no limit
         bool object_;
+        int target_{-1}; //type sought, -1 for any
 
-        void execute(State &st, int self, const CollisionEvts &) const override;
+        void execute(State &st, int self, const CollisionEvts &, const ProximityIndex &) const override;
+
+        int reads() const override
+        {
+            return READ_OTHERS;
+        }
     };
 
     class Plateform : public Action
     {
-        void execute(State &st, int self, const CollisionEvts &) const override;
+        void execute(State &st, int self, const CollisionEvts &, const ProximityIndex &) const override;
+
+        int reads() const override
+        {
+            return READ_OTHERS;
+        }
     };
 
     class Enemy : public Action
     {
-        void execute(State &st, int self, const CollisionEvts &) const override;
+        void execute(State &st, int self, const CollisionEvts &, const ProximityIndex &) const override;
+
+        int reads() const override
+        {
+            return READ_OTHERS;
+        }
     };
 
     class Hortense : public Action
     {
-        void execute(State &st, int self, const CollisionEvts &) const override;
-    };
+        void execute(State &st, int self, const CollisionEvts &, const ProximityIndex &) const override;
 
-    class Plateform : public Action
-    {
-        void execute(State &st, int self, const CollisionEvts &) const override;
+        int reads() const override
+        {
+            return READ_KEYS | READ_OTHERS;
+        }
     };
 
     class Spawner : public Action
@@ -344,7 +594,17 @@ namespace ObjData
         int max_nb_elts_;
         int max_spawn_;
 
-        void execute(State &st, int self, const CollisionEvts &) const override;
+        void execute(State &st, int self, const CollisionEvts &, const ProximityIndex &) const override;
+
+        bool can_sleep() const override
+        {
+            return false;
+        }
+
+        int reads() const override
+        {
+            return READ_OTHERS;
+        }
     };
 
     class Portal : public Action //instance
@@ -354,7 +614,12 @@ namespace ObjData
         bool all_animated_;
         bool one_at_a_time_;
 
-        void execute(State &st, int self, const CollisionEvts &) const override;
+        void execute(State &st, int self, const CollisionEvts &, const ProximityIndex &) const override;
+
+        int reads() const override
+        {
+            return READ_OTHERS;
+        }
     };
 
     class ChangeAnimation : public Action
@@ -362,6 +627,11 @@ namespace ObjData
         int var_index_;
 
         std::optional<SpriteInstance> graphic(const State &st, int self) const override;
+
+        void vars(std::vector<int> &result) const override
+        {
+            result.push_back(var_index_);
+        }
     };
 
     class Object
@@ -396,68 +666,395 @@ namespace ObjData
         GraphicData &graphic_;
 
         std::multiset<ActionPtr, Compare> actions_;
+        bool can_sleep_{true};
+        std::vector<int> vars_;
+        int reads_{0};
+        // spawn template : constant initialisers already applied,
+        // the others run on every spawn. pos_ and src_ being set before
+        // any initialiser, the template keeps them when one wrote them
+        StateObject prefab_{};
+        bool prefab_pos_{false};
+        bool prefab_src_{false};
+        std::vector<const Action *> initialisers_;
+
+    public:
+        Object(int type, GraphicData &graphic, int depth = 0, fixed parallax_coeff = 0)
+            : is_plateformable_(false),
+              is_ennemy_(false),
+              is_friendly_(false),
+              is_hortense_(false),
+              type_(type),
+              depth_(depth),
+              parallax_coeff_(parallax_coeff),
+              graphic_(graphic)
+        {
+        }
+
+        /* before prepare() */
+        void add_action(std::unique_ptr<Action> action)
+        {
+            actions_.insert(std::move(action));
+        }
 
-        void execute(State &st, int self, const CollisionEvts &evts, int phase)
+        /* to be called once all actions are added */
+        void prepare()
+        {
+            can_sleep_ = true;
+            vars_.clear();
+            reads_ = 0;
+            for (const auto &action : actions_)
+            {
+                can_sleep_ = can_sleep_ && action->can_sleep();
+                action->vars(vars_);
+                reads_ |= action->reads();
+            }
+
+            // twice, from two pos_ and src_ : those the initialisers
+            // wrote come out the same
+            prefab_ = StateObject{};
+            prefab_.type_ = type_;
+            StateObject other = prefab_;
+            other.pos_ = Point2D(fixed(1), fixed(1));
+            other.src_ = 1;
+            initialisers_.clear();
+            auto scratch = std::make_unique<State>();
+            scratch->clear();
+            for (const auto &action : actions_)
+            {
+                // past a per spawn initialiser, order has to be kept
+                if (initialisers_.empty() && action->spawn_constant())
+                {
+                    action->newobject(*scratch, prefab_);
+                    action->newobject(*scratch, other);
+                }
+                else
+                {
+                    initialisers_.push_back(action.get());
+                }
+            }
+            prefab_pos_ = prefab_.pos_ == other.pos_;
+            prefab_src_ = prefab_.src_ == other.src_;
+        }
+
+        bool can_sleep() const
+        {
+            return can_sleep_;
+        }
+
+        const std::vector<int> &vars() const
+        {
+            return vars_;
+        }
+
+        /* of every phase */
+        int reads() const
+        {
+            return reads_;
+        }
+
+        void phases(std::set<int> &result) const
+        {
+            for (const auto &action : actions_)
+                result.insert(action->phase());
+        }
+
+        /* sprite of an object, regardless of the actions */
+        SpriteInstance instance(const StateObject &so, int self) const
+        {
+            SpriteInstance si;
+            si.frame_ = &graphic_.animation(so.state_).get(so.state_no_);
+            si.coor_ = so.pos_;
+            si.order_ = depth_;
+            si.id_ = self;
+            si.parallax_coeff_ = Point2D(parallax_coeff_, parallax_coeff_);
+            si.has_parallax_ = parallax_coeff_ != 0;
+            si.object_ = self;
+            return si;
+        }
+
+        void execute(State &st,
+                     int self,
+                     const CollisionEvts &evts,
+                     const ProximityIndex &near,
+                     int phase) const
         {
             for (auto [begin, end] = actions_.equal_range(phase);
                  begin != end;
                  ++begin)
             {
                 const auto &action = *begin;
-                action->execute(st, self, evts);
+                action->execute(st, self, evts, near);
             }
         }
 
-        int newobject(State &st, int src, Point2D pos)
+        /* the slot of the spawn, -1 when full. The spawner wakes up
+           along with its spawn */
+        int newobject(State &st, int src, Point2D pos) const
         {
-            StateObject so;
-            so.pos_ = pos;
-            so.type_ = type_;
-            so.src_ = src;
-            for (const auto &action : actions_)
+            StateObject so = prefab_;
+            if (!prefab_pos_)
+                so.pos_ = pos;
+            if (!prefab_src_)
+                so.src_ = src;
+            for (const Action *action : initialisers_)
                 action->newobject(st, so);
-            return st.allocate(so);
+            int slot = st.allocate(so);
+            if (slot >= 0 && src >= 0 && src < State::nb_slots_)
+                st.wake(src);
+            return slot;
         };
 
-        void graphic(const State &st, int self, std::vector<SpriteInstance> &sis)
+        /* k spawns at once, slots receives their slots (-1 when full),
+           returns the number spawned. As many calls to newobject */
+        int newobjects(State &st, int src, const Point2D *pos, int k, int *slots) const
         {
-            for (const auto &action : actions_)
+            int result = 0;
+            StateObject so = prefab_;
+            if (!prefab_src_)
+                so.src_ = src;
+            for (int i = 0; i != k; ++i)
             {
-                if (auto smth = action->graphic(st, self); smth)
-                {
-                    sis.emplace_back(*smth);
-                    return;
-                }
+                StateObject spawned = so;
+                if (!prefab_pos_)
+                    spawned.pos_ = pos[i];
+                for (const Action *action : initialisers_)
+                    action->newobject(st, spawned);
+                slots[i] = st.allocate(spawned);
+                if (slots[i] < 0)
+                    continue;
+                ++result;
+                if (src >= 0 && src < State::nb_slots_)
+                    st.wake(src);
             }
-            SpriteInstance si;
-            const StateObject &so = st[self];
-            si.sprite_ = &graphic_.animations_[so.state_].frames_[so.state_no_].sprite_;
-            si.coor_ = so.pos_;
-            si.depth_ = depth_;
-            si.id_ = sis.size();
-            si.parallax_coeff_ = parallax_coeff_;
-            si.object_ = self;
-            sis.emplace_back(si);
+            return result;
+        }
+
+        SpriteInstance graphic(const State &st, int self) const
+        {
+            for (const auto &action : actions_)
+                if (auto smth = action->graphic(st, self); smth)
+                    return *smth;
+            return instance(st.slots_[self], self);
         }
     };
 
     static_assert(NUMBER_SPOTS <= 24);
 
+    /* Loose grid : a sprite goes in the cell of its origin, queries are
+       widened by the largest sprite. A parallax sprite shows at
+       coor_ + c * (coor_ - camera), so there is one grid per parallax
+       coefficient, queried with the viewport scaled by 1 / (1 + c) */
+    class SpriteIndex
+    {
+        struct Layer
+        {
+            Point2D coeff_;
+            IPoint2D max_extent_;
+            std::unordered_map<uint64_t, std::vector<int>> cells_;
+        };
+
+        int cell_size_;
+        std::vector<SpriteInstance> sprites_;
+        std::vector<Layer> layers_;
+        std::vector<int> found_;
+
+        static uint64_t key(int64_t x, int64_t y)
+        {
+            return static_cast<uint32_t>(x) | static_cast<uint64_t>(y) << 32;
+        }
+
+    public:
+        explicit SpriteIndex(int cell_size = 256)
+            : cell_size_(cell_size)
+        {
+        }
+
+        /* keeps the buckets allocated */
+        void clear();
+        void insert(const SpriteInstance &si);
+
+        /* sprites overlapping [camera, camera + size] once moved by
+           SpriteInstance::pos, in insertion order. A layer whose
+           coefficient is -1 or less does not follow the camera the way
+           the grid assumes : every sprite of it is tested. found is the
+           caller's scratch */
+        void query(Point2D camera,
+                   Point2D size,
+                   std::vector<SpriteInstance> &result,
+                   std::vector<int> &found) const;
+
+        /* a scratch for query, for the caller owning the index */
+        std::vector<int> &scratch()
+        {
+            return found_;
+        }
+
+        size_t size() const
+        {
+            return sprites_.size();
+        }
+    };
+
+    /* contacts between objects found by the previous collision pass,
+       kept for the pairs of objects whose sprites neither moved nor
+       changed frame : only the others go through the narrowphase */
+    class CollisionCache
+    {
+        friend class Level;
+
+    public:
+        // bit spot * (NUMBER_MASKS - WALL) + mask - WALL
+        using Contacts = std::bitset<NUMBER_SPOTS * (NUMBER_MASKS - WALL)>;
+        struct Pair
+        {
+            int spot_owner_;
+            int mask_owner_;
+            Contacts contacts_;
+        };
+        using Pairs = std::vector<Pair, TaggedAllocator<Pair, MEMORY_TICK>>;
+        using SpriteInstances = std::vector<SpriteInstance, TaggedAllocator<SpriteInstance, MEMORY_TICK>>;
+
+    private:
+        struct Instance
+        {
+            const FrameData *frame_{nullptr};
+            Point2D coor_;
+            bool has_parallax_{false};
+
+            bool operator==(const Instance &other) const
+            {
+                return frame_ == other.frame_
+                       && coor_ == other.coor_
+                       && has_parallax_ == other.has_parallax_;
+            }
+        };
+
+        // indexed by slot, allocated at the first pass
+        std::vector<Instance, TaggedAllocator<Instance, MEMORY_TICK>> instances_;
+        std::vector<bool, TaggedAllocator<bool, MEMORY_TICK>> moved_;
+        // non empty only, by spot owner then mask owner
+        Pairs pairs_;
+        size_t tested_{0};
+        // the slots with a sprite at the last pass and the one before
+        std::vector<int, TaggedAllocator<int, MEMORY_TICK>> live_;
+        std::vector<int, TaggedAllocator<int, MEMORY_TICK>> previous_;
+        // scratch of Level::collisions
+        SpriteInstances sis_;
+        std::vector<uint64_t, TaggedAllocator<uint64_t, MEMORY_TICK>> touching_;
+
+    public:
+        /* sis indexed by slot, set for the live slots of st and null for
+           the others with a sprite at the previous update */
+        void update(const State &st, const SpriteInstances &sis);
+
+        const Pairs &pairs() const
+        {
+            return pairs_;
+        }
+
+        /* State::touching_key of the contacts of the last pass, sorted */
+        const std::vector<uint64_t, TaggedAllocator<uint64_t, MEMORY_TICK>> &touching() const
+        {
+            return touching_;
+        }
+
+        /* ordered pairs that went through the narrowphase so far */
+        size_t tested() const
+        {
+            return tested_;
+        }
+    };
+
     class Level
     {
-        std::vector<GraphicData> graphics_;
+        FrameStore frames_;
+        // referenced by the objects
+        std::deque<GraphicData, TaggedAllocator<GraphicData, MEMORY_ASSETS>> graphics_;
         //smth music
         std::vector<Path> paths_;
         std::vector<Object> object_;
         std::vector<StateObject> static_objects_;
         Map map_;
+        std::vector<int> phases_;
+        std::vector<Rules::Rule> rules_;
+        SpriteIndex static_sprites_;
 
         CollisionEvts collisions(ID_MASK id_mask,
                                  ID_SPOT id_spot,
                                  int type);
+
+    public:
+        /* to be called once the level is loaded */
+        void prepare();
+
+        const Object &object(int type) const
+        {
+            return object_[type];
+        }
+
+        const std::vector<int> &phases() const
+        {
+            return phases_;
+        }
+
+        /* before prepare(), type is the index in the order of addition */
+        GraphicData &add_graphic()
+        {
+            return graphics_.emplace_back();
+        }
+
+        Object &add_object(GraphicData &graphic, int depth = 0, fixed parallax_coeff = 0)
+        {
+            return object_.emplace_back(object_.size(), graphic, depth, parallax_coeff);
+        }
+
+        void add_rule(Rules::Rule rule)
+        {
+            rules_.push_back(std::move(rule));
+        }
+
+        const std::vector<Rules::Rule> &rules() const
+        {
+            return rules_;
+        }
+
+        Map &map()
+        {
+            return map_;
+        }
+
+        const Map &map() const
+        {
+            return map_;
+        }
+
+        /* frames are to be interned there by the loader */
+        FrameStore &frames()
+        {
+            return frames_;
+        }
+
+        /* sprites visible from camera, size being the viewport's. live
+           is the caller's scratch for the objects, one per thread
+           rendering */
+        void graphic(const State &st,
+                     Point2D camera,
+                     Point2D size,
+                     SpriteIndex &live,
+                     std::vector<SpriteInstance> &sis) const;
+
+        /* collision events of every live slot, indexed by slot, in the
+           same order with or without a cache. Exits come last. With a
+           cache, evts is the one given along with it at the previous
+           pass : only the slots live then are cleared */
+        void collisions(const State &st,
+                        std::vector<CollisionEvts> &evts,
+                        CollisionCache *cache = nullptr) const;
     };
 }
 
 //Touch(Every(condition),All(),'ground')
 //
-//Lambda(Every(chauve), Char(), And(Near(300),Equals(Var1('A'),5)), Set(Field, '+5'))
\ No newline at end of file
+//Lambda(Every(chauve), Char(), And(Near(300),Equals(Var1('A'),5)), Set(Field, '+5'))
+//
+//see rules.h
\ No newline at end of file
@@ -1,24 +1,163 @@
 #pragma once
 
-#include <complex>
 #include <cstdint>
 #include <utility>
 #include "fixed.h"
 
-using Point2D = std::complex<fixed>;
-using IPoint2D = std::complex<int32_t>;
+/* 2D vector, constexpr replacement of std::complex which is unspecified
+   for non floating types. Keeps its real()/imag() interface */
+template <typename T>
+struct Vec2
+{
+    using value_type = T;
+
+    T x_;
+    T y_;
+
+    constexpr Vec2(T x = T(), T y = T())
+        : x_(x), y_(y)
+    {
+    }
+
+    constexpr T real() const
+    {
+        return x_;
+    }
+
+    constexpr T imag() const
+    {
+        return y_;
+    }
+
+    constexpr void real(T x)
+    {
+        x_ = x;
+    }
+
+    constexpr void imag(T y)
+    {
+        y_ = y;
+    }
+
+    constexpr Vec2 &operator+=(Vec2 other)
+    {
+        x_ += other.x_;
+        y_ += other.y_;
+        return *this;
+    }
+
+    constexpr Vec2 &operator-=(Vec2 other)
+    {
+        x_ -= other.x_;
+        y_ -= other.y_;
+        return *this;
+    }
+
+    // complex product
+    constexpr Vec2 &operator*=(Vec2 other)
+    {
+        T x = x_ * other.x_ - y_ * other.y_;
+        y_ = x_ * other.y_ + y_ * other.x_;
+        x_ = x;
+        return *this;
+    }
+
+    constexpr Vec2 &operator*=(T other)
+    {
+        x_ *= other;
+        y_ *= other;
+        return *this;
+    }
+
+    constexpr Vec2 &operator/=(T other)
+    {
+        x_ /= other;
+        y_ /= other;
+        return *this;
+    }
+};
+
+template <typename T>
+constexpr Vec2<T> operator+(Vec2<T> vect, Vec2<T> other)
+{
+    vect += other;
+    return vect;
+}
+
+template <typename T>
+constexpr Vec2<T> operator-(Vec2<T> vect, Vec2<T> other)
+{
+    vect -= other;
+    return vect;
+}
+
+template <typename T>
+constexpr Vec2<T> operator-(Vec2<T> vect)
+{
+    return {-vect.x_, -vect.y_};
+}
+
+template <typename T>
+constexpr Vec2<T> operator*(Vec2<T> vect, Vec2<T> other)
+{
+    vect *= other;
+    return vect;
+}
+
+template <typename T>
+constexpr Vec2<T> operator*(Vec2<T> vect, typename Vec2<T>::value_type other)
+{
+    vect *= other;
+    return vect;
+}
+
+template <typename T>
+constexpr Vec2<T> operator*(typename Vec2<T>::value_type other, Vec2<T> vect)
+{
+    vect *= other;
+    return vect;
+}
+
+template <typename T>
+constexpr Vec2<T> operator/(Vec2<T> vect, typename Vec2<T>::value_type other)
+{
+    vect /= other;
+    return vect;
+}
+
+template <typename T>
+constexpr bool operator==(Vec2<T> vect, Vec2<T> other)
+{
+    return vect.x_ == other.x_ && vect.y_ == other.y_;
+}
+
+template <typename T>
+constexpr bool operator!=(Vec2<T> vect, Vec2<T> other)
+{
+    return !(vect == other);
+}
+
+template <typename T>
+constexpr Vec2<T> conj(Vec2<T> vect)
+{
+    return {vect.x_, -vect.y_};
+}
+
+using Point2D = Vec2<fixed>;
+using IPoint2D = Vec2<int32_t>;
 using Rectangle = std::pair<Point2D, Point2D>;
 using IRectangle = std::pair<IPoint2D, IPoint2D>;
 
-const Point2D baseX(1,0);
-const Point2D baseY(0,1);
+constexpr Point2D baseX(1,0);
+constexpr Point2D baseY(0,1);
 
-Point2D expj(fixed angle)
+template <int F, typename S, typename W>
+constexpr Vec2<basic_fixed<F, S, W>> expj(basic_fixed<F, S, W> angle)
 {
-    return baseX * cos(angle) + baseY * sin(angle);
+    return {cos(angle), sin(angle)};
 }
 
-bool inside(Rectangle r, Point2D p)
+constexpr bool inside(Rectangle r, Point2D p)
 {
     return r.first.real() <= p.real()
            && r.first.imag() <= p.imag()
@@ -26,10 +165,67 @@ bool inside(Rectangle r, Point2D p)
            && r.second.imag() >= p.imag();
 }
 
-bool inside(IRectangle r, IPoint2D p)
+constexpr bool inside(IRectangle r, IPoint2D p)
 {
     return r.first.real() <= p.real()
            && r.first.imag() <= p.imag()
            && r.second.real() >= p.real()
            && r.second.imag() >= p.imag();
 }
+
+/* floor of the exact norm, computed on the raw values. These are scaled
+   down first when their squares would not fit */
+template <int F, typename S, typename W>
+constexpr basic_fixed<F, S, W> hypot(Vec2<basic_fixed<F, S, W>> vect)
+{
+    auto magnitude = [](S value)
+    {
+        return value < 0 ? -uint64_t(value) : uint64_t(value);
+    };
+    uint64_t x = magnitude(vect.real().value_);
+    uint64_t y = magnitude(vect.imag().value_);
+    int shift = 0;
+    while ((x | y) >> 31)
+    {
+        x >>= 1;
+        y >>= 1;
+        shift++;
+    }
+    return basic_fixed<F, S, W>(S(isqrt(x * x + y * y) << shift), basic_fixed<F, S, W>::raw);
+}
+
+template <int F, typename S, typename W>
+constexpr basic_fixed<F, S, W> hypot(basic_fixed<F, S, W> x, basic_fixed<F, S, W> y)
+{
+    return hypot(Vec2<basic_fixed<F, S, W>>(x, y));
+}
+
+/* angle of vect in grads, in [0, 400), rounded down to the raw unit.
+   Turned by quarters into [0, 100) first, then bisected on the side of
+   vect against expj */
+template <int F, typename S, typename W>
+constexpr basic_fixed<F, S, W> atan2(Vec2<basic_fixed<F, S, W>> vect)
+{
+    using T = basic_fixed<F, S, W>;
+    if (vect == Vec2<T>())
+        return 0;
+
+    T quarters = 0;
+    while (!(vect.real() > 0 && vect.imag() >= 0))
+    {
+        vect = {vect.imag(), -vect.real()};
+        quarters += 100;
+    }
+
+    S low = 0;
+    S high = 100 * T::fracexp_;
+    while (high - low > 1)
+    {
+        T angle(low + (high - low) / 2, T::raw);
+        if (cos(angle) * vect.imag() > sin(angle) * vect.real())
+            low = angle.value_;
+        else
+            high = angle.value_;
+    }
+    return quarters + T(low, T::raw);
+}
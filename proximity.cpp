@@ -0,0 +1,216 @@
+#include "proximity.h"
+#include "objectdata.h"
+
+#include <algorithm>
+
+ProximityIndex::ProximityIndex(int cell_size)
+    : cell_size_(cell_size), keys_(State::nb_slots_), pos_(State::nb_slots_)
+{
+    clear();
+}
+
+void ProximityIndex::clear()
+{
+    for (auto &[key, cell] : cells_)
+        cell.clear();
+    std::fill(keys_.begin(), keys_.end(), none_);
+    std::fill(pos_.begin(), pos_.end(), IPoint2D());
+    indexed_.fill(0);
+    count_.fill(0);
+    total_ = 0;
+}
+
+void ProximityIndex::update(const State &st)
+{
+    // the slots freed since, then the live ones
+    for (int word = 0; word != State::nb_words_; ++word)
+        for (uint64_t bits = indexed_[word] & ~st.used_[word]; bits; bits &= bits - 1)
+            update(st, word * 64 + __builtin_ctzll(bits));
+    for (int slot = st.next_live(0); slot != State::nb_slots_; slot = st.next_live(slot + 1))
+        update(st, slot);
+}
+
+void ProximityIndex::update(const State &st, int slot)
+{
+    const auto &so = st.slots_[slot];
+    uint64_t key = none_;
+    if (st.live(slot))
+    {
+        IPoint2D pos(so.pos_.real().roundin(), so.pos_.imag().roundin());
+        pos_[slot] = pos;
+        key = this->key(so.type_, cell(pos.real()), cell(pos.imag()));
+    }
+    if (key == keys_[slot])
+        return;
+
+    if (keys_[slot] != none_)
+    {
+        auto &cell = cells_[keys_[slot]];
+        cell.erase(std::find(cell.begin(), cell.end(), slot));
+        count_[keys_[slot] >> 48]--;
+        total_--;
+    }
+    if (key != none_)
+    {
+        cells_[key].push_back(slot);
+        count_[so.type_]++;
+        total_++;
+    }
+    keys_[slot] = key;
+    uint64_t bit = uint64_t(1) << (slot % 64);
+    if (key != none_)
+        indexed_[slot / 64] |= bit;
+    else
+        indexed_[slot / 64] &= ~bit;
+}
+
+void ProximityIndex::ring(int type,
+                          int64_t cx,
+                          int64_t cy,
+                          int64_t ring,
+                          std::vector<int> &result) const
+{
+    if (type < 0)
+    {
+        for (int t = 0; t != 256; ++t)
+            if (count_[t])
+                this->ring(t, cx, cy, ring, result);
+        return;
+    }
+
+    auto visit = [&](int64_t x, int64_t y)
+    {
+        auto it = cells_.find(key(type, x, y));
+        if (it != cells_.end())
+            result.insert(result.end(), it->second.begin(), it->second.end());
+    };
+
+    if (ring == 0)
+    {
+        visit(cx, cy);
+        return;
+    }
+    for (int64_t x = cx - ring; x <= cx + ring; ++x)
+    {
+        visit(x, cy - ring);
+        visit(x, cy + ring);
+    }
+    for (int64_t y = cy - ring + 1; y < cy + ring; ++y)
+    {
+        visit(cx - ring, y);
+        visit(cx + ring, y);
+    }
+}
+
+void ProximityIndex::radius(int type,
+                            IPoint2D center,
+                            int64_t radius,
+                            std::vector<int> &result) const
+{
+    if (radius < 0 || !count(type))
+        return;
+
+    int64_t x1 = cell(std::max<int64_t>(center.real() - radius, INT32_MIN));
+    int64_t y1 = cell(std::max<int64_t>(center.imag() - radius, INT32_MIN));
+    int64_t x2 = cell(std::min<int64_t>(center.real() + radius, INT32_MAX));
+    int64_t y2 = cell(std::min<int64_t>(center.imag() + radius, INT32_MAX));
+    int first_type = type < 0 ? 0 : type;
+    int last_type = type < 0 ? 255 : type;
+
+    auto inside = [&](int slot)
+    {
+        int64_t dx = pos_[slot].real() - int64_t(center.real());
+        int64_t dy = pos_[slot].imag() - int64_t(center.imag());
+        return dx * dx + dy * dy <= radius * radius;
+    };
+
+    // a wide radius is cheaper to answer from the slots
+    if ((x2 - x1 + 1) * (y2 - y1 + 1) * lookup_cost_ > total_)
+    {
+        scan([&](int slot)
+        {
+            if ((type < 0 || int(keys_[slot] >> 48) == type) && inside(slot))
+                result.push_back(slot);
+        });
+        return;
+    }
+
+    size_t begin = result.size();
+    for (int t = first_type; t <= last_type; ++t)
+    {
+        if (!count_[t])
+            continue;
+        for (int64_t y = y1; y <= y2; ++y)
+        {
+            for (int64_t x = x1; x <= x2; ++x)
+            {
+                auto it = cells_.find(key(t, x, y));
+                if (it == cells_.end())
+                    continue;
+                for (int slot : it->second)
+                    if (inside(slot))
+                        result.push_back(slot);
+            }
+        }
+    }
+    std::sort(result.begin() + begin, result.end());
+}
+
+void ProximityIndex::nearest(int type,
+                             IPoint2D center,
+                             int k,
+                             std::vector<int> &result) const
+{
+    int total = count(type);
+    if (k <= 0 || !total)
+        return;
+
+    auto distance = [this, center](int slot)
+    {
+        int64_t dx = pos_[slot].real() - int64_t(center.real());
+        int64_t dy = pos_[slot].imag() - int64_t(center.imag());
+        return dx * dx + dy * dy;
+    };
+
+    // reused by every call of the thread
+    thread_local std::vector<std::pair<int64_t, int>> found;
+    thread_local std::vector<int> slots;
+    found.clear();
+    int64_t cx = cell(center.real());
+    int64_t cy = cell(center.imag());
+    for (int64_t d = 0; int(found.size()) != total; ++d)
+    {
+        // the objects are far apart : scan them all, before the rings
+        // cost more than half of it
+        if ((2 * d + 1) * (2 * d + 1) * lookup_cost_ > total_ / 2)
+        {
+            found.clear();
+            scan([&](int slot)
+            {
+                if (type < 0 || int(keys_[slot] >> 48) == type)
+                    found.emplace_back(distance(slot), slot);
+            });
+            break;
+        }
+
+        slots.clear();
+        ring(type, cx, cy, d, slots);
+        for (int slot : slots)
+            found.emplace_back(distance(slot), slot);
+
+        // whatever is left is farther than d cells : strictly nearer,
+        // no tie with it can come first by its slot
+        if (int(found.size()) >= k)
+        {
+            std::nth_element(found.begin(), found.begin() + k - 1, found.end());
+            int64_t bound = d * cell_size_;
+            if (found[k - 1].first < bound * bound)
+                break;
+        }
+    }
+
+    k = std::min<int>(k, found.size());
+    std::partial_sort(found.begin(), found.begin() + k, found.end());
+    for (int i = 0; i != k; ++i)
+        result.push_back(found[i].second);
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "data.h"
+
+/* Live slots bucketed by type_ then by cell, for Seek and Near().
+   Positions are in whole pixels. update() only moves the slots whose
+   cell, type or liveness changed since the previous call. */
+class ProximityIndex
+{
+    static constexpr uint64_t none_ = ~uint64_t(0);
+    // a cell looked up costs about as much as this many slots scanned
+    static constexpr int lookup_cost_ = 8;
+
+    int cell_size_;
+    std::unordered_map<uint64_t, std::vector<int>> cells_;
+    // indexed by slot, on the heap as they follow the capacity
+    std::vector<uint64_t> keys_;
+    std::vector<IPoint2D> pos_;
+    // bit i set when slot i is in the index
+    std::array<uint64_t, State::nb_words_> indexed_;
+    std::array<int, 256> count_;
+    int total_{0};
+
+    uint64_t key(int type, int64_t x, int64_t y) const
+    {
+        return static_cast<uint64_t>(type) << 48
+               | static_cast<uint64_t>(x & 0xFFFFFF) << 24
+               | static_cast<uint64_t>(y & 0xFFFFFF);
+    }
+
+    int64_t cell(int32_t coor) const
+    {
+        // floor, negative coordinates included
+        return coor >= 0 ? coor / cell_size_ : -((-int64_t(coor) - 1) / cell_size_) - 1;
+    }
+
+    /* calls visit(slot) for every slot in the index, by slot */
+    template <typename Visit>
+    void scan(Visit &&visit) const
+    {
+        for (int word = 0; word != State::nb_words_; ++word)
+            for (uint64_t bits = indexed_[word]; bits; bits &= bits - 1)
+                visit(word * 64 + __builtin_ctzll(bits));
+    }
+
+    /* slots of type in the cells at Chebyshev distance ring of (cx, cy) */
+    void ring(int type, int64_t cx, int64_t cy, int64_t ring, std::vector<int> &result) const;
+
+public:
+    explicit ProximityIndex(int cell_size = 128);
+
+    void clear();
+    void update(const State &st);
+    void update(const State &st, int slot);
+
+    /* slots of type (-1 for any) within radius of center, by slot */
+    void radius(int type,
+                IPoint2D center,
+                int64_t radius,
+                std::vector<int> &result) const;
+
+    /* the k slots of type (-1 for any) nearest to center, by distance
+       then by slot */
+    void nearest(int type,
+                 IPoint2D center,
+                 int k,
+                 std::vector<int> &result) const;
+
+    IPoint2D pos(int slot) const
+    {
+        return pos_[slot];
+    }
+
+    int count(int type) const
+    {
+        return type < 0 ? total_ : count_[type];
+    }
+};
@@ -0,0 +1,177 @@
+#include "rasterizer.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <tuple>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace ObjData;
+
+bool Framebuffer::write(const std::string &path) const
+{
+    FILE *file = std::fopen(path.c_str(), "wb");
+    if (!file)
+        return false;
+    std::fprintf(file,
+                 "P7\nWIDTH %d\nHEIGHT %d\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n",
+                 w_, h_);
+    bool ok = std::fwrite(color_.data(), sizeof(uint32_t), color_.size(), file) == color_.size();
+    return std::fclose(file) == 0 && ok;
+}
+
+namespace
+{
+    static_assert(sizeof(Pixel) == 8);
+
+    struct Placed
+    {
+        const SpriteInstance *si_;
+        int x_, y_, w_, h_;
+    };
+
+    uint32_t rgba(const Pixel &pixel)
+    {
+        uint32_t result;
+        std::memcpy(&result, &pixel, sizeof(result));
+        return result;
+    }
+
+    void blend_pixel(const Pixel &src, uint32_t &color, int32_t &depth)
+    {
+        if (src.depth_ < depth)
+            return;
+        uint32_t a = src.a_;
+        uint32_t s = rgba(src);
+        uint32_t result = 0;
+        for (int shift = 0; shift != 32; shift += 8)
+        {
+            uint32_t x = ((s >> shift) & 255) * a + ((color >> shift) & 255) * (255 - a) + 128;
+            result |= ((x + (x >> 8)) >> 8) << shift;
+        }
+        color = result;
+        if (a == 255)
+            depth = src.depth_;
+    }
+
+    void blend_row(const Pixel *src, uint32_t *color, int32_t *depth, int n)
+    {
+        int x = 0;
+#ifdef __SSE2__
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i c255 = _mm_set1_epi16(255);
+        const __m128i c128 = _mm_set1_epi16(128);
+        for (; x + 4 <= n; x += 4)
+        {
+            // 4 Pixels of 8 bytes : rgba in the low words, depth in the top byte of the high ones
+            __m128 p01 = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x)));
+            __m128 p23 = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x + 2)));
+            __m128i s = _mm_castps_si128(_mm_shuffle_ps(p01, p23, _MM_SHUFFLE(2, 0, 2, 0)));
+            __m128i src_depth = _mm_srli_epi32(_mm_castps_si128(_mm_shuffle_ps(p01, p23, _MM_SHUFFLE(3, 1, 3, 1))), 24);
+
+            __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(color + x));
+            __m128i dst_depth = _mm_loadu_si128(reinterpret_cast<const __m128i *>(depth + x));
+
+            auto blend = [&](__m128i s16, __m128i d16)
+            {
+                __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s16, _MM_SHUFFLE(3, 3, 3, 3)),
+                                                _MM_SHUFFLE(3, 3, 3, 3));
+                __m128i x16 = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(s16, a),
+                                                          _mm_mullo_epi16(d16, _mm_sub_epi16(c255, a))),
+                                            c128);
+                return _mm_srli_epi16(_mm_add_epi16(x16, _mm_srli_epi16(x16, 8)), 8);
+            };
+            __m128i blended = _mm_packus_epi16(blend(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero)),
+                                               blend(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero)));
+
+            __m128i pass = _mm_xor_si128(_mm_cmplt_epi32(src_depth, dst_depth), _mm_set1_epi32(-1));
+            __m128i result = _mm_or_si128(_mm_and_si128(pass, blended), _mm_andnot_si128(pass, d));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(color + x), result);
+
+            __m128i opaque = _mm_and_si128(pass, _mm_cmpeq_epi32(_mm_srli_epi32(s, 24), _mm_set1_epi32(255)));
+            __m128i new_depth = _mm_or_si128(_mm_and_si128(opaque, src_depth), _mm_andnot_si128(opaque, dst_depth));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(depth + x), new_depth);
+        }
+#endif
+        for (; x < n; ++x)
+            blend_pixel(src[x], color[x], depth[x]);
+    }
+}
+
+void Rasterizer::render(std::vector<SpriteInstance> sis, Point2D camera)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    std::stable_sort(sis.begin(),
+                     sis.end(),
+                     [](const auto &si1, const auto &si2)
+                     {
+                         return std::tie(si1.order_, si1.id_)
+                                < std::tie(si2.order_, si2.id_);
+                     });
+
+    std::vector<Placed> placed;
+    placed.reserve(sis.size());
+    for (const auto &si : sis)
+    {
+        auto pos = si.pos(camera) - camera;
+        auto extent = si.extent();
+        placed.push_back({&si,
+                          static_cast<int>(pos.real().roundin()),
+                          static_cast<int>(pos.imag().roundin()),
+                          extent.real(),
+                          extent.imag()});
+    }
+
+    auto &fb = framebuffer_;
+    int w_tiles = (fb.w_ + tile_size_ - 1) / tile_size_;
+    int h_tiles = (fb.h_ + tile_size_ - 1) / tile_size_;
+
+    auto render_tile = [&](int tile)
+    {
+        int x1 = (tile % w_tiles) * tile_size_;
+        int y1 = (tile / w_tiles) * tile_size_;
+        int x2 = std::min(fb.w_, x1 + tile_size_);
+        int y2 = std::min(fb.h_, y1 + tile_size_);
+
+        for (int y = y1; y != y2; ++y)
+        {
+            std::fill(fb.color_.begin() + y * fb.w_ + x1, fb.color_.begin() + y * fb.w_ + x2, 0);
+            std::fill(fb.depth_.begin() + y * fb.w_ + x1, fb.depth_.begin() + y * fb.w_ + x2, 0);
+        }
+
+        for (const auto &p : placed)
+        {
+            int left = std::max(x1, p.x_);
+            int right = std::min(x2, p.x_ + p.w_);
+            int top = std::max(y1, p.y_);
+            int bottom = std::min(y2, p.y_ + p.h_);
+            if (left >= right || top >= bottom)
+                continue;
+
+            const auto &sprite = p.si_->frame_->sprite_;
+            const auto &image = *sprite.image_;
+            for (int y = top; y != bottom; ++y)
+            {
+                int u = sprite.coor_.first.real() + left - p.x_;
+                int v = sprite.coor_.first.imag() + y - p.y_;
+                blend_row(&image.content_[u + v * image.stride_],
+                          &fb.color_[left + y * fb.w_],
+                          &fb.depth_[left + y * fb.w_],
+                          right - left);
+            }
+        }
+    };
+
+    if (pool_)
+        pool_->run(w_tiles * h_tiles, render_tile);
+    else
+        for (int tile = 0; tile != w_tiles * h_tiles; ++tile)
+            render_tile(tile);
+
+    last_frame_ = std::chrono::steady_clock::now() - start;
+}
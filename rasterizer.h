@@ -0,0 +1,62 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "objectdata.h"
+
+class ThreadPool;
+
+struct Framebuffer
+{
+    int w_, h_;
+    // r, g, b, a bytes in memory order
+    std::vector<uint32_t, TaggedAllocator<uint32_t, MEMORY_TICK>> color_;
+    std::vector<int32_t, TaggedAllocator<int32_t, MEMORY_TICK>> depth_;
+
+    Framebuffer(int w, int h)
+        : w_(w), h_(h), color_(w * h), depth_(w * h)
+    {
+    }
+
+    void clear()
+    {
+        std::fill(color_.begin(), color_.end(), 0);
+        std::fill(depth_.begin(), depth_.end(), 0);
+    }
+
+    /* netpbm PAM, RGB_ALPHA */
+    bool write(const std::string &path) const;
+};
+
+/* headless backend : composites the Pixels of the sprites of a render
+   list, in (order_, id_) order like draw. A pixel is blended only where
+   its depth_ is not below the one already there. The screen is cut in
+   tiles spread over the pool, alpha blending works 4 pixels at a time */
+class Rasterizer
+{
+    Framebuffer framebuffer_;
+    ThreadPool *pool_;
+    int tile_size_;
+    std::chrono::nanoseconds last_frame_{0};
+
+public:
+    Rasterizer(int w, int h, ThreadPool *pool = nullptr, int tile_size = 64)
+        : framebuffer_(w, h), pool_(pool), tile_size_(tile_size)
+    {
+    }
+
+    void render(std::vector<ObjData::SpriteInstance> sis, Point2D camera);
+
+    const Framebuffer &framebuffer() const
+    {
+        return framebuffer_;
+    }
+
+    double frames_per_second() const
+    {
+        return 1e9 / std::max<int64_t>(1, last_frame_.count());
+    }
+};
@@ -0,0 +1,155 @@
+#include "rollback.h"
+#include "stepper.h"
+
+#include <algorithm>
+#include <cstring>
+
+std::pair<std::unique_ptr<LoopbackTransport>, std::unique_ptr<LoopbackTransport>>
+    LoopbackTransport::pair(int delay)
+{
+    auto channel = std::make_shared<Channel>();
+    return {std::unique_ptr<LoopbackTransport>(new LoopbackTransport(channel, 0, delay)),
+            std::unique_ptr<LoopbackTransport>(new LoopbackTransport(channel, 1, delay))};
+}
+
+void LoopbackTransport::send(const InputMessage &message)
+{
+    std::lock_guard lock(channel_->mutex_);
+    // the other side counts its polls, delay is expressed in them
+    channel_->messages_[1 - side_].emplace_back(delay_, message);
+}
+
+std::vector<InputMessage> LoopbackTransport::receive()
+{
+    std::vector<InputMessage> result;
+    std::lock_guard lock(channel_->mutex_);
+    auto &messages = channel_->messages_[side_];
+    for (auto &[remaining, message] : messages)
+        remaining--;
+    while (!messages.empty() && messages.front().first < 0)
+    {
+        result.push_back(messages.front().second);
+        messages.pop_front();
+    }
+    return result;
+}
+
+RollbackSession::RollbackSession(const ObjData::Level &level,
+                                 Transport &transport,
+                                 int local,
+                                 int max_rollback,
+                                 const State &start)
+    : level_(level),
+      transport_(transport),
+      local_(local),
+      max_rollback_(max_rollback),
+      current_(std::make_unique<State>(start)),
+      stepper_(std::make_unique<Stepper>(level)),
+      start_(start.timestamp_),
+      tick_(start.timestamp_),
+      snapshots_(max_rollback + 1),
+      used_(max_rollback + 1),
+      known_(max_rollback + 1),
+      confirmed_(max_rollback + 1)
+{
+}
+
+RollbackSession::~RollbackSession() = default;
+
+RollbackSession::Inputs RollbackSession::inputs(int32_t tick) const
+{
+    Inputs result = last_confirmed_;
+    for (int player = 0; player != State::nb_players_; ++player)
+        if (confirmed_[index(tick)][player])
+            result[player] = known_[index(tick)][player];
+    return result;
+}
+
+void RollbackSession::simulate()
+{
+    int i = index(tick_);
+    snapshots_[i] = *current_;
+    used_[i] = inputs(tick_);
+    stepper_->step(*current_, used_[i].data(), used_[i].size());
+    tick_++;
+}
+
+void RollbackSession::advance(KeyStrokes local)
+{
+    // the slot of the tick about to be simulated is reused
+    confirmed_[index(tick_)].fill(false);
+    known_[index(tick_)][local_] = local;
+    confirmed_[index(tick_)][local_] = true;
+    transport_.send({tick_, local_, local});
+
+    auto received = transport_.receive();
+    early_.insert(early_.end(), received.begin(), received.end());
+
+    int32_t first_wrong = tick_;
+    std::vector<InputMessage> still_early;
+    for (const auto &message : early_)
+    {
+        if (message.player_ == local_
+            || message.player_ < 0
+            || message.player_ >= State::nb_players_)
+            continue;
+        // already in the start state, there is no snapshot to go back to
+        if (message.tick_ < start_)
+            continue;
+        // the remote side is ahead, kept for later
+        if (message.tick_ > tick_)
+        {
+            still_early.push_back(message);
+            continue;
+        }
+        if (message.tick_ < tick_ - max_rollback_)
+        {
+            desynced_ = true;
+            continue;
+        }
+        int i = index(message.tick_);
+        known_[i][message.player_] = message.keys_;
+        confirmed_[i][message.player_] = true;
+        if (message.tick_ >= last_confirmed_tick_[message.player_])
+        {
+            last_confirmed_tick_[message.player_] = message.tick_;
+            last_confirmed_[message.player_] = message.keys_;
+        }
+        if (message.tick_ < tick_
+            && std::memcmp(&used_[i][message.player_], &message.keys_, sizeof(KeyStrokes)))
+            first_wrong = std::min(first_wrong, message.tick_);
+    }
+    early_ = std::move(still_early);
+
+    if (first_wrong < tick_)
+    {
+        int32_t target = tick_;
+        rollbacks_++;
+        deepest_ = std::max(deepest_, target - first_wrong);
+        *current_ = snapshots_[index(first_wrong)];
+        tick_ = first_wrong;
+        while (tick_ != target)
+            simulate();
+    }
+    simulate();
+}
+
+int RollbackSession::max_rollback_depth(const ObjData::Level &level,
+                                        const State &st,
+                                        std::chrono::nanoseconds budget)
+{
+    Inputs keys{};
+    auto current = std::make_unique<State>(st);
+    auto snapshot = std::make_unique<State>();
+    Stepper stepper(level);
+    int depth = 0;
+    auto start = std::chrono::steady_clock::now();
+    // as simulate : one snapshot copied then one step in place per tick
+    while (std::chrono::steady_clock::now() - start < budget)
+    {
+        *snapshot = *current;
+        stepper.step(*current, keys.data(), keys.size());
+        depth++;
+    }
+    return std::max(0, depth - 1);
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "data.h"
+#include "memory.h"
+
+class Stepper;
+
+struct InputMessage
+{
+    int32_t tick_;
+    int32_t player_;
+    KeyStrokes keys_;
+};
+
+class Transport
+{
+public:
+    virtual ~Transport() = default;
+
+    virtual void send(const InputMessage &message) = 0;
+
+    /* messages arrived since the last call */
+    virtual std::vector<InputMessage> receive() = 0;
+};
+
+/* in-process stand-in for the network : a message sent through one end
+   comes out of the other after delay calls to receive */
+class LoopbackTransport : public Transport
+{
+    struct Channel
+    {
+        std::mutex mutex_;
+        std::deque<std::pair<int, InputMessage>> messages_[2];
+    };
+
+    std::shared_ptr<Channel> channel_;
+    int side_;
+    int delay_;
+
+    LoopbackTransport(std::shared_ptr<Channel> channel, int side, int delay)
+        : channel_(channel), side_(side), delay_(delay)
+    {
+    }
+
+public:
+    static std::pair<std::unique_ptr<LoopbackTransport>, std::unique_ptr<LoopbackTransport>>
+        pair(int delay);
+
+    void set_delay(int delay)
+    {
+        delay_ = delay;
+    }
+
+    void send(const InputMessage &message) override;
+    std::vector<InputMessage> receive() override;
+};
+
+/* GGPO like : the remote player is predicted to keep its last known
+   inputs. When the real ones differ, the snapshot of the first wrong
+   tick is restored and the ticks since are simulated again */
+class RollbackSession
+{
+    using Inputs = std::array<KeyStrokes, State::nb_players_>;
+
+    const ObjData::Level &level_;
+    Transport &transport_;
+    int local_;
+    int max_rollback_;
+
+    // on the heap, as the snapshots, and stepped in place by stepper_,
+    // kept from one tick to the next with its buffers
+    std::unique_ptr<State> current_;
+    std::unique_ptr<Stepper> stepper_;
+    // the tick of the start state, there is no snapshot before it
+    int32_t start_;
+    int32_t tick_;
+    // indexed by tick % (max_rollback_ + 1)
+    std::vector<State, TaggedAllocator<State, MEMORY_HISTORY>> snapshots_;
+    std::vector<Inputs> used_;
+    std::vector<Inputs> known_;
+    std::vector<std::array<bool, State::nb_players_>> confirmed_;
+    Inputs last_confirmed_{};
+    std::array<int32_t, State::nb_players_> last_confirmed_tick_{};
+    std::vector<InputMessage> early_;
+
+    int rollbacks_{0};
+    int deepest_{0};
+    bool desynced_{false};
+
+    int index(int32_t tick) const
+    {
+        return tick % (max_rollback_ + 1);
+    }
+
+    Inputs inputs(int32_t tick) const;
+    void simulate();
+
+public:
+    RollbackSession(const ObjData::Level &level,
+                    Transport &transport,
+                    int local,
+                    int max_rollback,
+                    const State &start);
+    ~RollbackSession();
+
+    /* one frame : sends the local inputs, rolls back if needed and
+       simulates the next tick */
+    void advance(KeyStrokes local);
+
+    const State &state() const
+    {
+        return *current_;
+    }
+
+    int rollbacks() const
+    {
+        return rollbacks_;
+    }
+
+    int deepest_rollback() const
+    {
+        return deepest_;
+    }
+
+    /* a remote input arrived too late to be rolled back */
+    bool desynced() const
+    {
+        return desynced_;
+    }
+
+    /* number of ticks that can be simulated again within budget */
+    static int max_rollback_depth(const ObjData::Level &level,
+                                  const State &st,
+                                  std::chrono::nanoseconds budget = std::chrono::milliseconds(16));
+};
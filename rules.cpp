@@ -0,0 +1,960 @@
+#include "rules.h"
+#include "mask_names.h"
+#include "objectdata.h"
+#include "proximity.h"
+
+#include <algorithm>
+#include <cctype>
+#include <limits>
+#include <set>
+
+using namespace ObjData;
+
+namespace Rules
+{
+    Names::Names()
+        : masks_(mask_names())
+    {
+    }
+
+    void Slots::build(const State &st)
+    {
+        all_.clear();
+        for (auto &slots : by_type_)
+            slots.clear();
+        for (int slot = st.next_live(0); slot != State::nb_slots_; slot = st.next_live(slot + 1))
+        {
+            all_.push_back(slot);
+            by_type_[st.slots_[slot].type_].push_back(slot);
+        }
+    }
+}
+
+using namespace Rules;
+
+namespace
+{
+    struct Node
+    {
+        enum Kind
+        {
+            CALL,
+            IDENT,
+            INT,
+            STRING
+        };
+
+        Kind kind_;
+        std::string name_;
+        int32_t value_{0};
+        std::vector<Node> args_;
+    };
+
+    class Parser
+    {
+        const std::string &source_;
+        size_t pos_{0};
+
+    public:
+        std::string error_;
+
+        explicit Parser(const std::string &source)
+            : source_(source)
+        {
+        }
+
+        void skip()
+        {
+            while (pos_ < source_.size() && std::isspace(static_cast<unsigned char>(source_[pos_])))
+                ++pos_;
+        }
+
+        bool eat(char c)
+        {
+            skip();
+            if (pos_ < source_.size() && source_[pos_] == c)
+            {
+                ++pos_;
+                return true;
+            }
+            return false;
+        }
+
+        bool finished()
+        {
+            skip();
+            return pos_ == source_.size();
+        }
+
+        bool fail(const std::string &message)
+        {
+            if (error_.empty())
+                error_ = message + " at " + std::to_string(pos_);
+            return false;
+        }
+
+        bool parse(Node &node)
+        {
+            skip();
+            if (pos_ == source_.size())
+                return fail("unexpected end");
+
+            char c = source_[pos_];
+            if (c == '\'' || c == '"')
+            {
+                size_t end = source_.find(c, pos_ + 1);
+                if (end == std::string::npos)
+                    return fail("unterminated string");
+                node.kind_ = Node::STRING;
+                node.name_ = source_.substr(pos_ + 1, end - pos_ - 1);
+                pos_ = end + 1;
+                return true;
+            }
+
+            if (std::isdigit(static_cast<unsigned char>(c)) || c == '-')
+            {
+                size_t end = pos_ + 1;
+                while (end < source_.size() && std::isdigit(static_cast<unsigned char>(source_[end])))
+                    ++end;
+                size_t digits = end - pos_ - (c == '-');
+                if (digits > 10 || !digits)
+                    return fail("invalid number");
+                long long value = std::stoll(source_.substr(pos_, end - pos_));
+                if (value < std::numeric_limits<int32_t>::min() || value > std::numeric_limits<int32_t>::max())
+                    return fail("number out of range");
+                node.kind_ = Node::INT;
+                node.value_ = value;
+                pos_ = end;
+                return true;
+            }
+
+            if (std::isalpha(static_cast<unsigned char>(c)) || c == '_')
+            {
+                size_t end = pos_;
+                while (end < source_.size()
+                       && (std::isalnum(static_cast<unsigned char>(source_[end])) || source_[end] == '_'))
+                    ++end;
+                node.name_ = source_.substr(pos_, end - pos_);
+                pos_ = end;
+                if (!eat('('))
+                {
+                    node.kind_ = Node::IDENT;
+                    return true;
+                }
+                node.kind_ = Node::CALL;
+                if (eat(')'))
+                    return true;
+                do
+                {
+                    node.args_.emplace_back();
+                    if (!parse(node.args_.back()))
+                        return false;
+                } while (eat(','));
+                if (!eat(')'))
+                    return fail("expected )");
+                return true;
+            }
+
+            return fail(std::string("unexpected ") + c);
+        }
+    };
+
+    struct Expr
+    {
+        enum Kind
+        {
+            CONST,
+            VAR,
+            SFIELD,
+            OFIELD,
+            DIST2,
+            TOUCH,
+            BINARY,
+            NOT
+        };
+
+        Kind kind_;
+        // constant, var index, field or mask
+        int32_t value_{0};
+        Op op_{ADD};
+        std::vector<Expr> args_;
+
+        static Expr constant(int32_t value)
+        {
+            return {CONST, value, ADD, {}};
+        }
+
+        static Expr binary(Op op, Expr e1, Expr e2)
+        {
+            return {BINARY, 0, op, {std::move(e1), std::move(e2)}};
+        }
+
+        /* 0 : invariant, 1 : subject only, 2 : subject and object */
+        int depends() const
+        {
+            switch (kind_)
+            {
+            case CONST:
+            case VAR:
+                return 0;
+            case SFIELD:
+                return 1;
+            case OFIELD:
+            case DIST2:
+            case TOUCH:
+                return 2;
+            default:
+                break;
+            }
+            int result = 0;
+            for (const auto &arg : args_)
+                result = std::max(result, arg.depends());
+            return result;
+        }
+
+        void vars(std::set<int> &result) const
+        {
+            if (kind_ == VAR)
+                result.insert(value_);
+            for (const auto &arg : args_)
+                arg.vars(result);
+        }
+
+        /* fields of the subject read */
+        void fields(std::set<int> &result) const
+        {
+            if (kind_ == SFIELD)
+                result.insert(value_);
+            if (kind_ == DIST2)
+                result.insert({X, Y});
+            for (const auto &arg : args_)
+                arg.fields(result);
+        }
+    };
+
+    int32_t evaluate(Op op, int32_t a, int32_t b)
+    {
+        switch (op)
+        {
+        case EQ:
+            return a == b;
+        case NE:
+            return a != b;
+        case LT:
+            return a < b;
+        case LE:
+            return a <= b;
+        case ADD:
+            return static_cast<uint32_t>(a) + static_cast<uint32_t>(b);
+        case SUB:
+            return static_cast<uint32_t>(a) - static_cast<uint32_t>(b);
+        case MUL:
+            return static_cast<uint32_t>(a) * static_cast<uint32_t>(b);
+        case MULSAT:
+            return std::clamp<int64_t>(int64_t(a) * b, INT32_MIN, INT32_MAX);
+        case AND:
+            return a && b;
+        case OR:
+            return a || b;
+        default:
+            return 0;
+        }
+    }
+
+    /* constant folding */
+    Expr fold(Expr expr)
+    {
+        for (auto &arg : expr.args_)
+            arg = fold(std::move(arg));
+
+        if (expr.kind_ == Expr::NOT && expr.args_[0].kind_ == Expr::CONST)
+            return Expr::constant(!expr.args_[0].value_);
+        if (expr.kind_ != Expr::BINARY)
+            return expr;
+
+        const auto &e1 = expr.args_[0];
+        const auto &e2 = expr.args_[1];
+        if (e1.kind_ == Expr::CONST && e2.kind_ == Expr::CONST)
+            return Expr::constant(evaluate(expr.op_, e1.value_, e2.value_));
+
+        // absorbing elements
+        for (const auto &arg : expr.args_)
+        {
+            if (arg.kind_ != Expr::CONST)
+                continue;
+            if (expr.op_ == AND && !arg.value_)
+                return Expr::constant(0);
+            if (expr.op_ == OR && arg.value_)
+                return Expr::constant(1);
+            if (expr.op_ == MUL && !arg.value_)
+                return Expr::constant(0);
+        }
+        return expr;
+    }
+
+    struct Effect
+    {
+        Op op_;
+        int32_t target_;
+        Expr value_;
+    };
+
+    class Compiler
+    {
+        const Names &names_;
+
+    public:
+        std::string error_;
+
+        explicit Compiler(const Names &names)
+            : names_(names)
+        {
+        }
+
+        bool fail(const std::string &message)
+        {
+            if (error_.empty())
+                error_ = message;
+            return false;
+        }
+
+        bool arity(const Node &node, size_t nb_args)
+        {
+            if (node.args_.size() != nb_args)
+                return fail(node.name_ + " expects " + std::to_string(nb_args) + " arguments");
+            return true;
+        }
+
+        /* X, Y... for the subject, OX, OY... for the object */
+        bool field(const std::string &name, bool &object, int &result)
+        {
+            static const std::map<std::string, int> fields = {
+                {"X", X}, {"Y", Y}, {"VX", VX}, {"VY", VY}, {"State", STATE}};
+            object = name.size() > 1 && name[0] == 'O' && fields.count(name.substr(1));
+            auto it = fields.find(object ? name.substr(1) : name);
+            if (it == fields.end())
+                return false;
+            result = it->second;
+            return true;
+        }
+
+        bool var(const Node &node, int &result)
+        {
+            if (node.kind_ == Node::IDENT)
+            {
+                auto it = names_.vars_.find(node.name_);
+                if (it == names_.vars_.end())
+                    return fail("unknown variable " + node.name_);
+                result = it->second;
+            }
+            else if (node.kind_ == Node::CALL && node.name_ == "Var")
+            {
+                if (!arity(node, 1) || node.args_[0].kind_ != Node::INT)
+                    return fail("Var expects an index");
+                result = node.args_[0].value_;
+            }
+            else if (node.kind_ == Node::CALL && node.name_ == "Var1")
+            {
+                if (!arity(node, 1) || node.args_[0].kind_ != Node::STRING || node.args_[0].name_.size() != 1)
+                    return fail("Var1 expects a character");
+                result = static_cast<unsigned char>(node.args_[0].name_[0]);
+            }
+            else
+            {
+                return fail("expected a variable");
+            }
+            if (result < 0 || result >= State::nb_vars_)
+                return fail("variable out of range");
+            return true;
+        }
+
+        bool mask(const Node &node, int &result)
+        {
+            auto it = names_.masks_.find(node.name_);
+            if (node.kind_ != Node::STRING || it == names_.masks_.end())
+                return fail("unknown mask " + node.name_);
+            result = it->second;
+            return true;
+        }
+
+        bool selector(const Node &node, int &result)
+        {
+            if (node.kind_ == Node::CALL && node.name_ == "All" && arity(node, 0))
+            {
+                result = -1;
+                return true;
+            }
+            if (node.kind_ == Node::CALL && node.name_ == "Char" && arity(node, 0))
+            {
+                result = names_.char_type_;
+                return true;
+            }
+            if (node.kind_ == Node::CALL && node.name_ == "Every" && arity(node, 1))
+            {
+                auto it = names_.types_.find(node.args_[0].name_);
+                if (it == names_.types_.end())
+                    return fail("unknown type " + node.args_[0].name_);
+                result = it->second;
+                return true;
+            }
+            return fail("expected a selector");
+        }
+
+        bool expr(const Node &node, Expr &result)
+        {
+            static const std::map<std::string, std::pair<Op, bool>> binaries = {
+                {"Equals", {EQ, false}}, {"Differs", {NE, false}},
+                {"Less", {LT, false}}, {"LessEq", {LE, false}},
+                {"Greater", {LT, true}}, {"GreaterEq", {LE, true}},
+                {"Add", {ADD, false}}, {"Sub", {SUB, false}}, {"Mul", {MUL, false}}};
+
+            switch (node.kind_)
+            {
+            case Node::INT:
+                result = Expr::constant(node.value_);
+                return true;
+            case Node::STRING:
+                return fail("unexpected string " + node.name_);
+            case Node::IDENT:
+            {
+                bool object;
+                int index;
+                if (field(node.name_, object, index))
+                {
+                    result = {object ? Expr::OFIELD : Expr::SFIELD, index, ADD, {}};
+                    return true;
+                }
+                if (!var(node, index))
+                    return false;
+                result = {Expr::VAR, index, ADD, {}};
+                return true;
+            }
+            case Node::CALL:
+                break;
+            }
+
+            const auto &name = node.name_;
+            if (name == "Var" || name == "Var1")
+            {
+                int index;
+                if (!var(node, index))
+                    return false;
+                result = {Expr::VAR, index, ADD, {}};
+                return true;
+            }
+            if (name == "And" || name == "Or")
+            {
+                if (node.args_.empty())
+                    return fail(name + " expects arguments");
+                if (!expr(node.args_[0], result))
+                    return false;
+                for (size_t i = 1; i != node.args_.size(); ++i)
+                {
+                    Expr other;
+                    if (!expr(node.args_[i], other))
+                        return false;
+                    result = Expr::binary(name == "And" ? AND : OR, std::move(result), std::move(other));
+                }
+                return true;
+            }
+            if (name == "Not")
+            {
+                Expr arg;
+                if (!arity(node, 1) || !expr(node.args_[0], arg))
+                    return false;
+                result = {Expr::NOT, 0, ADD, {std::move(arg)}};
+                return true;
+            }
+            if (name == "Near")
+            {
+                Expr radius;
+                if (!arity(node, 1) || !expr(node.args_[0], radius))
+                    return false;
+                // past 46340, the square saturates as the distance does
+                result = Expr::binary(LE,
+                                      {Expr::DIST2, 0, ADD, {}},
+                                      Expr::binary(MULSAT, radius, radius));
+                return true;
+            }
+            if (name == "Touch")
+            {
+                int index;
+                if (!arity(node, 1) || !mask(node.args_[0], index))
+                    return false;
+                result = {Expr::TOUCH, index, ADD, {}};
+                return true;
+            }
+            if (auto it = binaries.find(name); it != binaries.end())
+            {
+                Expr e1, e2;
+                if (!arity(node, 2) || !expr(node.args_[0], e1) || !expr(node.args_[1], e2))
+                    return false;
+                auto [op, swapped] = it->second;
+                result = swapped ? Expr::binary(op, std::move(e2), std::move(e1))
+                                 : Expr::binary(op, std::move(e1), std::move(e2));
+                return true;
+            }
+            return fail("unknown function " + name);
+        }
+
+        bool effect(const Node &node, std::vector<Effect> &effects)
+        {
+            if (node.kind_ != Node::CALL)
+                return fail("expected an effect");
+            const auto &name = node.name_;
+            if (name == "Seq")
+            {
+                for (const auto &arg : node.args_)
+                    if (!effect(arg, effects))
+                        return false;
+                return true;
+            }
+            if (name == "Stop" && arity(node, 0))
+            {
+                effects.push_back({SETS, VX, Expr::constant(0)});
+                effects.push_back({SETS, VY, Expr::constant(0)});
+                return true;
+            }
+            if (name == "Free" && arity(node, 0))
+            {
+                effects.push_back({FREE, 0, Expr::constant(0)});
+                return true;
+            }
+            if (name == "Wake" && arity(node, 0))
+            {
+                effects.push_back({WAKE, 0, Expr::constant(0)});
+                return true;
+            }
+            if (name != "Set" || !arity(node, 2))
+                return fail("unknown effect " + name);
+
+            Effect result;
+            Expr current;
+            bool object;
+            int index;
+            if (node.args_[0].kind_ == Node::IDENT && field(node.args_[0].name_, object, index))
+            {
+                if (object)
+                    return fail("only the subject can be set");
+                result.op_ = SETS;
+                result.target_ = index;
+                current = {Expr::SFIELD, index, ADD, {}};
+            }
+            else
+            {
+                if (!var(node.args_[0], index))
+                    return false;
+                result.op_ = SETVAR;
+                result.target_ = index;
+                current = {Expr::VAR, index, ADD, {}};
+            }
+
+            const auto &value = node.args_[1];
+            if (value.kind_ == Node::STRING)
+            {
+                // '+5', '-5' : relative, '5' : absolute
+                const auto &text = value.name_;
+                bool relative = !text.empty() && (text[0] == '+' || text[0] == '-');
+                size_t digits = relative ? 1 : 0;
+                if (text.size() == digits
+                    || text.size() - digits > 10
+                    || !std::all_of(text.begin() + digits, text.end(),
+                                    [](char c) { return std::isdigit(static_cast<unsigned char>(c)); }))
+                    return fail("invalid value " + text);
+                long long amount = std::stoll(text.substr(digits));
+                if (amount > std::numeric_limits<int32_t>::max())
+                    return fail("value out of range " + text);
+                if (!relative)
+                    result.value_ = Expr::constant(amount);
+                else if (result.op_ == SETS)
+                {
+                    // a delta, the field keeping its fraction
+                    result.op_ = ADDS;
+                    result.value_ = Expr::constant(text[0] == '+' ? amount : -amount);
+                }
+                else
+                    result.value_ = Expr::binary(text[0] == '+' ? ADD : SUB,
+                                                 std::move(current),
+                                                 Expr::constant(amount));
+            }
+            else if (!expr(value, result.value_))
+            {
+                return false;
+            }
+            effects.push_back(std::move(result));
+            return true;
+        }
+    };
+
+    /* registers are given like a stack */
+    class Generator
+    {
+        std::vector<Instr> &code_;
+        int next_{0};
+
+    public:
+        bool overflow_{false};
+
+        explicit Generator(std::vector<Instr> &code)
+            : code_(code)
+        {
+        }
+
+        void emit(Op op, int a, int b, int c, int32_t k)
+        {
+            code_.push_back({op,
+                             static_cast<uint8_t>(a),
+                             static_cast<uint8_t>(b),
+                             static_cast<uint8_t>(c),
+                             k});
+        }
+
+        int gen(const Expr &expr)
+        {
+            int r = next_++;
+            if (r >= nb_registers_)
+            {
+                overflow_ = true;
+                r = nb_registers_ - 1;
+            }
+            switch (expr.kind_)
+            {
+            case Expr::CONST:
+                emit(LOADK, r, 0, 0, expr.value_);
+                break;
+            case Expr::VAR:
+                emit(LOADVAR, r, 0, 0, expr.value_);
+                break;
+            case Expr::SFIELD:
+                emit(LOADS, r, 0, 0, expr.value_);
+                break;
+            case Expr::OFIELD:
+                emit(LOADO, r, 0, 0, expr.value_);
+                break;
+            case Expr::DIST2:
+                emit(DIST2, r, 0, 0, 0);
+                break;
+            case Expr::TOUCH:
+                emit(TOUCH, r, 0, 0, expr.value_);
+                break;
+            case Expr::BINARY:
+            {
+                int b = gen(expr.args_[0]);
+                int c = gen(expr.args_[1]);
+                emit(expr.op_, r, b, c, 0);
+                break;
+            }
+            case Expr::NOT:
+                emit(NOT, r, gen(expr.args_[0]), 0, 0);
+                break;
+            }
+            next_ = r + 1;
+            return r;
+        }
+
+        void release()
+        {
+            next_ = 0;
+        }
+    };
+
+    void conjuncts(Expr expr, std::vector<Expr> &result)
+    {
+        if (expr.kind_ == Expr::BINARY && expr.op_ == AND)
+        {
+            conjuncts(std::move(expr.args_[0]), result);
+            conjuncts(std::move(expr.args_[1]), result);
+        }
+        else
+        {
+            result.push_back(std::move(expr));
+        }
+    }
+}
+
+bool Rules::compile(const std::string &source,
+                    const Names &names,
+                    Rule &rule,
+                    std::string &error)
+{
+    Parser parser(source);
+    Node node;
+    if (!parser.parse(node) || !parser.finished())
+    {
+        error = parser.error_.empty() ? "trailing characters" : parser.error_;
+        return false;
+    }
+
+    Compiler compiler(names);
+    Expr condition;
+    std::vector<Effect> effects;
+    bool ok = node.kind_ == Node::CALL;
+    if (ok && node.name_ == "Lambda" && node.args_.size() == 4)
+    {
+        ok = compiler.selector(node.args_[0], rule.subjects_)
+             && compiler.selector(node.args_[1], rule.objects_)
+             && compiler.expr(node.args_[2], condition)
+             && compiler.effect(node.args_[3], effects);
+    }
+    else if (ok && node.name_ == "Touch" && (node.args_.size() == 3 || node.args_.size() == 4))
+    {
+        int mask = 0;
+        ok = compiler.selector(node.args_[0], rule.subjects_)
+             && compiler.selector(node.args_[1], rule.objects_)
+             && compiler.mask(node.args_[2], mask);
+        condition = {Expr::TOUCH, mask, ADD, {}};
+        if (ok && node.args_.size() == 4)
+            ok = compiler.effect(node.args_[3], effects);
+        else if (ok)
+            ok = compiler.effect({Node::CALL, "Stop", 0, {}}, effects);
+    }
+    else
+    {
+        ok = compiler.fail("expected Lambda or Touch");
+    }
+    if (!ok)
+    {
+        error = compiler.error_;
+        return false;
+    }
+
+    rule.invariant_.clear();
+    rule.subject_.clear();
+    rule.pair_.clear();
+    rule.near_ = -1;
+
+    // reading a var or a field of the subject the effect writes cannot
+    // leave the loop
+    std::set<int> written;
+    std::set<int> written_fields;
+    for (const auto &effect : effects)
+    {
+        if (effect.op_ == SETVAR)
+            written.insert(effect.target_);
+        else if (effect.op_ == SETS || effect.op_ == ADDS)
+            written_fields.insert(effect.target_);
+    }
+
+    std::vector<Expr> parts;
+    conjuncts(fold(std::move(condition)), parts);
+    bool overflow = false;
+    for (const auto &part : parts)
+    {
+        if (part.kind_ == Expr::CONST && part.value_)
+            continue;
+
+        // DIST2 <= r * r : the objects can come from the proximity index.
+        // Not once saturated : every object is near enough
+        if (part.kind_ == Expr::BINARY
+            && part.op_ == LE
+            && part.args_[0].kind_ == Expr::DIST2
+            && part.args_[1].kind_ == Expr::CONST
+            && part.args_[1].value_ >= 0
+            && part.args_[1].value_ != INT32_MAX)
+        {
+            int64_t radius = isqrt(part.args_[1].value_) + 1;
+            rule.near_ = rule.near_ < 0 ? radius : std::min(rule.near_, radius);
+        }
+
+        std::set<int> read;
+        std::set<int> read_fields;
+        part.vars(read);
+        part.fields(read_fields);
+        bool hoistable = std::none_of(read.begin(), read.end(),
+                                      [&written](int var) { return written.count(var); })
+                         && std::none_of(read_fields.begin(), read_fields.end(),
+                                         [&written_fields](int field) { return written_fields.count(field); });
+        int level = hoistable ? part.depends() : 2;
+        auto &code = level == 0 ? rule.invariant_
+                   : level == 1 ? rule.subject_
+                   : rule.pair_;
+
+        Generator generator(code);
+        int r = generator.gen(part);
+        generator.emit(TEST, r, 0, 0, 0);
+        overflow = overflow || generator.overflow_;
+    }
+
+    Generator generator(rule.pair_);
+    for (const auto &effect : effects)
+    {
+        int r = generator.gen(fold(effect.value_));
+        generator.emit(effect.op_, r, 0, 0, effect.target_);
+        generator.release();
+    }
+    if (overflow || generator.overflow_)
+    {
+        error = "expression too deep";
+        return false;
+    }
+    return true;
+}
+
+namespace
+{
+    int32_t get(const StateObject &so, int field)
+    {
+        switch (field)
+        {
+        case X:
+            return so.pos_.real().roundin();
+        case Y:
+            return so.pos_.imag().roundin();
+        case VX:
+            return so.speed_.real().roundin();
+        case VY:
+            return so.speed_.imag().roundin();
+        default:
+            return so.state_;
+        }
+    }
+
+    void set(StateObject &so, int field, int32_t value)
+    {
+        switch (field)
+        {
+        case X:
+            so.pos_.real(value);
+            break;
+        case Y:
+            so.pos_.imag(value);
+            break;
+        case VX:
+            so.speed_.real(value);
+            break;
+        case VY:
+            so.speed_.imag(value);
+            break;
+        default:
+            so.state_ = value;
+            break;
+        }
+    }
+
+    void add(StateObject &so, int field, int32_t delta)
+    {
+        switch (field)
+        {
+        case X:
+            so.pos_.real(so.pos_.real() + fixed(delta));
+            break;
+        case Y:
+            so.pos_.imag(so.pos_.imag() + fixed(delta));
+            break;
+        case VX:
+            so.speed_.real(so.speed_.real() + fixed(delta));
+            break;
+        case VY:
+            so.speed_.imag(so.speed_.imag() + fixed(delta));
+            break;
+        default:
+            so.state_ = so.state_ + delta;
+            break;
+        }
+    }
+
+    bool exec(const std::vector<Instr> &code,
+              State &st,
+              const std::vector<CollisionEvts> &evts,
+              int subject,
+              int object)
+    {
+        int32_t r[nb_registers_];
+        for (const auto &instr : code)
+        {
+            switch (instr.op_)
+            {
+            case LOADK:
+                r[instr.a_] = instr.k_;
+                break;
+            case LOADVAR:
+                r[instr.a_] = st.var_[instr.k_];
+                break;
+            case LOADS:
+                r[instr.a_] = get(st.slots_[subject], instr.k_);
+                break;
+            case LOADO:
+                r[instr.a_] = get(st.slots_[object], instr.k_);
+                break;
+            case DIST2:
+            {
+                int64_t dx = get(st.slots_[object], X) - int64_t(get(st.slots_[subject], X));
+                int64_t dy = get(st.slots_[object], Y) - int64_t(get(st.slots_[subject], Y));
+                r[instr.a_] = std::min<int64_t>(dx * dx + dy * dy, INT32_MAX);
+                break;
+            }
+            case TOUCH:
+                r[instr.a_] = std::any_of(evts[subject].begin(),
+                                          evts[subject].end(),
+                                          [&](const CollisionEvt &evt)
+                                          {
+                                              return evt.obj_spot_ == subject
+                                                     && evt.contact_ != CONTACT_EXIT
+                                                     && evt.obj_mask_ == object
+                                                     && evt.id_mask_ == instr.k_;
+                                          });
+                break;
+            case NOT:
+                r[instr.a_] = !r[instr.b_];
+                break;
+            case TEST:
+                if (!r[instr.a_])
+                    return false;
+                break;
+            case SETVAR:
+                st.var_[instr.k_] = r[instr.a_];
+                break;
+            case SETS:
+                set(st.slots_[subject], instr.k_, r[instr.a_]);
+                break;
+            case ADDS:
+                add(st.slots_[subject], instr.k_, r[instr.a_]);
+                break;
+            case FREE:
+                st.free(subject);
+                return true;
+            case WAKE:
+                st.wake(subject);
+                break;
+            default:
+                r[instr.a_] = evaluate(instr.op_, r[instr.b_], r[instr.c_]);
+                break;
+            }
+        }
+        return true;
+    }
+}
+
+void Rules::run(const Rule &rule,
+                State &st,
+                const std::vector<CollisionEvts> &evts,
+                const Slots &slots,
+                ProximityIndex &near)
+{
+    if (!exec(rule.invariant_, st, evts, -1, -1))
+        return;
+
+    // reused by every call of the thread
+    thread_local std::vector<int> found;
+    for (int subject : slots.select(rule.subjects_))
+    {
+        if (!st.live(subject) || !exec(rule.subject_, st, evts, subject, -1))
+            continue;
+        const auto *objects = &slots.select(rule.objects_);
+        if (rule.near_ >= 0)
+        {
+            found.clear();
+            near.radius(rule.objects_, near.pos(subject), rule.near_, found);
+            objects = &found;
+        }
+        for (int object : *objects)
+        {
+            if (!st.live(subject))
+                break;
+            if (object == subject || !st.live(object))
+                continue;
+            exec(rule.pair_, st, evts, subject, object);
+        }
+        near.update(st, subject);
+    }
+}
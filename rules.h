@@ -0,0 +1,144 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "data.h"
+#include "memory.h"
+
+namespace ObjData
+{
+    struct CollisionEvt;
+    using CollisionEvts = std::vector<CollisionEvt, TaggedAllocator<CollisionEvt, MEMORY_TICK>>;
+}
+
+class ProximityIndex;
+
+/* Rule language, compiled to a register bytecode run inside the tick.
+
+   rule     := Lambda(selector, selector, condition, effect)
+             | Touch(selector, selector, 'mask' [, effect])
+   selector := Every(type) | All() | Char()
+   condition:= And(c, ...) | Or(c, ...) | Not(c)
+             | Equals(e, e) | Differs(e, e) | Less(e, e) | LessEq(e, e)
+             | Near(radius) | Touch('mask') | e
+   e        := integer | Var(index) | Var1('c') | var name
+             | X | Y | VX | VY | State           (subject)
+             | OX | OY | OVX | OVY | OState      (object)
+             | Add(e, e) | Sub(e, e) | Mul(e, e)
+   effect   := Set(target, e) | Set(target, '+n') | Set(target, '-n')
+             | Stop() | Free() | Wake() | Seq(effect, ...)
+   target   := Var(index) | Var1('c') | var name | X | Y | VX | VY | State
+
+   For every subject, for every other object, the effect runs where the
+   condition holds. The Touch rule stops the subject by default. Positions
+   and speeds are read and set in whole pixels ; a relative Set moves them
+   by whole pixels, keeping their fraction. */
+namespace Rules
+{
+    enum Op : uint8_t
+    {
+        LOADK,   // r[a] = k
+        LOADVAR, // r[a] = var_[k]
+        LOADS,   // r[a] = field k of the subject
+        LOADO,   // r[a] = field k of the object
+        DIST2,   // r[a] = squared distance from subject to object
+        TOUCH,   // r[a] = a spot of the subject is in mask k of the object
+        EQ,      // r[a] = r[b] == r[c]
+        NE,
+        LT,
+        LE,
+        ADD,     // r[a] = r[b] + r[c]
+        SUB,
+        MUL,
+        MULSAT,  // r[a] = r[b] * r[c], clamped to int32_t as DIST2
+        AND,
+        OR,
+        NOT,     // r[a] = !r[b]
+        TEST,    // stops, the condition failing, if !r[a]
+        SETVAR,  // var_[k] = r[a]
+        SETS,    // field k of the subject = r[a]
+        ADDS,    // field k of the subject += r[a], its fraction kept
+        FREE,    // frees the subject
+        WAKE,    // wakes the subject
+    };
+
+    enum Field
+    {
+        X,
+        Y,
+        VX,
+        VY,
+        STATE,
+        NUMBER_FIELDS
+    };
+
+    static constexpr int nb_registers_ = 16;
+
+    struct Instr
+    {
+        Op op_;
+        uint8_t a_, b_, c_;
+        int32_t k_;
+    }; //8o
+
+    struct Names
+    {
+        std::map<std::string, int> types_;
+        std::map<std::string, int> vars_;
+        std::map<std::string, int> masks_;
+        int char_type_{0};
+
+        /* masks of mask_names() */
+        Names();
+    };
+
+    class Rule
+    {
+    public:
+        // -1 for every type
+        int subjects_{-1};
+        int objects_{-1};
+        int phase_{0};
+        // radius of a Near() the condition requires, -1 if none
+        int64_t near_{-1};
+        // the condition holds whatever the objects, once per tick
+        std::vector<Instr> invariant_;
+        // parts of the condition depending on the subject only
+        std::vector<Instr> subject_;
+        // rest of the condition then the effect
+        std::vector<Instr> pair_;
+    };
+
+    /* live slots, by type, gathered once for all the rules of a phase */
+    class Slots
+    {
+        std::vector<int> all_;
+        std::array<std::vector<int>, 256> by_type_;
+
+    public:
+        void build(const State &st);
+
+        const std::vector<int> &select(int type) const
+        {
+            return type < 0 ? all_ : by_type_[type];
+        }
+    };
+
+    /* false, error being set, if source is not a valid rule */
+    bool compile(const std::string &source,
+                 const Names &names,
+                 Rule &rule,
+                 std::string &error);
+
+    /* near, up to date with st, narrows the objects of a Near() rule and
+       follows the subjects the rule moves */
+    void run(const Rule &rule,
+             State &st,
+             const std::vector<ObjData::CollisionEvts> &evts,
+             const Slots &slots,
+             ProximityIndex &near);
+}
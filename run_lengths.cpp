@@ -0,0 +1,143 @@
+#include "objectdata.h"
+
+#include <algorithm>
+
+using namespace ObjData;
+
+namespace
+{
+    constexpr std::array<IPoint2D, NUMBER_SWEEPS> steps = {IPoint2D(0, 1),
+                                                           IPoint2D(0, -1),
+                                                           IPoint2D(-1, 0),
+                                                           IPoint2D(1, 0)};
+}
+
+RunLengths::RunLengths(const Sprite &sprite)
+    : x_(sprite.coor_.first.real()),
+      y_(sprite.coor_.first.imag()),
+      w_(sprite.coor_.second.real() - sprite.coor_.first.real() + 1),
+      h_(sprite.coor_.second.imag() - sprite.coor_.first.imag() + 1)
+{
+    const auto &image = *sprite.image_;
+    for (int mask : {WALL, GROUND})
+    {
+        for (int sweep = 0; sweep != NUMBER_SWEEPS; ++sweep)
+        {
+            auto &runs = runs_[(mask == GROUND) * NUMBER_SWEEPS + sweep];
+            runs.assign(w_ * h_, 0);
+
+            // against the sweep, the next pixel is always done first
+            int dx = steps[sweep].real();
+            int dy = steps[sweep].imag();
+            for (int j = 0; j != h_; ++j)
+            {
+                int v = dy > 0 ? h_ - 1 - j : j;
+                for (int i = 0; i != w_; ++i)
+                {
+                    int u = dx > 0 ? w_ - 1 - i : i;
+                    if (image.content_[(x_ + u) + (y_ + v) * image.stride_].masks_ & (1 << mask))
+                        continue;
+
+                    int un = u + dx;
+                    int vn = v + dy;
+                    if (un < 0 || vn < 0 || un >= w_ || vn >= h_)
+                    {
+                        runs[u + v * w_] = edge_ | 1;
+                        continue;
+                    }
+                    uint16_t next = runs[un + vn * w_];
+                    runs[u + v * w_] = (next & edge_) | ((next & ~edge_) + 1);
+                }
+            }
+        }
+    }
+}
+
+int64_t Map::sweep(uint32_t timestamp,
+                   ID_MASK mask,
+                   Point2D pos,
+                   ID_SWEEP sweep,
+                   int64_t length) const
+{
+    const auto step = steps[sweep];
+    const bool vertical = step.real() == 0;
+    const int64_t w_map = int64_t(cells_.w()) * w_cell_;
+    const int64_t h_map = int64_t(cells_.h()) * h_cell_;
+
+    int64_t done = 0;
+    while (done < length)
+    {
+        // rounding toward 0 gives pixel 0 twice when crossing 0
+        fixed along = (vertical ? pos.imag() : pos.real()) + (vertical ? step.imag() : step.real()) * done;
+        bool around_0 = along.roundin() == 0 && along.fractional() != 0;
+        int64_t x = vertical ? pos.real().roundin() : along.roundin();
+        int64_t y = vertical ? along.roundin() : pos.imag().roundin();
+
+        // out of the map : free up to its border, if heading there
+        if (x < 0 || y < 0 || x >= w_map || y >= h_map)
+        {
+            int64_t across = vertical ? x : y;
+            int64_t along = vertical ? y : x;
+            int64_t size_along = vertical ? h_map : w_map;
+            int dir = vertical ? step.imag() : step.real();
+            if (across < 0 || across >= (vertical ? w_map : h_map))
+                return length;
+            if (along < 0 && dir > 0)
+                done += -along;
+            else if (along >= size_along && dir < 0)
+                done += along - size_along + 1;
+            else
+                return length;
+            continue;
+        }
+
+        int64_t cx = x / w_cell_;
+        int64_t cy = y / h_cell_;
+        int64_t lx = x - cx * w_cell_;
+        int64_t ly = y - cy * h_cell_;
+        int64_t advance = sweep == SWEEP_DOWN ? h_cell_ - ly
+                        : sweep == SWEEP_UP ? ly + 1
+                        : sweep == SWEEP_LEFT ? lx + 1
+                        : w_cell_ - lx;
+
+        if (const auto *cell = cells_.at(cx, cy))
+        {
+            const auto &sprite = cell->get(timestamp).sprite_;
+            const auto [first, second] = sprite.coor_;
+            IPoint2D p(lx + first.real(), ly + first.imag());
+            auto runs = runs_.find(&sprite);
+
+            if (runs == runs_.end() || !RunLengths::baked(mask))
+            {
+                // one pixel at a time
+                if (sprite.contains(Point2D(lx, ly), mask))
+                    return done;
+                advance = 1;
+            }
+            else if (inside(sprite.coor_, p))
+            {
+                uint16_t run = runs->second.run(mask, sweep, p.real(), p.imag());
+                int64_t free = run & ~RunLengths::edge_;
+                if (!(run & RunLengths::edge_) && free < advance && (!around_0 || !free))
+                    return std::min(done + free, length);
+                advance = std::min(free, advance);
+            }
+            else
+            {
+                // free until the sprite, if on the way
+                bool in_x = p.real() >= first.real() && p.real() <= second.real();
+                bool in_y = p.imag() >= first.imag() && p.imag() <= second.imag();
+                if (sweep == SWEEP_DOWN && in_x && p.imag() < first.imag())
+                    advance = std::min<int64_t>(advance, first.imag() - p.imag());
+                else if (sweep == SWEEP_UP && in_x && p.imag() > second.imag())
+                    advance = std::min<int64_t>(advance, p.imag() - second.imag());
+                else if (sweep == SWEEP_LEFT && in_y && p.real() > second.real())
+                    advance = std::min<int64_t>(advance, p.real() - second.real());
+                else if (sweep == SWEEP_RIGHT && in_y && p.real() < first.real())
+                    advance = std::min<int64_t>(advance, first.real() - p.real());
+            }
+        }
+        done += around_0 ? 1 : advance;
+    }
+    return length;
+}
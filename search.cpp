@@ -0,0 +1,192 @@
+#include "search.h"
+#include "stepper.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <numeric>
+
+TranspositionTable::TranspositionTable(size_t max_bytes)
+{
+    size_t size = 1;
+    while (size * 2 * sizeof(Entry) <= max_bytes)
+        size *= 2;
+    entries_.assign(size, {0, -1});
+    mask_ = size - 1;
+}
+
+bool TranspositionTable::insert(uint64_t hash, int32_t depth)
+{
+    Entry *victim = nullptr;
+    for (int probe = 0; probe != nb_probes_; ++probe)
+    {
+        auto &entry = entries_[(hash + probe) & mask_];
+        if (entry.depth_ >= 0 && entry.hash_ == hash)
+        {
+            if (entry.depth_ <= depth)
+                return false;
+            entry.depth_ = depth;
+            return true;
+        }
+        if (!victim || entry.depth_ < 0 || entry.depth_ > victim->depth_)
+            victim = &entry;
+    }
+    // keep the shallowest states, they cut the most branches
+    *victim = {hash, depth};
+    return true;
+}
+
+std::vector<std::vector<KeyStrokes>> Search::default_moves()
+{
+    std::vector<std::vector<KeyStrokes>> result;
+    for (int jump = 0; jump != 2; ++jump)
+    {
+        for (int direction = 0; direction != 3; ++direction)
+        {
+            KeyStrokes keys{};
+            keys.left_ = direction == 1;
+            keys.right_ = direction == 2;
+            keys.jump_ = jump;
+            result.push_back({keys});
+        }
+    }
+    return result;
+}
+
+namespace
+{
+    struct Candidate
+    {
+        State state_;
+        int64_t score_;
+        uint64_t hash_;
+        bool goal_;
+    };
+
+    /* the beam only keeps states, the tree only keeps how to get there */
+    struct Link
+    {
+        int32_t parent_;
+        int32_t move_;
+    };
+}
+
+SearchResult Search::run(const ObjData::Level &level,
+                         const State &root,
+                         const Score &score,
+                         const Options &options,
+                         ThreadPool &pool)
+{
+    auto start = std::chrono::steady_clock::now();
+    const int nb_moves = options.moves_.size();
+
+    TranspositionTable table(options.table_bytes_);
+    // a position reached again later is no new node
+    table.insert(root.position_hash(), 0);
+    int probe = -1;
+    if (options.monitor_)
+        probe = options.monitor_->track(MEMORY_CACHES, [&table] { return table.bytes(); });
+
+    std::vector<State> beam(1, root);
+    std::vector<std::vector<Link>> tree;
+    std::vector<Candidate> candidates;
+
+    SearchResult result;
+    result.state_ = std::make_unique<State>(root);
+    result.score_ = score(root);
+    result.nodes_ = 0;
+    int best_depth = 0;
+    int best_index = 0;
+
+    for (int depth = 1; depth <= options.max_depth_ && !beam.empty(); ++depth)
+    {
+        candidates.resize(beam.size() * nb_moves);
+        pool.run(candidates.size(), [&](int i)
+        {
+            auto &candidate = candidates[i];
+            // stepped in place : a state of 64k slots does not fit the
+            // stack of a pool thread
+            const auto &k = options.moves_[i % nb_moves];
+            candidate.state_ = beam[i / nb_moves];
+            Stepper(level).step(candidate.state_, k.data(), k.size());
+            candidate.score_ = score(candidate.state_);
+            candidate.hash_ = candidate.state_.position_hash();
+            candidate.goal_ = options.goal_ && options.goal_(candidate.state_);
+        });
+        result.nodes_ += candidates.size();
+
+        // deduplication in candidate order, so that the result does not
+        // depend on the scheduling
+        std::vector<int> kept;
+        for (int i = 0; i != static_cast<int>(candidates.size()); ++i)
+            if (table.insert(candidates[i].hash_, depth))
+                kept.push_back(i);
+
+        std::stable_sort(kept.begin(), kept.end(), [&](int i1, int i2)
+        {
+            return candidates[i1].score_ > candidates[i2].score_;
+        });
+        // the first node reaching the goal, whatever its score : looked
+        // for before the beam is cut, and kept past its end
+        auto goal = std::find_if(kept.begin(), kept.end(), [&](int i) { return candidates[i].goal_; });
+        int goal_index = goal == kept.end() ? -1 : goal - kept.begin();
+        if (static_cast<int>(kept.size()) > options.beam_width_)
+        {
+            int reached = goal_index >= 0 ? *goal : -1;
+            kept.resize(options.beam_width_);
+            if (goal_index >= options.beam_width_)
+            {
+                goal_index = kept.size();
+                kept.push_back(reached);
+            }
+        }
+        if (options.monitor_)
+            options.monitor_->sample(root.timestamp_ + depth);
+
+        auto &links = tree.emplace_back();
+        std::vector<State> next_beam;
+        next_beam.reserve(kept.size());
+        for (int i : kept)
+        {
+            links.push_back({i / nb_moves, i % nb_moves});
+            next_beam.push_back(candidates[i].state_);
+        }
+        beam = std::move(next_beam);
+
+        if (!kept.empty() && candidates[kept.front()].score_ > result.score_)
+        {
+            result.score_ = candidates[kept.front()].score_;
+            *result.state_ = beam.front();
+            best_depth = depth;
+            best_index = 0;
+        }
+
+        if (goal_index >= 0)
+        {
+            best_index = goal_index;
+            best_depth = depth;
+            *result.state_ = beam[goal_index];
+            result.score_ = candidates[kept[goal_index]].score_;
+            break;
+        }
+    }
+
+    for (int depth = best_depth; depth > 0; --depth)
+    {
+        const auto &link = tree[depth - 1][best_index];
+        result.inputs_.push_back(options.moves_[link.move_]);
+        best_index = link.parent_;
+    }
+    std::reverse(result.inputs_.begin(), result.inputs_.end());
+
+    size_t links = 0;
+    for (const auto &layer : tree)
+        links += layer.size();
+    result.bytes_ = table.bytes()
+                    + links * sizeof(Link)
+                    + candidates.capacity() * sizeof(Candidate)
+                    + options.beam_width_ * sizeof(State);
+    result.duration_ = std::chrono::steady_clock::now() - start;
+    if (options.monitor_)
+        options.monitor_->untrack(probe);
+    return result;
+}
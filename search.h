@@ -0,0 +1,92 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "data.h"
+#include "memory.h"
+
+class ThreadPool;
+
+/* fixed memory set of already reached state hashes, with the depth they
+   were reached at. Colliding entries replace each other */
+class TranspositionTable
+{
+    struct Entry
+    {
+        uint64_t hash_;
+        int32_t depth_;
+    };
+
+    static constexpr int nb_probes_ = 4;
+
+    std::vector<Entry> entries_;
+    uint64_t mask_;
+
+public:
+    explicit TranspositionTable(size_t max_bytes);
+
+    /* false if hash was already reached at a lower or equal depth */
+    bool insert(uint64_t hash, int32_t depth);
+
+    size_t bytes() const
+    {
+        return entries_.size() * sizeof(Entry);
+    }
+};
+
+struct SearchResult
+{
+    std::vector<std::vector<KeyStrokes>> inputs_;
+    // on the heap, as the beam
+    std::unique_ptr<State> state_;
+    int64_t score_;
+    uint64_t nodes_;
+    size_t bytes_;
+    std::chrono::nanoseconds duration_;
+
+    double nodes_per_second() const
+    {
+        return nodes_ * 1e9 / std::max<int64_t>(1, duration_.count());
+    }
+
+    double bytes_per_node() const
+    {
+        return nodes_ ? static_cast<double>(bytes_) / nodes_ : 0.;
+    }
+};
+
+/* beam search over KeyStrokes sequences, keeping the beam_width_ best
+   scored states at each depth */
+class Search
+{
+public:
+    using Score = std::function<int64_t (const State &)>;
+    using Goal = std::function<bool (const State &)>;
+
+    struct Options
+    {
+        int beam_width_{256};
+        int max_depth_{600};
+        size_t table_bytes_{64 << 20};
+        std::vector<std::vector<KeyStrokes>> moves_{default_moves()};
+        // the search stops at the first node reaching it. Called on
+        // every new node, from the threads of the pool
+        Goal goal_;
+        // the table is reported under MEMORY_CACHES, sampled every depth
+        MemoryMonitor *monitor_{nullptr};
+    };
+
+    /* first player only : nothing, left, right, jump and combinations */
+    static std::vector<std::vector<KeyStrokes>> default_moves();
+
+    static SearchResult run(const ObjData::Level &level,
+                            const State &root,
+                            const Score &score,
+                            const Options &options,
+                            ThreadPool &pool);
+};
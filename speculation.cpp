@@ -0,0 +1,178 @@
+#include "speculation.h"
+#include "stepper.h"
+#include "thread_pool.h"
+
+#include <cstring>
+#include <thread>
+
+uint64_t StateCache::pack(const std::vector<KeyStrokes> &k)
+{
+    uint64_t result = 0;
+    for (size_t i = 0; i != k.size() && i != sizeof(result); ++i)
+    {
+        uint8_t byte;
+        std::memcpy(&byte, &k[i], sizeof(byte));
+        result |= static_cast<uint64_t>(byte) << (8 * i);
+    }
+    return result;
+}
+
+bool StateCache::find(const State &parent, const std::vector<KeyStrokes> &k, State &next)
+{
+    Key key{parent.hash(), pack(k)};
+    std::lock_guard lock(mutex_);
+    auto it = index_.find(key);
+    if (it == index_.end() || !it->second->parent_.same(parent))
+        return false;
+    lru_.splice(lru_.begin(), lru_, it->second);
+    next = it->second->next_;
+    return true;
+}
+
+bool StateCache::contains(const State &parent, const std::vector<KeyStrokes> &k) const
+{
+    Key key{parent.hash(), pack(k)};
+    std::lock_guard lock(mutex_);
+    auto it = index_.find(key);
+    return it != index_.end() && it->second->parent_.same(parent);
+}
+
+StateCache::Pending StateCache::pending(const State &parent, const std::vector<KeyStrokes> &k)
+{
+    Pending result;
+    auto &entry = result.entry_.emplace_back();
+    entry.key_ = {parent.hash(), pack(k)};
+    entry.parent_ = parent;
+    return result;
+}
+
+void StateCache::insert(Pending pending)
+{
+    auto key = pending.entry_.front().key_;
+    std::lock_guard lock(mutex_);
+    if (auto it = index_.find(key); it != index_.end())
+    {
+        // the same parent, or one of the same hash taking its place
+        if (it->second->parent_.same(pending.entry_.front().parent_))
+        {
+            lru_.splice(lru_.begin(), lru_, it->second);
+            return;
+        }
+        lru_.erase(it->second);
+        index_.erase(it);
+    }
+    lru_.splice(lru_.begin(), pending.entry_);
+    index_[key] = lru_.begin();
+    if (lru_.size() > capacity_)
+    {
+        index_.erase(lru_.back().key_);
+        lru_.pop_back();
+    }
+}
+
+void StateCache::insert(const State &parent, const std::vector<KeyStrokes> &k, const State &st)
+{
+    auto entry = pending(parent, k);
+    entry.next() = st;
+    insert(std::move(entry));
+}
+
+void StateCache::clear()
+{
+    std::lock_guard lock(mutex_);
+    index_.clear();
+    lru_.clear();
+}
+
+size_t StateCache::bytes() const
+{
+    std::lock_guard lock(mutex_);
+    return sizeof(*this)
+           + lru_.size() * (sizeof(Entries::value_type) + 2 * sizeof(void *))
+           + index_.size() * (sizeof(std::pair<const Key, Entries::iterator>) + 2 * sizeof(void *))
+           + index_.bucket_count() * sizeof(void *);
+}
+
+Speculator::Speculator(const ObjData::Level &level,
+                       ThreadPool &pool,
+                       size_t capacity,
+                       int horizon,
+                       MemoryMonitor *monitor)
+    : level_(level), pool_(pool), cache_(capacity), horizon_(horizon), monitor_(monitor)
+{
+    if (monitor_)
+        probe_ = monitor_->track(MEMORY_CACHES, [this] { return cache_.bytes(); });
+}
+
+Speculator::~Speculator()
+{
+    if (monitor_)
+        monitor_->untrack(probe_);
+    generation_++;
+    while (running_)
+        std::this_thread::yield();
+}
+
+/* one state per task, on the heap : at 64k slots it would not fit the
+   stack of a pool thread */
+void Speculator::speculate(uint64_t generation, std::shared_ptr<const State> start, std::vector<KeyStrokes> k)
+{
+    auto st = std::make_unique<State>(*start);
+    start.reset();
+    Stepper stepper(level_);
+    for (int tick = 0; tick != horizon_ && generation == generation_; ++tick)
+    {
+        if (cache_.find(*st, k, *st))
+            continue;
+        auto pending = StateCache::pending(*st, k);
+        stepper.step(*st, k.data(), k.size());
+        pending.next() = *st;
+        cache_.insert(std::move(pending));
+    }
+    running_--;
+}
+
+void Speculator::cursor(const State &st, const std::vector<KeyStrokes> &k)
+{
+    uint64_t generation = ++generation_;
+    edit_time_ = std::chrono::steady_clock::now();
+    waiting_first_frame_ = true;
+
+    std::vector<KeyStrokes> released(k.size(), KeyStrokes{});
+    std::vector<KeyStrokes> jump = k;
+    for (auto &keys : jump)
+        keys.jump_ = 1;
+
+    // one copy for the three tasks
+    auto start = std::make_shared<const State>(st);
+    for (auto &alternative : {k, released, jump})
+    {
+        running_++;
+        pool_.post([this, generation, start, alternative]()
+        {
+            speculate(generation, start, alternative);
+        });
+    }
+}
+
+void Speculator::compute(State &st, const std::vector<KeyStrokes> &k)
+{
+    if (cache_.find(st, k, st))
+        hits_++;
+    else
+    {
+        misses_++;
+        auto pending = StateCache::pending(st, k);
+        Stepper(level_).step(st, k.data(), k.size());
+        pending.next() = st;
+        cache_.insert(std::move(pending));
+    }
+
+    if (waiting_first_frame_.exchange(false))
+        first_frame_ = std::chrono::steady_clock::now() - edit_time_;
+}
+
+Speculator::Stats Speculator::stats() const
+{
+    return {hits_, misses_, first_frame_};
+}
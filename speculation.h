@@ -0,0 +1,144 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "data.h"
+#include "memory.h"
+
+class ThreadPool;
+
+/* next state keyed by (parent state hash, inputs), least recently used
+   entries are dropped first. The parent is kept along to check a hit,
+   a collision of the hashes being a miss. compute gives the same state
+   with or without a pool, the entries serve either */
+class StateCache
+{
+    struct Key
+    {
+        uint64_t parent_;
+        uint64_t keys_;
+
+        bool operator==(const Key &other) const
+        {
+            return parent_ == other.parent_ && keys_ == other.keys_;
+        }
+    };
+
+    struct KeyHash
+    {
+        size_t operator()(const Key &key) const
+        {
+            return key.parent_ ^ (key.keys_ * 0x9E3779B97F4A7C15ull);
+        }
+    };
+
+    struct Entry
+    {
+        Key key_;
+        State parent_;
+        State next_;
+    };
+
+    using Entries = std::list<Entry>;
+
+public:
+    /* an entry made outside the lock : the parent copied in, then the
+       next state once computed. insert takes it without a copy */
+    class Pending
+    {
+        friend class StateCache;
+        Entries entry_;
+
+    public:
+        State &next()
+        {
+            return entry_.front().next_;
+        }
+    };
+
+private:
+    Entries lru_;
+    std::unordered_map<Key, Entries::iterator, KeyHash> index_;
+    size_t capacity_;
+    mutable std::mutex mutex_;
+
+public:
+    explicit StateCache(size_t capacity)
+        : capacity_(capacity)
+    {
+    }
+
+    static uint64_t pack(const std::vector<KeyStrokes> &k);
+
+    /* a hit is copied into next, which may be parent itself */
+    bool find(const State &parent, const std::vector<KeyStrokes> &k, State &next);
+    bool contains(const State &parent, const std::vector<KeyStrokes> &k) const;
+    static Pending pending(const State &parent, const std::vector<KeyStrokes> &k);
+    void insert(Pending pending);
+    void insert(const State &parent, const std::vector<KeyStrokes> &k, const State &st);
+    void clear();
+
+    size_t bytes() const;
+};
+
+/* simulates ahead of the cursor in the background, for the inputs the
+   player is the most likely to try next : held, released and jump */
+class Speculator
+{
+public:
+    struct Stats
+    {
+        uint64_t hits_;
+        uint64_t misses_;
+        std::chrono::nanoseconds first_frame_;
+
+        double hit_rate() const
+        {
+            auto total = hits_ + misses_;
+            return total ? static_cast<double>(hits_) / total : 0.;
+        }
+    };
+
+private:
+    const ObjData::Level &level_;
+    ThreadPool &pool_;
+    StateCache cache_;
+    int horizon_;
+    MemoryMonitor *monitor_;
+    int probe_{-1};
+
+    std::atomic<uint64_t> generation_{0};
+    std::atomic<int> running_{0};
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+    std::atomic<bool> waiting_first_frame_{false};
+    std::chrono::steady_clock::time_point edit_time_;
+    std::chrono::nanoseconds first_frame_{0};
+
+    void speculate(uint64_t generation, std::shared_ptr<const State> start, std::vector<KeyStrokes> k);
+
+public:
+    /* the cache is reported to monitor under MEMORY_CACHES */
+    Speculator(const ObjData::Level &level,
+               ThreadPool &pool,
+               size_t capacity,
+               int horizon,
+               MemoryMonitor *monitor = nullptr);
+    ~Speculator();
+
+    /* the cursor moved to st, k being the inputs held there */
+    void cursor(const State &st, const std::vector<KeyStrokes> &k);
+
+    /* st one tick further in place, as Stepper::step, looking up the
+       cache first */
+    void compute(State &st, const std::vector<KeyStrokes> &k);
+
+    Stats stats() const;
+};
@@ -0,0 +1,97 @@
+#include "objectdata.h"
+
+#include <algorithm>
+
+using namespace ObjData;
+
+void SpriteIndex::clear()
+{
+    sprites_.clear();
+    for (auto &layer : layers_)
+    {
+        layer.max_extent_ = {};
+        for (auto &[key, cell] : layer.cells_)
+            cell.clear();
+    }
+}
+
+void SpriteIndex::insert(const SpriteInstance &si)
+{
+    Point2D coeff = si.has_parallax_ ? si.parallax_coeff_ : Point2D();
+    auto layer = std::find_if(layers_.begin(),
+                              layers_.end(),
+                              [coeff](const Layer &layer)
+                              {
+                                  return layer.coeff_ == coeff;
+                              });
+    if (layer == layers_.end())
+    {
+        layers_.push_back({coeff, {}, {}});
+        layer = layers_.end() - 1;
+    }
+
+    auto extent = si.extent();
+    layer->max_extent_ = {std::max(layer->max_extent_.real(), extent.real()),
+                          std::max(layer->max_extent_.imag(), extent.imag())};
+
+    int64_t x = si.coor_.real().roundin() / cell_size_;
+    int64_t y = si.coor_.imag().roundin() / cell_size_;
+    layer->cells_[key(x, y)].push_back(sprites_.size());
+    sprites_.push_back(si);
+}
+
+void SpriteIndex::query(Point2D camera,
+                        Point2D size,
+                        std::vector<SpriteInstance> &result,
+                        std::vector<int> &found) const
+{
+    found.clear();
+    auto visible = [&](int id)
+    {
+        const auto &si = sprites_[id];
+        auto pos = si.pos(camera) - camera;
+        auto extent = si.extent();
+        return pos.real() + extent.real() > 0
+               && pos.imag() + extent.imag() > 0
+               && pos.real() <= size.real()
+               && pos.imag() <= size.imag();
+    };
+
+    for (const auto &layer : layers_)
+    {
+        // [camera - extent, camera + size] on screen, back to world
+        double kx = 1. + layer.coeff_.real().to_double();
+        double ky = 1. + layer.coeff_.imag().to_double();
+        if (kx <= 0. || ky <= 0.)
+        {
+            for (const auto &[key, cell] : layer.cells_)
+                for (int id : cell)
+                    if (visible(id))
+                        found.push_back(id);
+            continue;
+        }
+        double cx = camera.real().to_double();
+        double cy = camera.imag().to_double();
+        int64_t x1 = std::floor((cx - layer.max_extent_.real() / kx) / cell_size_) - 1;
+        int64_t y1 = std::floor((cy - layer.max_extent_.imag() / ky) / cell_size_) - 1;
+        int64_t x2 = std::floor((cx + size.real().to_double() / kx) / cell_size_) + 1;
+        int64_t y2 = std::floor((cy + size.imag().to_double() / ky) / cell_size_) + 1;
+
+        for (int64_t y = y1; y <= y2; ++y)
+        {
+            for (int64_t x = x1; x <= x2; ++x)
+            {
+                auto it = layer.cells_.find(key(x, y));
+                if (it == layer.cells_.end())
+                    continue;
+                for (int id : it->second)
+                    if (visible(id))
+                        found.push_back(id);
+            }
+        }
+    }
+
+    std::sort(found.begin(), found.end());
+    for (int id : found)
+        result.push_back(sprites_[id]);
+}
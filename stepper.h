@@ -0,0 +1,178 @@
+#pragma once
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+#include "data.h"
+#include "memory.h"
+#include "objectdata.h"
+#include "proximity.h"
+#include "rules.h"
+
+/* compute in place : the state is updated where it is, and what a tick
+   needs besides it (events, proximity index, collision cache, the
+   copies the blocks run on...) is kept from one tick to the next. Once
+   the buffers have grown, stepping copies no whole state and allocates
+   nothing but what the actions and the rules themselves allocate.
+   Without a pool, or with RNG_LCG, a phase runs on the state itself.
+   With one, the blocks run ahead on a lane per thread : a copy of the
+   state, brought up to date with each phase for the live slots only,
+   that the blocks run on in turn, what a block wrote being taken out of
+   it slot by slot. */
+class Stepper
+{
+    // what the sleep pass compares the end of the tick with
+    struct Before
+    {
+        Point2D pos_;
+        Point2D speed_;
+        uint8_t type_;
+        uint8_t state_;
+    };
+
+    static constexpr int block_size_ = 32;
+    static constexpr int nb_blocks_ = State::nb_slots_ / block_size_;
+    static_assert(64 % block_size_ == 0 && State::nb_slots_ % block_size_ == 0);
+
+    template <typename T>
+    using Buffer = std::vector<T, TaggedAllocator<T, MEMORY_TICK>>;
+
+    // a slot a block wrote and its draws, as the block left them
+    struct Write
+    {
+        int slot_;
+        StateObject after_;
+        uint32_t draws_;
+    };
+
+    // what a block run ahead wrote, as values, and what it may have
+    // read : the slots, the var_ entries, or every slot
+    struct Block
+    {
+        Buffer<Write> slots_;
+        Buffer<std::pair<int, int32_t>> vars_;
+        Buffer<int> read_slots_;
+        Buffer<int> read_vars_;
+        bool others_{false};
+        // xscreen_, yscreen_ and rnd_, if the block changed any
+        bool globals_{false};
+        int32_t xscreen_{0};
+        int32_t yscreen_{0};
+        uint32_t rnd_{0};
+        // as left by the block in State::allocated_
+        int32_t allocated_{0};
+    };
+
+    // as of the start of the phase between two blocks
+    struct Lane
+    {
+        State st_;
+        // the slots the block executed, and their types
+        Buffer<std::pair<int, int>> executed_;
+    };
+
+    // what was written since the start of the phase, by the blocks taken
+    // or run again in place
+    struct Dirty
+    {
+        Buffer<uint64_t> slots_;
+        std::bitset<State::nb_vars_> vars_;
+        bool any_slot_{false};
+        bool occupancy_{false};
+        bool globals_{false};
+        // by an object reading the others : anything
+        bool all_{false};
+
+        void mark(int slot)
+        {
+            slots_[slot / 64] |= uint64_t(1) << (slot % 64);
+            any_slot_ = true;
+        }
+
+        bool marked(int slot) const
+        {
+            return slots_[slot / 64] >> (slot % 64) & 1;
+        }
+    };
+
+    const ObjData::Level &level_;
+    ThreadPool *pool_;
+    ObjData::CollisionCache own_cache_;
+    ObjData::CollisionCache *cache_;
+    std::vector<ObjData::CollisionEvts> evts_;
+    ProximityIndex near_;
+    Rules::Slots slots_;
+    // indexed by slot
+    Buffer<Before> before_;
+    std::array<uint64_t, State::nb_words_> live_;
+    std::array<int32_t, State::nb_vars_> vars_;
+    // the blocks of the phase, those run ahead, their writes and the
+    // lanes they run on
+    std::array<int, nb_blocks_> active_;
+    Buffer<uint8_t> ahead_;
+    Buffer<Block> blocks_;
+    Buffer<Lane> lanes_;
+    Dirty dirty_;
+    // a block run again in place : the slots it may write as they were,
+    // var_, and the slots it executed
+    Buffer<Write> saved_;
+    Buffer<int32_t> saved_vars_;
+    Buffer<std::pair<int, int>> executed_;
+    MemoryMonitor *monitor_{nullptr};
+
+    static void sync(State &lane, const State &st);
+
+    void execute(State &st, int self, int phase, DependencyLog *log);
+    void execute_phase(State &st, int phase, ThreadPool *pool, DependencyLog *log);
+    void run_block(State &local, int block, int phase, Buffer<std::pair<int, int>> &executed);
+    void collect(Lane &lane, const State &st, int block, Block &result) const;
+    bool valid(const Block &block) const;
+    void apply(State &st, const Block &block);
+    void run_in_place(State &st, int block, int phase);
+
+public:
+    /* without a cache, the stepper keeps its own */
+    explicit Stepper(const ObjData::Level &level,
+                     ThreadPool *pool = nullptr,
+                     ObjData::CollisionCache *cache = nullptr)
+        : level_(level), pool_(pool), cache_(cache ? cache : &own_cache_), before_(State::nb_slots_), ahead_(nb_blocks_)
+    {
+        dirty_.slots_.resize(State::nb_words_);
+    }
+
+    Stepper(const Stepper &) = delete;
+    Stepper &operator=(const Stepper &) = delete;
+
+    /* sampled at the end of every tick, nullptr for none */
+    void monitor(MemoryMonitor *monitor)
+    {
+        monitor_ = monitor;
+    }
+
+    /* one tick, k holding the keys of the first nb_keys players. Same
+       result as compute */
+    void step(State &st, const KeyStrokes *k, size_t nb_keys, DependencyLog *log = nullptr);
+
+    /* nb_ticks ticks, *inputs being a container of KeyStrokes for the
+       first one and ++inputs moving to the next. observer(st) is called
+       every every ticks, 0 for never */
+    template <typename Inputs, typename Observer>
+    void run(State &st, Inputs inputs, int nb_ticks, Observer &&observer, int every = 1)
+    {
+        for (int tick = 1; tick <= nb_ticks; ++tick, ++inputs)
+        {
+            step(st, std::data(*inputs), std::size(*inputs));
+            if (every && tick % every == 0)
+                observer(static_cast<const State &>(st));
+        }
+    }
+
+    template <typename Inputs>
+    void run(State &st, Inputs inputs, int nb_ticks)
+    {
+        run(st, inputs, nb_ticks, [](const State &) {}, 0);
+    }
+};
@@ -0,0 +1,106 @@
+#include "data.h"
+
+#include <chrono>
+#include <complex>
+#include <cstdio>
+#include <vector>
+
+/* Arc::at and a movement kernel on Point2D, against the same over
+   std::complex<fixed>, the type Point2D used to be */
+namespace
+{
+    using Complex = std::complex<fixed>;
+
+    Complex complex_expj(fixed angle)
+    {
+        return Complex(1, 0) * cos(angle) + Complex(0, 1) * sin(angle);
+    }
+
+    Complex complex_at(const Arc &arc, fixed param)
+    {
+        fixed k = param / arc.length_;
+        fixed l = 1 - k;
+        Complex center(arc.center_.real(), arc.center_.imag());
+        if (arc.curved_)
+            return center + arc.radius_ * complex_expj(k * arc.angle1_ + l * arc.angle2_);
+        Complex p1(arc.p1_.real(), arc.p1_.imag());
+        Complex p2(arc.p2_.real(), arc.p2_.imag());
+        return p1 * k + l * p2;
+    }
+
+    template <typename F>
+    double per_second(F f)
+    {
+        int64_t count = 0;
+        auto start = std::chrono::steady_clock::now();
+        std::chrono::duration<double> elapsed{0};
+        while (elapsed.count() < 0.2)
+        {
+            count += f();
+            elapsed = std::chrono::steady_clock::now() - start;
+        }
+        return count / elapsed.count();
+    }
+}
+
+int main()
+{
+    std::vector<Arc> arcs;
+    for (int i = 0; i != 64; ++i)
+    {
+        arcs.emplace_back(Point2D(i, 2 * i), Point2D(300 - i, 100 + i), fixed(3));
+        arcs.emplace_back(Point2D(i, 0), fixed(2), fixed(50 + i), fixed(i), fixed(150 + i));
+    }
+
+    int64_t sink = 0;
+    auto point2d = per_second([&]()
+    {
+        for (const auto &arc : arcs)
+            for (int i = 0; i != 64; ++i)
+                sink += arc.at(arc.length_ * i / 64).real().value_;
+        return arcs.size() * 64;
+    });
+    auto complex = per_second([&]()
+    {
+        for (const auto &arc : arcs)
+            for (int i = 0; i != 64; ++i)
+                sink += complex_at(arc, arc.length_ * i / 64).real().value_;
+        return arcs.size() * 64;
+    });
+    std::printf("Arc::at/s    Point2D %12.0f  complex %12.0f  speedup %5.2f\n",
+                point2d, complex, point2d / complex);
+
+    const int nb_objects = 10000;
+    std::vector<Point2D> pos(nb_objects), speed(nb_objects);
+    std::vector<Complex> cpos(nb_objects), cspeed(nb_objects);
+    for (int i = 0; i != nb_objects; ++i)
+    {
+        speed[i] = Point2D(fixed(i % 7 - 3, fixed::raw), fixed(i % 5 - 2, fixed::raw));
+        cspeed[i] = Complex(speed[i].real(), speed[i].imag());
+    }
+    Point2D gravity(0, fixed(1) / 4);
+    Complex cgravity(gravity.real(), gravity.imag());
+    auto moved = per_second([&]()
+    {
+        for (int i = 0; i != nb_objects; ++i)
+        {
+            speed[i] += gravity;
+            speed[i] *= fixed(63) / 64;
+            pos[i] += speed[i];
+        }
+        return nb_objects;
+    });
+    auto cmoved = per_second([&]()
+    {
+        for (int i = 0; i != nb_objects; ++i)
+        {
+            cspeed[i] += cgravity;
+            cspeed[i] *= fixed(63) / 64;
+            cpos[i] += cspeed[i];
+        }
+        return nb_objects;
+    });
+    std::printf("moves/s      Point2D %12.0f  complex %12.0f  speedup %5.2f\n",
+                moved, cmoved, moved / cmoved);
+    return sink == 42;
+}
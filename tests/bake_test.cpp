@@ -0,0 +1,76 @@
+#include "bake.h"
+#include "tests/test.h"
+#include "thread_pool.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <string>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    void write(const fs::path &path, const std::string &content)
+    {
+        FILE *file = std::fopen(path.c_str(), "wb");
+        std::fwrite(content.data(), 1, content.size(), file);
+        std::fclose(file);
+    }
+
+    /* 2x2, opaque but for the last pixel */
+    std::string pam()
+    {
+        std::string result = "P7\nWIDTH 2\nHEIGHT 2\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n";
+        for (int i = 0; i != 4; ++i)
+            result += std::string{char(10 * i), char(20), char(30), char(i == 3 ? 0 : 255)};
+        return result;
+    }
+
+    int temporaries(const fs::path &cache)
+    {
+        int result = 0;
+        for (const auto &entry : fs::directory_iterator(cache))
+            result += entry.path().extension() == ".tmp";
+        return result;
+    }
+}
+
+int main()
+{
+    auto root = fs::temp_directory_path() / ("bake_test." + std::to_string(std::random_device{}()));
+    fs::create_directories(root / "source");
+    // the same contents twice, baked at once on several threads
+    write(root / "source" / "a.pam", pam());
+    write(root / "source" / "b.pam", pam());
+    write(root / "source" / "c.pam", "P7\nbroken");
+
+    Bake::Options options;
+    options.source_ = (root / "source").string();
+    options.output_ = (root / "output").string();
+    options.cache_ = (root / "cache").string();
+    ThreadPool pool(4);
+
+    auto report = Bake::run(options, pool);
+    CHECK(report.baked_ + report.cached_ == 2);
+    CHECK(report.failed_ == 1);
+    CHECK(temporaries(root / "cache") == 0);
+    ObjData::Image image;
+    CHECK(Bake::read_image((root / "output" / "a.img").string(), image));
+    CHECK(Bake::read_image((root / "output" / "b.img").string(), image));
+    CHECK(image.w_ == 2 && image.content_[3].a_ == 0);
+
+    report = Bake::run(options, pool);
+    CHECK(report.skipped_ == 2);
+
+    // a copy failing is a failure, whatever the next one does
+    fs::remove(root / "cache" / "index");
+    fs::remove(root / "output" / "a.img");
+    fs::create_directories(root / "output" / "a.img" / "in_the_way");
+    report = Bake::run(options, pool);
+    CHECK(report.cached_ == 1);
+    CHECK(report.failed_ == 2);
+
+    fs::remove_all(root);
+    return failures() != 0;
+}
@@ -0,0 +1,107 @@
+#include "speculation.h"
+#include "stepper.h"
+#include "tests/test.h"
+#include "tests/toy_level.h"
+#include "thread_pool.h"
+
+#include <memory>
+#include <vector>
+
+using namespace Toy;
+
+/* State at another capacity than 256, every source being built with
+   -DSTATE_SLOTS=65536 for instance. The states are on the heap */
+namespace
+{
+    std::vector<KeyStrokes> no_keys(State::nb_players_);
+
+    /* drifts spread over the whole capacity, spawners past the middle
+       and a pusher in the last slot, against the last drift */
+    std::unique_ptr<State> spread()
+    {
+        auto st = std::make_unique<State>();
+        st->clear();
+        for (int i = 0; i != 16; ++i)
+            st->set(i * (State::nb_slots_ / 16), World::object(DRIFT, at(i * 40, 0), at(i % 3 - 1, 0)));
+        st->set(State::nb_slots_ / 2 + 1, World::object(SPAWNER, at(0, 100)));
+        st->set(State::nb_slots_ - 2, World::object(SPAWNER, at(100, 100)));
+        st->set(State::nb_slots_ - 1, World::object(PUSHER, at(15 * 40 - 4, 0)));
+        st->timestamp_ = 7;
+        return st;
+    }
+
+    /* in place and by value, with and without a pool, the same ticks */
+    void step(uint32_t rng)
+    {
+        World world;
+        const auto &level = world.level_;
+        ThreadPool pool(4);
+
+        auto sequential = spread();
+        sequential->rng_ = rng;
+        auto pooled = std::make_unique<State>(*sequential);
+        auto value = std::make_unique<State>(*sequential);
+        Stepper stepper(level);
+        Stepper pooled_stepper(level, &pool);
+        for (int tick = 0; tick != 100; ++tick)
+        {
+            stepper.step(*sequential, no_keys.data(), no_keys.size());
+            pooled_stepper.step(*pooled, no_keys.data(), no_keys.size());
+            *value = compute(level, *value, no_keys);
+            CHECK(sequential->hash() == pooled->hash());
+            CHECK(sequential->hash() == value->hash());
+        }
+        CHECK(sequential->var_[0] > 0);
+        CHECK(sequential->var_[1] > 0);
+        CHECK(sequential->nb_live() > 16 + 3);
+    }
+
+    /* the speculator's tasks, on the pool threads, get through 64k
+       slots and give what stepping does */
+    void speculation()
+    {
+        World world;
+        ThreadPool pool(3);
+        Speculator speculator(world.level_, pool, 16, 10);
+        Stepper stepper(world.level_);
+
+        auto start = spread();
+        start->rng_ = RNG_COUNTER;
+        speculator.cursor(*start, no_keys);
+        auto speculated = std::make_unique<State>(*start);
+        for (int tick = 0; tick != 10; ++tick)
+        {
+            speculator.compute(*speculated, no_keys);
+            stepper.step(*start, no_keys.data(), no_keys.size());
+            CHECK(speculated->hash() == start->hash());
+        }
+    }
+
+    /* the spawns take the first free slots, in the order of the
+       spawners, far past 256 */
+    void spawns()
+    {
+        World world;
+        ThreadPool pool(4);
+        for (ThreadPool *p : {static_cast<ThreadPool *>(nullptr), &pool})
+        {
+            auto st = spread();
+            Stepper stepper(world.level_, p);
+            stepper.step(*st, no_keys.data(), no_keys.size());
+            CHECK(st->slots_[State::nb_slots_ / 2 + 1].mvt_[0] == 1);
+            CHECK(st->slots_[State::nb_slots_ - 2].mvt_[0] == 2);
+            CHECK(st->slots_[1].src_ == State::nb_slots_ / 2 + 1);
+            CHECK(st->slots_[2].src_ == State::nb_slots_ - 2);
+        }
+    }
+}
+
+int main()
+{
+    CHECK(State::nb_slots_ != 256);
+    step(RNG_LCG);
+    step(RNG_COUNTER);
+    spawns();
+    speculation();
+    return failures() != 0;
+}
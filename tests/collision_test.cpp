@@ -0,0 +1,133 @@
+#include "stepper.h"
+#include "tests/test.h"
+#include "tests/toy_level.h"
+
+#include <algorithm>
+#include <vector>
+
+using namespace Toy;
+
+namespace
+{
+    std::vector<KeyStrokes> no_keys(State::nb_players_);
+
+    /* the transitions of spot owner and mask owner for mask, as seen by
+       slot */
+    std::vector<ID_CONTACT> contacts(const std::vector<CollisionEvts> &evts,
+                                     int slot,
+                                     int spot_owner,
+                                     int mask_owner,
+                                     ID_MASK mask)
+    {
+        std::vector<ID_CONTACT> result;
+        for (const auto &evt : evts[slot])
+            if (evt.obj_spot_ == spot_owner && evt.obj_mask_ == mask_owner && evt.id_mask_ == mask)
+                result.push_back(evt.contact_);
+        std::sort(result.begin(), result.end());
+        result.erase(std::unique(result.begin(), result.end()), result.end());
+        return result;
+    }
+
+    using Contacts = std::vector<ID_CONTACT>;
+
+    /* the events of the next tick, stepper moving to it */
+    std::vector<CollisionEvts> next(const Level &level, Stepper &stepper, State &st)
+    {
+        std::vector<CollisionEvts> evts;
+        State copy = st;
+        copy.timestamp_++;
+        level.collisions(copy, evts);
+        stepper.step(st, no_keys.data(), no_keys.size());
+        return evts;
+    }
+
+    /* enter, stay and exit per pair, whatever else the spot owner
+       touches, the mask owner's copy telling the same */
+    void pairs()
+    {
+        World world;
+        const auto &level = world.level_;
+        Stepper stepper(level);
+        State st;
+        st.clear();
+        st.set(0, World::object(FLOOR, at(0, 0)));
+        st.set(1, World::object(FLOOR, at(0, 0)));
+
+        auto evts = next(level, stepper, st);
+        CHECK(contacts(evts, 0, 0, 1, GROUND) == Contacts{CONTACT_ENTER});
+        CHECK(contacts(evts, 1, 0, 1, GROUND) == Contacts{CONTACT_ENTER});
+        CHECK(contacts(evts, 1, 1, 0, TARGET) == Contacts{CONTACT_ENTER});
+
+        evts = next(level, stepper, st);
+        CHECK(contacts(evts, 0, 0, 1, GROUND) == Contacts{CONTACT_STAY});
+        CHECK(contacts(evts, 1, 0, 1, GROUND) == Contacts{CONTACT_STAY});
+
+        // slot 0 already touches GROUND, of another object
+        st.set(2, World::object(FLOOR, at(4, 0)));
+        evts = next(level, stepper, st);
+        CHECK(contacts(evts, 0, 0, 1, GROUND) == Contacts{CONTACT_STAY});
+        CHECK(contacts(evts, 0, 0, 2, GROUND) == Contacts{CONTACT_ENTER});
+        CHECK(contacts(evts, 2, 0, 2, GROUND) == Contacts{CONTACT_ENTER});
+
+        // an exit goes to both sides, with the partner
+        st.slots_[1].pos_ = at(100, 0);
+        evts = next(level, stepper, st);
+        CHECK(contacts(evts, 0, 0, 1, GROUND) == Contacts{CONTACT_EXIT});
+        CHECK(contacts(evts, 1, 0, 1, GROUND) == Contacts{CONTACT_EXIT});
+        CHECK(contacts(evts, 1, 1, 0, TARGET) == Contacts{CONTACT_EXIT});
+        CHECK(contacts(evts, 0, 1, 0, TARGET) == Contacts{CONTACT_EXIT});
+        CHECK(contacts(evts, 0, 0, 2, GROUND) == Contacts{CONTACT_STAY});
+
+        // and only once
+        evts = next(level, stepper, st);
+        CHECK(contacts(evts, 0, 0, 1, GROUND).empty());
+        CHECK(contacts(evts, 1, 0, 1, GROUND).empty());
+    }
+
+    /* a slot spawned where a freed one touched enters again */
+    void respawn()
+    {
+        World world;
+        const auto &level = world.level_;
+        Stepper stepper(level);
+        State st;
+        st.clear();
+        st.set(0, World::object(FLOOR, at(0, 0)));
+        st.set(1, World::object(FLOOR, at(0, 0)));
+        next(level, stepper, st);
+
+        st.free(1);
+        CHECK(st.allocate(World::object(FLOOR, at(0, 0))) == 1);
+        auto evts = next(level, stepper, st);
+        CHECK(contacts(evts, 1, 1, 0, GROUND) == Contacts{CONTACT_ENTER});
+    }
+
+    /* the contacts go with the state */
+    void serialize()
+    {
+        World world;
+        Stepper stepper(world.level_);
+        State st;
+        st.clear();
+        st.set(0, World::object(FLOOR, at(0, 0)));
+        st.set(1, World::object(FLOOR, at(0, 0)));
+        stepper.step(st, no_keys.data(), no_keys.size());
+        CHECK(st.nb_touching_ > 0);
+
+        State copy;
+        CHECK(copy.deserialize(st.serialize()));
+        CHECK(copy.hash() == st.hash());
+        CHECK(copy.touching(0, 1, GROUND));
+
+        copy.nb_touching_ = 0;
+        CHECK(copy.hash() != st.hash());
+    }
+}
+
+int main()
+{
+    pairs();
+    respawn();
+    serialize();
+    return failures() != 0;
+}
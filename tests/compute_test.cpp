@@ -0,0 +1,291 @@
+#include "stepper.h"
+#include "tests/test.h"
+#include "tests/toy_level.h"
+#include "thread_pool.h"
+
+#include <memory>
+#include <vector>
+
+using namespace Toy;
+
+/* the states are on the heap, the test being built at 64k slots too */
+namespace
+{
+    std::vector<KeyStrokes> no_keys(State::nb_players_);
+
+    /* the same ticks with and without a pool, whatever its size, with
+       objects assigning var_, teleporting others and taking tickets in
+       several blocks */
+    void pool(uint32_t rng)
+    {
+        World world;
+        const auto &level = world.level_;
+        ThreadPool pool1(1), pool4(4);
+
+        auto sequential = World::crowd();
+        sequential->rng_ = rng;
+        for (int slot : {5, 141})
+            sequential->set(slot, World::object(ASSIGN, at(-1000, slot)));
+        for (int slot : {7, 77, 203})
+            sequential->set(slot, World::object(TICKET, at(-1000, slot)));
+        sequential->set(45, World::object(TELEPORT, at(60, 24)));
+        sequential->set(181, World::object(TELEPORT, at(12, 60)));
+        auto pooled1 = std::make_unique<State>(*sequential);
+        auto pooled4 = std::make_unique<State>(*sequential);
+        auto stepped = std::make_unique<State>(*sequential);
+        Stepper stepper(level, &pool4);
+        int spawns = 0;
+        for (int tick = 0; tick != 300; ++tick)
+        {
+            *sequential = compute(level, *sequential, no_keys);
+            // a stepper per tick, as compute, without its copy
+            Stepper(level, &pool1).step(*pooled1, no_keys.data(), no_keys.size());
+            Stepper(level, &pool4).step(*pooled4, no_keys.data(), no_keys.size());
+            stepper.step(*stepped, no_keys.data(), no_keys.size());
+            CHECK(sequential->hash() == pooled1->hash());
+            CHECK(sequential->hash() == pooled4->hash());
+            CHECK(sequential->hash() == stepped->hash());
+            spawns += sequential->timestamp_ % 8 == 0;
+        }
+        CHECK(spawns > 0);
+        CHECK(sequential->nb_live() > 2 * 32);
+        CHECK(sequential->var_[0] > 0);
+        CHECK(sequential->var_[2] == 7);
+        CHECK(sequential->var_[3] == 3 * 300);
+    }
+
+    /* what the loop over the slots, in place, gives : each object sees
+       what the previous ones wrote, spawns included, whatever the blocks
+       and the pool */
+    void in_order()
+    {
+        World world;
+        const auto &level = world.level_;
+        ThreadPool pool(4);
+
+        auto st = std::make_unique<State>();
+        st->clear();
+        st->rng_ = RNG_COUNTER;
+        for (int slot : {0, 40, 100})
+            st->set(slot, World::object(ASSIGN, at(-1000, slot)));
+        // drifts sent away by a teleporter of another block, before and
+        // after them
+        st->set(10, World::object(DRIFT, at(0, 500), at(5, 0)));
+        st->set(70, World::object(TELEPORT, at(0, 500)));
+        st->set(130, World::object(TELEPORT, at(0, 800)));
+        st->set(160, World::object(DRIFT, at(0, 800), at(5, 0)));
+        const int tickets[] = {5, 50, 90, 170, 250};
+        for (int slot : tickets)
+            st->set(slot, World::object(TICKET, at(-1000, slot)));
+
+        for (ThreadPool *p : {static_cast<ThreadPool *>(nullptr), &pool})
+        {
+            auto next = std::make_unique<State>(compute(level, *st, no_keys, p));
+            CHECK(next->var_[2] == 7);
+            CHECK(next->slots_[10].pos_ == at(-200, -200));
+            CHECK(next->slots_[160].pos_ == at(-195, -200));
+            for (int i = 0; i != 5; ++i)
+                CHECK(next->slots_[tickets[i]].mvt_[0] == uint32_t(i));
+            CHECK(next->var_[3] == 5);
+        }
+    }
+
+    /* draws numbered per slot, whatever the others drew */
+    void draws()
+    {
+        auto st = std::make_unique<State>();
+        st->clear();
+        st->rng_ = RNG_COUNTER;
+        st->rnd_ = 99;
+        st->drawing_ = 3;
+        uint32_t first = st->rnd();
+        uint32_t second = st->rnd(3);
+        CHECK(first == st->rnd(3, 0));
+        CHECK(second == st->rnd(3, 1));
+        CHECK(first != second);
+
+        auto other = std::make_unique<State>(*st);
+        other->draws_.fill(0);
+        other->rnd(5);
+        other->rnd(State::nb_slots_);
+        CHECK(other->rnd() == first);
+    }
+
+    /* RNG_LCG draws the stream of the sequential loop : one value after
+       the other, in slot order, whatever the blocks and the pool */
+    void lcg()
+    {
+        World world;
+        const auto &level = world.level_;
+        ThreadPool pool(4);
+
+        auto st = std::make_unique<State>();
+        st->clear();
+        st->rnd_ = 21;
+        auto drawn = std::make_unique<State>(*st);
+        CHECK(drawn->rnd() == 476605018u);
+        CHECK(drawn->rnd() == 1873375395u);
+        CHECK(drawn->rnd() == 4206099392u);
+        CHECK(drawn->rnd() == 4286029505u);
+
+        // a drift in each of four blocks, far apart
+        for (int slot : {0, 40, 100, 200})
+            st->set(slot, World::object(DRIFT, at(0, slot * 10), at(5, 0)));
+        for (ThreadPool *p : {static_cast<ThreadPool *>(nullptr), &pool})
+        {
+            auto next = std::make_unique<State>(compute(level, *st, no_keys, p));
+            CHECK(next->rnd_ == 4286029505u);
+            // the third value, the only multiple of 32, turns the third
+            // drift back
+            CHECK(next->slots_[0].speed_ == at(5, 0));
+            CHECK(next->slots_[40].speed_ == at(5, 0));
+            CHECK(next->slots_[100].speed_ == at(-5, 0));
+            CHECK(next->slots_[200].speed_ == at(5, 0));
+
+            Stepper stepper(level, p);
+            for (int tick = 1; tick != 10; ++tick)
+                stepper.step(*next, no_keys.data(), no_keys.size());
+            CHECK(next->rnd_ == 3897796109u);
+        }
+    }
+
+    /* the first ticks of the crowd with RNG_LCG, as the loop over the
+       slots in place gave them before the pool : hashes pinned */
+    void baseline()
+    {
+        World world;
+        const auto &level = world.level_;
+        ThreadPool pool(4);
+        const uint64_t pinned[] = {
+            0x917c626fe8e7f528ull, 0x2935caac213ab1abull, 0xcd25b274fdddef48ull, 0xbf5c369df45eb1a6ull,
+            0xfa6cbe77f812bfafull, 0x1442e47b049040c5ull, 0x034e496be6ca9afaull, 0xf13ead20a8dcccd9ull,
+        };
+
+        for (ThreadPool *p : {static_cast<ThreadPool *>(nullptr), &pool})
+        {
+            auto st = World::crowd();
+            st->rng_ = RNG_LCG;
+            for (uint64_t hash : pinned)
+            {
+                *st = compute(level, *st, no_keys, p);
+                CHECK(st->hash() == hash);
+            }
+        }
+    }
+
+    /* two blocks writing the same object and spawning in the same phase */
+    void merge()
+    {
+        World world;
+        const auto &level = world.level_;
+        ThreadPool pool(2);
+
+        auto st = std::make_unique<State>();
+        st->clear();
+        // slots 0 and 64 push slot 128, in a third block
+        st->set(0, World::object(PUSHER, at(0, 0)));
+        st->set(64, World::object(PUSHER, at(0, 0)));
+        st->set(128, World::object(FLOOR, at(0, 0)));
+        st->set(32, World::object(SPAWNER, at(100, 0)));
+        st->set(96, World::object(SPAWNER, at(200, 0)));
+        st->timestamp_ = 7;
+
+        for (ThreadPool *p : {static_cast<ThreadPool *>(nullptr), &pool})
+        {
+            auto next = std::make_unique<State>(compute(level, *st, no_keys, p));
+            CHECK(next->slots_[128].pos_ == at(2, 0));
+            CHECK(next->var_[0] == 2);
+
+            int first = next->slots_[32].mvt_[0];
+            int second = next->slots_[96].mvt_[0];
+            CHECK(first != second);
+            CHECK(next->live(first) && next->slots_[first].src_ == 32);
+            CHECK(next->live(second) && next->slots_[second].src_ == 96);
+            CHECK(next->slots_[first].pos_ == at(100, 32));
+            CHECK(next->slots_[second].pos_ == at(200, 32));
+        }
+    }
+
+    /* the spawns take the first free slots in slot order, wherever the
+       free slots and the spawners lie */
+    void spawns()
+    {
+        World world;
+        const auto &level = world.level_;
+        ThreadPool pool(4);
+
+        auto st = std::make_unique<State>();
+        st->clear();
+        for (int slot = 0; slot != State::nb_slots_; ++slot)
+            st->set(slot, World::object(FLOOR, at(slot % 16 * 40, 1000 + slot / 16 * 40)));
+        st->free(10);
+        st->free(200);
+        for (int slot : {64, 128, 160})
+            st->set(slot, World::object(SPAWNER, at(slot, 0)));
+        st->timestamp_ = 7;
+
+        for (ThreadPool *p : {static_cast<ThreadPool *>(nullptr), &pool})
+        {
+            auto next = std::make_unique<State>(compute(level, *st, no_keys, p));
+            CHECK(next->slots_[64].mvt_[0] == 10);
+            CHECK(next->slots_[128].mvt_[0] == 200);
+            CHECK(int(next->slots_[160].mvt_[0]) == -1);
+            CHECK(next->slots_[10].src_ == 64 && next->slots_[200].src_ == 128);
+            CHECK(next->nb_live() == State::nb_slots_);
+        }
+    }
+
+    /* resting on the ground is no reason to stay awake, losing it is */
+    void sleep()
+    {
+        World world;
+        State st;
+        st.clear();
+        st.set(0, World::object(CRATE, at(0, 0)));
+        st.set(1, World::object(FLOOR, at(0, 40)));
+        Stepper stepper(world.level_);
+        for (int tick = 0; tick != 40; ++tick)
+            stepper.step(st, no_keys.data(), no_keys.size());
+        CHECK(st.asleep(0));
+        auto pos = st.slots_[0].pos_;
+
+        st.free(1);
+        stepper.step(st, no_keys.data(), no_keys.size());
+        CHECK(!st.asleep(0));
+        stepper.step(st, no_keys.data(), no_keys.size());
+        CHECK(st.slots_[0].pos_.imag() > pos.imag());
+    }
+
+    /* nor is waiting for the player, who moves as soon as a key is down */
+    void keys()
+    {
+        World world;
+        State st;
+        st.clear();
+        st.set(0, World::object(PLAYER, at(0, 0)));
+        Stepper stepper(world.level_);
+        for (int tick = 0; tick != 40; ++tick)
+            stepper.step(st, no_keys.data(), no_keys.size());
+        CHECK(st.asleep(0));
+
+        auto right = no_keys;
+        right[0].right_ = 1;
+        stepper.step(st, right.data(), right.size());
+        CHECK(st.slots_[0].pos_ == at(3, 0));
+    }
+}
+
+int main()
+{
+    pool(RNG_LCG);
+    pool(RNG_COUNTER);
+    in_order();
+    draws();
+    lcg();
+    baseline();
+    merge();
+    spawns();
+    sleep();
+    keys();
+    return failures() != 0;
+}
@@ -0,0 +1,77 @@
+#include "dependencies.h"
+#include "stepper.h"
+#include "tests/toy_level.h"
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+using namespace Toy;
+
+/* ticks per second of DependencyLog::resimulate after an edit of the
+   inputs of a far away player, against stepping the same ticks again,
+   for a few costs of the drifts' action */
+int main()
+{
+    using Inputs = std::vector<std::vector<KeyStrokes>>;
+    const int nb_ticks = 300;
+    const int nb_runs = 5;
+
+    std::printf("work  full ticks/s  partial ticks/s  speedup  copied  same\n");
+    for (int work : {0, 100, 1000, 10000})
+    {
+        World world(work);
+        const auto &level = world.level_;
+        State start = *World::crowd();
+        start.set(5, World::object(PLAYER, at(1000, 1000)));
+        start.rng_ = RNG_COUNTER;
+
+        Inputs inputs(nb_ticks, std::vector<KeyStrokes>(State::nb_players_));
+        Inputs edited = inputs;
+        edited[40][0].left_ = 1;
+        edited[41][0].right_ = 1;
+
+        DependencyLog log(level);
+        {
+            State st = start;
+            Stepper stepper(level);
+            for (const auto &k : inputs)
+                stepper.step(st, k.data(), k.size(), &log);
+        }
+
+        State full;
+        auto begin = std::chrono::steady_clock::now();
+        for (int run = 0; run != nb_runs; ++run)
+        {
+            full = start;
+            Stepper stepper(level);
+            for (const auto &k : edited)
+                stepper.step(full, k.data(), k.size());
+        }
+        std::chrono::duration<double> full_time = std::chrono::steady_clock::now() - begin;
+
+        // every run but the first replays the timeline it logged itself,
+        // the same edit each time
+        State partial;
+        log.reset_stats();
+        begin = std::chrono::steady_clock::now();
+        for (int run = 0; run != nb_runs; ++run)
+        {
+            partial = start;
+            log.resimulate(partial, edited);
+        }
+        std::chrono::duration<double> partial_time = std::chrono::steady_clock::now() - begin;
+
+        const auto &stats = log.stats();
+        double full_rate = nb_runs * nb_ticks / full_time.count();
+        double partial_rate = nb_runs * nb_ticks / partial_time.count();
+        std::printf("%4d  %12.0f  %15.0f  %7.2f  %5.1f%%  %s\n",
+                    work,
+                    full_rate,
+                    partial_rate,
+                    partial_rate / full_rate,
+                    100. * stats.copied_ / (stats.copied_ + stats.executed_),
+                    full.hash() == partial.hash() ? "yes" : "no");
+    }
+    return 0;
+}
@@ -0,0 +1,95 @@
+#include "dependencies.h"
+#include "stepper.h"
+#include "tests/test.h"
+#include "tests/toy_level.h"
+
+#include <memory>
+#include <vector>
+
+using namespace Toy;
+
+namespace
+{
+    using Inputs = std::vector<std::vector<KeyStrokes>>;
+
+    /* start stepped through inputs, on the heap */
+    std::unique_ptr<State> run(const Level &level, const State &start, const Inputs &inputs, DependencyLog *log = nullptr)
+    {
+        auto st = std::make_unique<State>(start);
+        Stepper stepper(level);
+        for (const auto &k : inputs)
+            stepper.step(*st, k.data(), k.size(), log);
+        return st;
+    }
+
+    /* the crowd and a player among the drifts */
+    void edit(uint32_t rng)
+    {
+        World world;
+        const auto &level = world.level_;
+        auto start = World::crowd();
+        start->set(5, World::object(PLAYER, at(60, 60)));
+        start->rng_ = rng;
+        start->rnd_ = 1234;
+
+        Inputs inputs(200, std::vector<KeyStrokes>(State::nb_players_));
+        for (int tick = 20; tick != 80; ++tick)
+            inputs[tick][0].right_ = 1;
+        DependencyLog log(level);
+        auto logged = run(level, *start, inputs, &log);
+
+        // the player goes left for a while instead
+        Inputs edited = inputs;
+        for (int tick = 40; tick != 50; ++tick)
+        {
+            edited[tick][0].right_ = 0;
+            edited[tick][0].left_ = 1;
+        }
+        auto partial = std::make_unique<State>(*start);
+        log.resimulate(*partial, edited, true);
+        CHECK(log.stats().mismatch_ == -1);
+        CHECK(log.stats().copied_ > 0);
+        CHECK(partial->hash() == run(level, *start, edited)->hash());
+
+        // and back, the log holding the edited timeline
+        log.reset_stats();
+        *partial = *start;
+        log.resimulate(*partial, inputs, true);
+        CHECK(log.stats().mismatch_ == -1);
+        CHECK(partial->hash() == logged->hash());
+    }
+
+    /* an edit without lasting effect : once the timelines meet again,
+       everything is copied */
+    void rejoin()
+    {
+        World world;
+        const auto &level = world.level_;
+        auto start = World::crowd();
+        start->set(5, World::object(PLAYER, at(1000, 1000)));
+        start->rng_ = RNG_COUNTER;
+
+        Inputs inputs(200, std::vector<KeyStrokes>(State::nb_players_));
+        DependencyLog log(level);
+        run(level, *start, inputs, &log);
+
+        Inputs edited = inputs;
+        edited[40][0].left_ = 1;
+        edited[41][0].right_ = 1;
+        log.reset_stats();
+        log.resimulate(*start, edited, true);
+        CHECK(log.stats().mismatch_ == -1);
+        // the player alone, woken up by the keys of ticks 40 to 42 until
+        // it falls asleep again, in its two phases
+        CHECK(log.stats().executed_ <= 2 * (State::sleep_ticks_ + 4));
+        CHECK(log.stats().copied_ > 100 * log.stats().executed_);
+    }
+}
+
+int main()
+{
+    edit(RNG_LCG);
+    edit(RNG_COUNTER);
+    rejoin();
+    return failures() != 0;
+}
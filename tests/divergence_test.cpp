@@ -0,0 +1,126 @@
+#include "divergence.h"
+#include "stepper.h"
+#include "tests/test.h"
+#include "tests/toy_level.h"
+
+#include <memory>
+#include <set>
+#include <vector>
+
+using namespace Toy;
+
+namespace
+{
+    using Inputs = std::vector<std::vector<KeyStrokes>>;
+
+    const int nb_ticks = 400;
+    // the edited input, giving the state of tick edit + 1
+    const int edit = 300;
+
+    /* on the heap, as everywhere here : at 64k slots a state does not
+       fit the stack twice */
+    std::unique_ptr<State> start()
+    {
+        auto st = World::crowd();
+        st->set(5, World::object(PLAYER, at(60, 60)));
+        st->rng_ = RNG_COUNTER;
+        return st;
+    }
+
+    Inputs edited()
+    {
+        Inputs inputs(nb_ticks, std::vector<KeyStrokes>(State::nb_players_));
+        inputs[edit][0].left_ = 1;
+        return inputs;
+    }
+
+    std::vector<uint64_t> hashes(const Level &level, std::unique_ptr<State> st, const Inputs &inputs)
+    {
+        std::vector<uint64_t> result{st->hash()};
+        Stepper stepper(level);
+        for (const auto &k : inputs)
+        {
+            stepper.step(*st, k.data(), k.size());
+            result.push_back(st->hash());
+        }
+        return result;
+    }
+
+    /* nothing known : forward together up to the divergence, no further */
+    void forward()
+    {
+        World world;
+        Branch first(world.level_, *start(), Inputs(nb_ticks, std::vector<KeyStrokes>(State::nb_players_)));
+        Branch second(world.level_, *start(), edited());
+
+        auto divergence = bisect(first, second);
+        CHECK(divergence);
+        CHECK(divergence->tick_ == edit + 1);
+        CHECK(divergence->slots_ == std::vector<int>{5});
+        CHECK(divergence->simulated_ == 2 * (edit + 1));
+    }
+
+    /* hashes of a replay past what was simulated : the binary search
+       leaves the ticks after the last one agreeing, stepped from the
+       state simulated last */
+    void known()
+    {
+        World world;
+        Inputs inputs(nb_ticks, std::vector<KeyStrokes>(State::nb_players_));
+        auto first_hashes = hashes(world.level_, start(), inputs);
+        auto second_hashes = hashes(world.level_, start(), edited());
+
+        Branch first(world.level_, *start(), inputs);
+        Branch second(world.level_, *start(), edited());
+        first.state(200);
+        second.state(200);
+        for (int tick = 250; tick <= nb_ticks; tick += 50)
+        {
+            first.set_hash(tick, first_hashes[tick]);
+            second.set_hash(tick, second_hashes[tick]);
+        }
+
+        auto divergence = bisect(first, second);
+        CHECK(divergence);
+        CHECK(divergence->tick_ == edit + 1);
+        CHECK(divergence->simulated_ == 2 * (edit + 1 - 200));
+
+        // once simulated, a second bisection is free
+        divergence = bisect(first, second);
+        CHECK(divergence && divergence->tick_ == edit + 1);
+        CHECK(divergence->simulated_ == 0);
+    }
+
+    void agree()
+    {
+        World world;
+        Inputs inputs(nb_ticks, std::vector<KeyStrokes>(State::nb_players_));
+        Branch first(world.level_, *start(), inputs);
+        Branch second(world.level_, *start(), inputs);
+        CHECK(!bisect(first, second));
+        CHECK(first.simulated() == nb_ticks);
+    }
+
+    /* slots live in only one of the states are compared too */
+    void fields()
+    {
+        auto first = start();
+        auto second = std::make_unique<State>(*first);
+        first->free(3);
+        second->set(250, World::object(PLAYER, at(10, 10)));
+        std::set<int> slots;
+        for (const auto &field : diff(*first, *second))
+            slots.insert(field.slot_);
+        CHECK(slots == std::set<int>({3, 250}));
+        CHECK(diff(*first, *first).empty());
+    }
+}
+
+int main()
+{
+    forward();
+    known();
+    agree();
+    fields();
+    return failures() != 0;
+}
@@ -0,0 +1,80 @@
+#include "data.h"
+#include "tests/test.h"
+
+#include <cmath>
+#include <random>
+
+namespace
+{
+    /* built and checked by the compiler */
+    constexpr Arc line(Point2D(0, 0), Point2D(30, 40), fixed(2));
+    static_assert(line.length_ == 25);
+    static_assert(line.at(0) == Point2D(30, 40));
+    static_assert(line.at(25) == Point2D(0, 0));
+
+    constexpr Arc quarter(Point2D(10, 0), fixed(1), fixed(10), fixed(0), fixed(100));
+    static_assert(quarter.center_ == Point2D(0, 0));
+    static_assert(quarter.p2_ == Point2D(0, 10));
+
+    static_assert(cos(fixed(0)) == 1 && cos(fixed(100)) == 0 && cos(fixed(200)) == -1);
+    static_assert(cos(fixed(-50)) == cos(fixed(50)) && cos(fixed(450)) == cos(fixed(50)));
+    static_assert(sin(fixed16(100)) == 1 && cos(fixed16(300)) == 0);
+    static_assert(hypot(fixed(3), fixed(4)) == 5 && hypot(fixed16(-5), fixed16(12)) == 13);
+    static_assert(sqrt(fixed(49)) == 7 && sqrt(fixed(-1)) == 0);
+    static_assert(atan2(Point2D(1, 0)) == 0 && atan2(Point2D(0, 1)) == 100);
+    static_assert(atan2(Point2D(-1, 0)) == 200 && atan2(Point2D(0, -1)) == 300);
+
+    /* cos against std::cos, between the grads too */
+    template <typename T>
+    void trigonometry()
+    {
+        double worst = 0;
+        for (int i = -800 * 16; i <= 800 * 16; ++i)
+        {
+            T angle = T(i) / 16;
+            double expected = std::cos(angle.to_double() * M_PI / 200);
+            worst = std::max(worst, std::abs(cos(angle).to_double() - expected));
+            worst = std::max(worst, std::abs(hypot(expj(angle)).to_double() - 1));
+        }
+        CHECK(worst < 0.004);
+    }
+
+    /* the angle found points along the vector, the norm is the floor of
+       the exact one even for the largest raw values */
+    void inverse()
+    {
+        std::mt19937 rng(1);
+        int misses = 0;
+        for (int i = 0; i != 20000; ++i)
+        {
+            Point2D vect(fixed(int32_t(rng() % 2001) - 1000, fixed::raw) * 64,
+                         fixed(int32_t(rng() % 2001) - 1000, fixed::raw) * 64);
+            if (vect == Point2D())
+                continue;
+            fixed angle = atan2(vect);
+            double expected = std::atan2(vect.imag().to_double(), vect.real().to_double()) * 200 / M_PI;
+            if (expected < 0)
+                expected += 400;
+            double error = std::abs(angle.to_double() - expected);
+            if (std::min(error, 400 - error) > 0.3 || angle < 0 || angle >= 400)
+                misses++;
+        }
+        CHECK(misses == 0);
+
+        fixed low(INT32_MIN, fixed::raw);
+        fixed high(INT32_MAX, fixed::raw);
+        CHECK(hypot(low, fixed(0)).value_ == int32_t(INT32_MIN));
+        CHECK(hypot(high, fixed(0)) == high);
+        CHECK(hypot(fixed(0), fixed(-30000)) == 30000);
+        fixed16 big(int32_t(1) << 29, fixed16::raw);
+        CHECK(hypot(big, big).value_ == int32_t(std::floor(std::sqrt(2.) * (1 << 29))));
+    }
+}
+
+int main()
+{
+    trigonometry<fixed>();
+    trigonometry<fixed16>();
+    inverse();
+    return failures() != 0;
+}
@@ -0,0 +1,27 @@
+#include "tests/toy_level.h"
+
+#include <cstdio>
+
+using namespace Toy;
+
+/* bytes of the animations of the toy level, against the table of 256
+   animations each holding its frames by value it replaced, and the
+   frames shared */
+int main()
+{
+    World world;
+    auto &frames = world.level_.frames();
+    const auto &graphic = *world.graphic_;
+
+    // one graphic of one animation of one frame
+    size_t table = NUMBER_ANIMATIONS * sizeof(AnimationData) + sizeof(FrameData);
+    size_t now = graphic.bytes() + frames.bytes();
+    std::printf("frames asked  frames kept  table B  now B  ratio\n");
+    std::printf("%12zu  %11zu  %7zu  %5zu  %5.1f\n",
+                frames.requests(),
+                frames.size(),
+                table,
+                now,
+                double(table) / now);
+    return 0;
+}
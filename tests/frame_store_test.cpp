@@ -0,0 +1,145 @@
+#include "objectdata.h"
+#include "tests/test.h"
+
+#include <vector>
+
+using namespace ObjData;
+
+/* FrameStore::intern sharing frames of the same pixels wherever they
+   lie, and FrameStore::compact keeping the pixels of every frame */
+namespace
+{
+    Image blank(int w, int h)
+    {
+        Image image;
+        image.w_ = image.stride_ = w;
+        image.h_ = h;
+        image.content_.assign(w * h, Pixel{});
+        return image;
+    }
+
+    /* a pattern of w x h pixels drawn from seed, at (x, y) */
+    void draw(Image &image, int x, int y, int w, int h, int seed)
+    {
+        for (int j = 0; j != h; ++j)
+            for (int i = 0; i != w; ++i)
+            {
+                uint8_t v = seed * 31 + i * 7 + j * 13;
+                image.content_[x + i + (y + j) * image.stride_] = Pixel{v, uint8_t(v + 1), uint8_t(v + 2), 255, uint32_t(seed), uint8_t(j)};
+            }
+    }
+
+    FrameData frame(Image &image, int x, int y, int w, int h)
+    {
+        FrameData result{Sprite(&image, 0, {{x, y}, {x + w - 1, y + h - 1}}), {}};
+        result.spots_.fill(Point2D(fixed(w / 2), fixed(h / 2)));
+        return result;
+    }
+
+    /* the pixels of the frame's rectangle, row after row */
+    std::vector<uint64_t> pixels(const FrameData &frame)
+    {
+        std::vector<uint64_t> result;
+        const auto &[first, second] = frame.sprite_.coor_;
+        const auto &image = *frame.sprite_.image_;
+        for (int y = first.imag(); y <= second.imag(); ++y)
+            for (int x = first.real(); x <= second.real(); ++x)
+            {
+                const auto &p = image.content_[x + y * image.stride_];
+                result.push_back(p.r_ | p.g_ << 8 | p.b_ << 16 | uint64_t(p.a_) << 24 | uint64_t(p.masks_) << 32 | uint64_t(p.depth_) << 56);
+            }
+        return result;
+    }
+
+    void intern()
+    {
+        Image image = blank(32, 32);
+        draw(image, 2, 2, 4, 3, 1);
+        draw(image, 20, 10, 4, 3, 1);
+        draw(image, 10, 20, 4, 3, 2);
+        Image other = blank(8, 8);
+        draw(other, 1, 1, 4, 3, 1);
+
+        FrameStore store;
+        const FrameData *first = store.intern(frame(image, 2, 2, 4, 3));
+        CHECK(store.intern(frame(image, 20, 10, 4, 3)) == first);
+        CHECK(store.intern(frame(other, 1, 1, 4, 3)) == first);
+        CHECK(store.size() == 1);
+
+        // other pixels, another size, other spots
+        CHECK(store.intern(frame(image, 10, 20, 4, 3)) != first);
+        CHECK(store.intern(frame(image, 2, 2, 3, 3)) != first);
+        auto moved = frame(image, 20, 10, 4, 3);
+        moved.spots_[0] = Point2D(fixed(0), fixed(0));
+        CHECK(store.intern(moved) != first);
+        CHECK(store.size() == 4);
+        CHECK(store.requests() == 6);
+
+        // a rectangle out of its image is only itself
+        const FrameData *out = store.intern(frame(image, 30, 30, 4, 4));
+        CHECK(out != first);
+        CHECK(store.intern(frame(image, 30, 30, 4, 4)) == out);
+        CHECK(store.intern(frame(image, 29, 30, 4, 4)) != out);
+    }
+
+    void compact()
+    {
+        Image image = blank(64, 256);
+        FrameStore store;
+        std::vector<const FrameData *> frames;
+        for (int i = 0; i != 8; ++i)
+        {
+            int w = 5 + i * 3;
+            int h = 4 + (i * 5) % 11;
+            int x = (i * 17) % (64 - w);
+            int y = i * 30;
+            draw(image, x, y, w, h, i + 1);
+            frames.push_back(store.intern(frame(image, x, y, w, h)));
+            // overlapping the previous one
+            frames.push_back(store.intern(frame(image, x + 1, y + 1, w - 2, h - 2)));
+        }
+        CHECK(store.size() == frames.size());
+
+        std::vector<std::vector<uint64_t>> before;
+        for (auto f : frames)
+            before.push_back(pixels(*f));
+        store.compact(image);
+        CHECK(image.h_ < 256);
+        CHECK(int(image.content_.size()) == image.w_ * image.h_);
+        for (size_t i = 0; i != frames.size(); ++i)
+        {
+            const auto &[first, second] = frames[i]->sprite_.coor_;
+            CHECK(frames[i]->sprite_.image_ == &image);
+            CHECK(first.real() >= 0 && first.imag() >= 0);
+            CHECK(second.real() < image.w_ && second.imag() < image.h_);
+            CHECK(pixels(*frames[i]) == before[i]);
+        }
+
+        // the frames are found again at their new place
+        CHECK(store.intern(*frames[3]) == frames[3]);
+        CHECK(store.size() == frames.size());
+    }
+
+    /* a frame out of its image leaves the image alone */
+    void compact_out()
+    {
+        Image image = blank(16, 64);
+        draw(image, 0, 40, 4, 4, 1);
+        FrameStore store;
+        const FrameData *in = store.intern(frame(image, 0, 40, 4, 4));
+        store.intern(frame(image, 14, 62, 4, 4));
+        auto before = pixels(*in);
+        store.compact(image);
+        CHECK(image.h_ == 64);
+        CHECK(in->sprite_.coor_.first == IPoint2D(0, 40));
+        CHECK(pixels(*in) == before);
+    }
+}
+
+int main()
+{
+    intern();
+    compact();
+    compact_out();
+    return failures() != 0;
+}
@@ -0,0 +1,88 @@
+#include "journal.h"
+#include "tests/toy_level.h"
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+using namespace Toy;
+
+/* The crowd over 600 ticks : ticks per second stepping with and without
+   the journal, then stepping back from the last tick to the 300th one
+   tick at a time, undoing the journal against restoring a checkpoint
+   taken every n ticks and stepping again up to the tick before. Also
+   the bytes kept per tick either way */
+int main()
+{
+    const int nb_ticks = 600;
+    const int target = 300;
+    World world;
+    const auto &level = world.level_;
+    std::vector<KeyStrokes> no_keys(State::nb_players_);
+    using Clock = std::chrono::steady_clock;
+    auto since = [](Clock::time_point start)
+    {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    };
+
+    const State start = *World::crowd();
+    State plain = start;
+    State reached;
+    Stepper stepper(level);
+    auto begin = Clock::now();
+    for (int tick = 0; tick != nb_ticks; ++tick)
+    {
+        if (tick == target)
+            reached = plain;
+        stepper.step(plain, no_keys.data(), no_keys.size());
+    }
+    double plain_time = since(begin);
+
+    State st = start;
+    UndoHistory history(level, nb_ticks);
+    begin = Clock::now();
+    for (int tick = 0; tick != nb_ticks; ++tick)
+        history.step(st, no_keys.data(), no_keys.size());
+    double journal_time = since(begin);
+    double journal_bytes = double(history.size()) / nb_ticks;
+    std::printf("step ticks/s %.0f, with the journal %.0f\n\n", nb_ticks / plain_time, nb_ticks / journal_time);
+
+    std::printf("step back        us/tick  B kept/tick  same\n");
+    begin = Clock::now();
+    for (int tick = nb_ticks; tick != target; --tick)
+        history.step_back(st);
+    double undo_time = since(begin);
+    std::printf("journal         %8.2f  %11.0f  %s\n",
+                1e6 * undo_time / (nb_ticks - target),
+                journal_bytes,
+                st.same(reached) ? "yes" : "no");
+
+    for (int every : {1, 10, 60})
+    {
+        std::vector<State> checkpoints;
+        State replayed = start;
+        Stepper forward(level);
+        for (int tick = 0; tick != nb_ticks; ++tick)
+        {
+            if (tick % every == 0)
+                checkpoints.push_back(replayed);
+            forward.step(replayed, no_keys.data(), no_keys.size());
+        }
+        begin = Clock::now();
+        for (int tick = nb_ticks - 1; tick != target - 1; --tick)
+        {
+            replayed = checkpoints[tick / every];
+            for (int i = tick / every * every; i != tick; ++i)
+                forward.step(replayed, no_keys.data(), no_keys.size());
+        }
+        double restore_time = since(begin);
+        char name[32];
+        std::snprintf(name, sizeof(name), "checkpoint / %d", every);
+        std::printf("%-15s %8.2f  %11.0f  %s\n",
+                    name,
+                    1e6 * restore_time / (nb_ticks - target),
+                    double(sizeof(State)) / every,
+                    replayed.same(reached) ? "yes" : "no");
+    }
+    return 0;
+}
@@ -0,0 +1,82 @@
+#include "journal.h"
+#include "tests/test.h"
+#include "tests/toy_level.h"
+#include "thread_pool.h"
+
+#include <vector>
+
+using namespace Toy;
+
+namespace
+{
+    std::vector<KeyStrokes> no_keys(State::nb_players_);
+
+    /* stepping back goes through the very states stepping went through,
+       spawns and frees included, and stepping again from there too */
+    void round_trip(uint32_t rng, ThreadPool *pool)
+    {
+        World world;
+        const int nb_ticks = 100;
+        State st = *World::crowd();
+        st.rng_ = rng;
+        UndoHistory history(world.level_, nb_ticks, pool);
+
+        std::vector<State> states{st};
+        for (int tick = 0; tick != nb_ticks; ++tick)
+        {
+            history.step(st, no_keys.data(), no_keys.size());
+            states.push_back(st);
+        }
+        CHECK(history.depth() == nb_ticks);
+        CHECK(st.nb_live() != states.front().nb_live());
+
+        for (int tick = nb_ticks; tick != nb_ticks / 2; --tick)
+        {
+            CHECK(history.step_back(st));
+            CHECK(st.same(states[tick - 1]));
+            CHECK(st.hash() == states[tick - 1].hash());
+        }
+        for (int tick = nb_ticks / 2; tick != nb_ticks; ++tick)
+        {
+            history.step(st, no_keys.data(), no_keys.size());
+            CHECK(st.same(states[tick + 1]));
+        }
+        while (history.step_back(st))
+            ;
+        CHECK(st.same(states.front()));
+    }
+
+    /* only the last ticks are kept */
+    void depth()
+    {
+        World world;
+        State st = *World::crowd();
+        UndoHistory history(world.level_, 10);
+        std::vector<State> states{st};
+        for (int tick = 0; tick != 30; ++tick)
+        {
+            history.step(st, no_keys.data(), no_keys.size());
+            states.push_back(st);
+        }
+        CHECK(history.depth() == 10);
+        for (int tick = 30; tick != 20; --tick)
+            CHECK(history.step_back(st));
+        CHECK(!history.step_back(st));
+        CHECK(st.same(states[20]));
+
+        UndoHistory none(world.level_, 0);
+        none.step(st, no_keys.data(), no_keys.size());
+        CHECK(none.depth() == 0);
+        CHECK(st.same(states[21]));
+    }
+}
+
+int main()
+{
+    ThreadPool pool(4);
+    round_trip(RNG_LCG, nullptr);
+    round_trip(RNG_COUNTER, nullptr);
+    round_trip(RNG_COUNTER, &pool);
+    depth();
+    return failures() != 0;
+}
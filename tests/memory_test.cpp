@@ -0,0 +1,60 @@
+#include "memory.h"
+#include "speculation.h"
+#include "stepper.h"
+#include "tests/test.h"
+#include "tests/toy_level.h"
+#include "thread_pool.h"
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace Toy;
+
+/* memory_test [csv] : steps the crowd with a monitor, headless, and
+   keeps the time series in csv if given */
+int main(int argc, char **argv)
+{
+    std::string path = argc > 1 ? argv[1] : "memory_test.csv";
+    std::vector<KeyStrokes> no_keys(State::nb_players_);
+    World world;
+    ThreadPool pool(2);
+    MemoryMonitor monitor(true);
+
+    State st = *World::crowd();
+    const int nb_ticks = 100;
+    {
+        Speculator speculator(world.level_, pool, 64, 0, &monitor);
+        Stepper stepper(world.level_, &pool);
+        stepper.monitor(&monitor);
+        for (int tick = 0; tick != nb_ticks; ++tick)
+        {
+            State speculated = st;
+            speculator.compute(speculated, no_keys);
+            stepper.step(st, no_keys.data(), no_keys.size());
+        }
+
+        // events, pairs and block copies
+        CHECK(monitor.stats(MEMORY_TICK).current_ > 0);
+        CHECK(monitor.stats(MEMORY_TICK).peak_ >= monitor.stats(MEMORY_TICK).current_);
+        // frames, animations and pixels
+        CHECK(monitor.stats(MEMORY_ASSETS).current_ > 0);
+        // the speculator's states, at least one per tick
+        CHECK(monitor.stats(MEMORY_CACHES).current_ >= int64_t(64 * sizeof(State)));
+    }
+
+    // the probe went away with the speculator
+    monitor.sample(st.timestamp_ + 1);
+    CHECK(monitor.stats(MEMORY_CACHES).current_ == 0);
+    CHECK(monitor.stats(MEMORY_CACHES).peak_ >= int64_t(64 * sizeof(State)));
+
+    CHECK(monitor.write_csv(path));
+    std::ifstream csv(path);
+    std::string line;
+    int lines = 0;
+    while (std::getline(csv, line))
+        lines++;
+    // a header, a row per tick and the last sample
+    CHECK(lines == nb_ticks + 2);
+    return failures() != 0;
+}
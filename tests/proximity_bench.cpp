@@ -0,0 +1,119 @@
+#include "proximity.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+/* queries per second of n seekers, 1000 by default, looking for the
+   nearest objects and those within a short and a wide radius among a
+   full state, with the index then scanning every slot as before it. A
+   State holds nb_slots_ objects : the seekers are query points among
+   them */
+int main(int argc, char **argv)
+{
+    int nb_seekers = argc > 1 ? std::atoi(argv[1]) : 1000;
+    const int nb_rounds = 200, nb_types = 4, k = 4;
+
+    std::mt19937 rng(1);
+    State st;
+    st.clear();
+    for (int slot = 0; slot != State::nb_slots_; ++slot)
+    {
+        StateObject so{};
+        so.type_ = slot % nb_types;
+        so.pos_ = {fixed(int(rng() % 4000)), fixed(int(rng() % 2000))};
+        st.set(slot, so);
+    }
+    std::vector<IPoint2D> seekers;
+    for (int i = 0; i != nb_seekers; ++i)
+        seekers.emplace_back(int(rng() % 4000), int(rng() % 2000));
+
+    ProximityIndex index;
+    index.update(st);
+    std::vector<int> result;
+
+    auto measure = [&](auto query)
+    {
+        // the slots found, in order
+        size_t found = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int round = 0; round != nb_rounds; ++round)
+        {
+            for (int i = 0; i != nb_seekers; ++i)
+            {
+                result.clear();
+                query(i % nb_types, seekers[i]);
+                for (int slot : result)
+                    found = found * 31 + slot + 1;
+            }
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        return std::make_pair(nb_rounds * nb_seekers / elapsed.count(), found);
+    };
+
+    auto distance = [&](int slot, IPoint2D center)
+    {
+        int64_t dx = st.slots_[slot].pos_.real().roundin() - int64_t(center.real());
+        int64_t dy = st.slots_[slot].pos_.imag().roundin() - int64_t(center.imag());
+        return dx * dx + dy * dy;
+    };
+
+    std::printf("query        indexed/s  scanned/s  speedup  same\n");
+    auto print = [](const char *name, std::pair<double, size_t> indexed, std::pair<double, size_t> scanned)
+    {
+        std::printf("%-11s %10.0f %10.0f  %7.2f  %s\n",
+                    name, indexed.first, scanned.first, indexed.first / scanned.first,
+                    indexed.second == scanned.second ? "yes" : "no");
+    };
+
+    for (int64_t radius : {64, 300})
+    {
+        auto indexed = measure([&](int type, IPoint2D center)
+        {
+            index.radius(type, center, radius, result);
+        });
+        auto scanned = measure([&](int type, IPoint2D center)
+        {
+            for (int slot = 0; slot != State::nb_slots_; ++slot)
+                if (st.live(slot) && st.slots_[slot].type_ == type && distance(slot, center) <= radius * radius)
+                    result.push_back(slot);
+        });
+        char name[32];
+        std::snprintf(name, sizeof(name), "radius %d", int(radius));
+        print(name, indexed, scanned);
+    }
+
+    std::vector<std::pair<int64_t, int>> candidates;
+    auto indexed = measure([&](int type, IPoint2D center)
+    {
+        index.nearest(type, center, k, result);
+    });
+    auto scanned = measure([&](int type, IPoint2D center)
+    {
+        candidates.clear();
+        for (int slot = 0; slot != State::nb_slots_; ++slot)
+            if (st.live(slot) && st.slots_[slot].type_ == type)
+                candidates.emplace_back(distance(slot, center), slot);
+        std::partial_sort(candidates.begin(), candidates.begin() + k, candidates.end());
+        for (int i = 0; i != k; ++i)
+            result.push_back(candidates[i].second);
+    });
+    print("nearest 4", indexed, scanned);
+
+    // a tick moving a tenth of the objects
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round != nb_rounds; ++round)
+    {
+        for (int slot = round % 10; slot < State::nb_slots_; slot += 10)
+            st.slots_[slot].pos_ += Point2D(fixed(int(rng() % 65) - 32), 0);
+        for (int slot = round % 10; slot < State::nb_slots_; slot += 10)
+            index.update(st, slot);
+    }
+    std::chrono::duration<double> updates = std::chrono::steady_clock::now() - start;
+
+    std::printf("updates of a tenth of the slots : %.0f/s\n", nb_rounds / updates.count());
+    return 0;
+}
@@ -0,0 +1,64 @@
+#include "rasterizer.h"
+#include "thread_pool.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace ObjData;
+
+/* frames per second of a 1920x1080 render list of n 64x64 translucent
+   sprites, 2000 by default, without a pool then with 1 to N threads, N
+   being the number of cores unless given, for a few tile sizes */
+int main(int argc, char **argv)
+{
+    int max_threads = argc > 1 ? std::atoi(argv[1]) : std::thread::hardware_concurrency();
+    int nb_sprites = argc > 2 ? std::atoi(argv[2]) : 2000;
+    const int w = 1920, h = 1080, nb_frames = 30;
+
+    Image image;
+    image.w_ = image.h_ = image.stride_ = 64;
+    image.content_.resize(64 * 64);
+    for (int y = 0; y != 64; ++y)
+        for (int x = 0; x != 64; ++x)
+            image.content_[x + y * 64] = {uint8_t(x * 4), uint8_t(y * 4), 128,
+                                          uint8_t(x < 32 ? 255 : 160), 0, uint8_t(y / 16)};
+    FrameData frame{Sprite(&image, 0, {{0, 0}, {63, 63}}), {}};
+
+    std::mt19937 rng(1);
+    std::vector<SpriteInstance> sis;
+    for (int i = 0; i != nb_sprites; ++i)
+    {
+        Point2D coor{fixed(int(rng() % (w + 64)) - 64), fixed(int(rng() % (h + 64)) - 64)};
+        sis.push_back({&frame, coor, int(rng() % 4), i, {}, false, i});
+    }
+
+    auto measure = [&](ThreadPool *pool, int tile_size)
+    {
+        Rasterizer rasterizer(w, h, pool, tile_size);
+        double best = 0;
+        for (int i = 0; i != nb_frames; ++i)
+        {
+            rasterizer.render(sis, {});
+            best = std::max(best, rasterizer.frames_per_second());
+        }
+        return std::make_pair(best, rasterizer.framebuffer().color_);
+    };
+
+    auto [reference, color] = measure(nullptr, 64);
+    std::printf("threads  tile  frames/s  speedup  same\n");
+    std::printf("      -    64  %8.1f     1.00  yes\n", reference);
+    for (int nb_threads = 1; nb_threads <= std::max(max_threads, 1); ++nb_threads)
+    {
+        ThreadPool pool(nb_threads);
+        for (int tile_size : {32, 64, 128})
+        {
+            auto [fps, result] = measure(&pool, tile_size);
+            std::printf("%7d  %4d  %8.1f  %7.2f  %s\n",
+                        nb_threads, tile_size, fps, fps / reference, result == color ? "yes" : "no");
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,200 @@
+#include "rasterizer.h"
+#include "tests/test.h"
+#include "thread_pool.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+using namespace ObjData;
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    Point2D at(int x, int y)
+    {
+        return {fixed(x), fixed(y)};
+    }
+
+    Pixel pixel(int r, int g, int b, int a, int depth)
+    {
+        return {uint8_t(r), uint8_t(g), uint8_t(b), uint8_t(a), 0, uint8_t(depth)};
+    }
+
+    /* the colour bytes blend_pixel leaves over dst */
+    uint32_t over(const Pixel &src, uint32_t dst)
+    {
+        uint32_t s;
+        std::memcpy(&s, &src, sizeof(s));
+        uint32_t result = 0;
+        for (int shift = 0; shift != 32; shift += 8)
+        {
+            uint32_t x = ((s >> shift) & 255) * src.a_ + ((dst >> shift) & 255) * (255 - src.a_) + 128;
+            result |= ((x + (x >> 8)) >> 8) << shift;
+        }
+        return result;
+    }
+
+    uint32_t rgba(const Pixel &pixel)
+    {
+        uint32_t result;
+        std::memcpy(&result, &pixel, sizeof(result));
+        return result;
+    }
+
+    /* two images whose sprites are cut away from their corner : a
+       translucent gradient, deeper in its lower half, and an opaque
+       stripe. The widths are not multiples of 4 */
+    struct Scene
+    {
+        Image gradient_, stripe_;
+        std::vector<FrameData> frames_;
+
+        Scene()
+        {
+            gradient_.w_ = 25;
+            gradient_.h_ = 17;
+            gradient_.stride_ = 27;
+            gradient_.content_.resize(gradient_.stride_ * gradient_.h_);
+            for (int y = 0; y != gradient_.h_; ++y)
+                for (int x = 0; x != gradient_.stride_; ++x)
+                    gradient_.content_[x + y * gradient_.stride_]
+                        = pixel(x * 10, y * 15, 200 - x * 7, std::min(255, 40 + x * 11), y < 8 ? 1 : 3);
+
+            stripe_.w_ = stripe_.stride_ = 9;
+            stripe_.h_ = 40;
+            stripe_.content_.resize(stripe_.stride_ * stripe_.h_);
+            for (int y = 0; y != stripe_.h_; ++y)
+                for (int x = 0; x != stripe_.w_; ++x)
+                    stripe_.content_[x + y * stripe_.stride_] = pixel(250, y * 6, x * 25, 255, 2);
+
+            frames_.reserve(3);
+            frames_.push_back({Sprite(&gradient_, 0, {{2, 1}, {24, 16}}), {}});
+            frames_.push_back({Sprite(&stripe_, 1, {{0, 3}, {8, 39}}), {}});
+            frames_.push_back({Sprite(&gradient_, 0, {{0, 0}, {10, 5}}), {}});
+        }
+
+        SpriteInstance instance(int frame, Point2D coor, int order, int id, Point2D parallax = {}) const
+        {
+            return {&frames_[frame], coor, order, id, parallax, parallax != Point2D{}, id};
+        }
+
+        /* overlapping, across tiles and borders, equal orders told
+           apart by id, one with parallax */
+        std::vector<SpriteInstance> instances() const
+        {
+            return {instance(0, at(3, 4), 0, 5),
+                    instance(1, at(12, -10), 1, 2),
+                    instance(0, at(20, 10), 1, 1),
+                    instance(2, at(15, 12), 2, 7),
+                    instance(1, at(60, 30), 0, 3),
+                    instance(0, at(55, 38), 2, 4),
+                    instance(0, at(90, 60), 3, 6),
+                    instance(2, at(-4, 50), 0, 8),
+                    instance(1, at(30, 20), 1, 9, at(1, 0)),
+                    instance(2, at(40, 0), 2, 10)};
+        }
+    };
+
+    std::string contents(const fs::path &path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+    }
+
+    /* one opaque row, then translucent rows over it at a depth above,
+       equal and below */
+    void blend()
+    {
+        Image image;
+        image.w_ = image.stride_ = 7;
+        image.h_ = 4;
+        image.content_.resize(7 * 4);
+        for (int x = 0; x != 7; ++x)
+        {
+            image.content_[x] = pixel(10, 20, 200, 255, 2);
+            image.content_[x + 7] = pixel(250, 30 * x, 0, 128, 3);
+            image.content_[x + 14] = pixel(0, 255, 0, 90, 2);
+            image.content_[x + 21] = pixel(255, 255, 255, 255, 1);
+        }
+        std::vector<FrameData> frames;
+        for (int row = 0; row != 4; ++row)
+            frames.push_back({Sprite(&image, 0, {{0, row}, {6, row}}), {}});
+
+        std::vector<SpriteInstance> sis;
+        for (int row = 0; row != 4; ++row)
+            sis.push_back({&frames[row], at(1, 0), row, row, {}, false, row});
+        Rasterizer rasterizer(9, 1);
+        rasterizer.render(sis, {});
+
+        const auto &fb = rasterizer.framebuffer();
+        CHECK(fb.color_[0] == 0 && fb.color_[8] == 0);
+        for (int x = 0; x != 7; ++x)
+        {
+            uint32_t expected = over(image.content_[x + 14],
+                                     over(image.content_[x + 7], rgba(image.content_[x])));
+            CHECK(fb.color_[x + 1] == expected);
+            // the translucent rows leave the depth of the opaque one
+            CHECK(fb.depth_[x + 1] == 2);
+        }
+    }
+
+    /* the same image whatever the pool and the tiles, and the one
+       checked in */
+    void golden(const fs::path &dir, bool update)
+    {
+        Scene scene;
+        struct Case
+        {
+            const char *name_;
+            Point2D camera_;
+        };
+        for (auto c : {Case{"rasterizer_origin", {}}, Case{"rasterizer_camera", at(7, -5)}})
+        {
+            Rasterizer reference(100, 70);
+            reference.render(scene.instances(), c.camera_);
+            const auto &expected = reference.framebuffer();
+
+            ThreadPool pool(3);
+            for (auto [p, tile_size] : {std::make_pair(static_cast<ThreadPool *>(nullptr), 7),
+                                        std::make_pair(&pool, 1),
+                                        std::make_pair(&pool, 16),
+                                        std::make_pair(&pool, 1000)})
+            {
+                Rasterizer rasterizer(100, 70, p, tile_size);
+                rasterizer.render(scene.instances(), c.camera_);
+                CHECK(rasterizer.framebuffer().color_ == expected.color_);
+                CHECK(rasterizer.framebuffer().depth_ == expected.depth_);
+            }
+
+            auto path = dir / (std::string(c.name_) + ".pam");
+            if (update)
+            {
+                CHECK(expected.write(path.string()));
+                continue;
+            }
+            auto rendered = fs::temp_directory_path() / (std::string(c.name_) + ".pam");
+            CHECK(expected.write(rendered.string()));
+            auto golden = contents(path);
+            CHECK(!golden.empty());
+            CHECK(contents(rendered) == golden);
+            fs::remove(rendered);
+        }
+    }
+}
+
+/* rasterizer_test [--update] [dir] : compares with the goldens of dir,
+   tests/golden by default, or writes them again */
+int main(int argc, char **argv)
+{
+    bool update = argc > 1 && std::strcmp(argv[1], "--update") == 0;
+    fs::path dir = argc > 1 + update ? argv[1 + update] : "tests/golden";
+    blend();
+    golden(dir, update);
+    return failures() != 0;
+}
@@ -0,0 +1,99 @@
+#include "rollback.h"
+#include "stepper.h"
+#include "tests/test.h"
+#include "tests/toy_level.h"
+
+#include <memory>
+#include <vector>
+
+using namespace Toy;
+
+namespace
+{
+    /* hands over what the test queues, once */
+    class Queued : public Transport
+    {
+    public:
+        std::vector<InputMessage> queued_;
+
+        void send(const InputMessage &) override
+        {
+        }
+
+        std::vector<InputMessage> receive() override
+        {
+            return std::move(queued_);
+        }
+    };
+
+    KeyStrokes right()
+    {
+        KeyStrokes keys{};
+        keys.right_ = 1;
+        return keys;
+    }
+
+    /* a remote input older than the start changes nothing, however
+       close to it and whatever the start tick */
+    void before_start()
+    {
+        World world;
+        for (int32_t start : {0, 3})
+        {
+            auto st = std::make_unique<State>();
+            st->clear();
+            st->set(0, World::object(PLAYER, at(0, 0)));
+            st->set(1, World::object(PLAYER, at(100, 0)));
+            st->timestamp_ = start;
+
+            Queued transport;
+            RollbackSession session(world.level_, transport, 0, 8, *st);
+            Stepper stepper(world.level_);
+            std::vector<KeyStrokes> no_keys(State::nb_players_);
+            for (int tick = 0; tick != 4; ++tick)
+            {
+                transport.queued_.push_back({start - 1 - tick, 1, right()});
+                session.advance({});
+                stepper.step(*st, no_keys.data(), no_keys.size());
+            }
+            CHECK(session.rollbacks() == 0);
+            CHECK(!session.desynced());
+            CHECK(session.state().hash() == st->hash());
+        }
+    }
+
+    /* two sessions a few frames apart agree once the inputs settle */
+    void loopback()
+    {
+        World world;
+        auto st = std::make_unique<State>();
+        st->clear();
+        st->set(0, World::object(PLAYER, at(0, 0)));
+        st->timestamp_ = 5;
+
+        auto [first, second] = LoopbackTransport::pair(3);
+        RollbackSession a(world.level_, *first, 0, 8, *st);
+        RollbackSession b(world.level_, *second, 1, 8, *st);
+        for (int tick = 0; tick != 40; ++tick)
+        {
+            a.advance(tick % 10 < 5 ? right() : KeyStrokes{});
+            b.advance({});
+        }
+        for (int tick = 0; tick != 10; ++tick)
+        {
+            a.advance({});
+            b.advance({});
+        }
+        CHECK(b.rollbacks() > 0);
+        CHECK(!a.desynced() && !b.desynced());
+        CHECK(a.state().hash() == b.state().hash());
+        CHECK(a.state().slots_[0].pos_ == at(3 * 20, 0));
+    }
+}
+
+int main()
+{
+    before_start();
+    loopback();
+    return failures() != 0;
+}
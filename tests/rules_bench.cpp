@@ -0,0 +1,59 @@
+#include "proximity.h"
+#include "rules.h"
+#include "objectdata.h"
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/* runs per second of a few rules over 64 subjects and 128 objects
+   spread over 2048 x 2048 pixels */
+int main()
+{
+    Rules::Names names;
+    names.types_ = {{"hero", 0}, {"coin", 1}};
+    names.vars_ = {{"score", 3}};
+    const char *sources[] = {
+        "Lambda(Every(hero), Every(coin), Near(100), Set(score, '+1'))",
+        "Lambda(Every(hero), Every(coin), And(Less(X, 1000), Equals(OState, 0)), Set(VX, 1))",
+        "Lambda(Every(hero), All(), Less(X, 0), Set(X, '+5'))",
+        "Touch(Every(hero), Every(coin), 'target', Set(State, 1))",
+    };
+
+    State st;
+    st.clear();
+    uint32_t seed = 1;
+    auto next = [&seed]() { return (seed = seed * 22695477 + 1) >> 16 & 2047; };
+    for (int slot = 0; slot != 192; ++slot)
+    {
+        StateObject so{};
+        so.type_ = slot < 64 ? 0 : 1;
+        so.pos_ = Point2D(fixed(int32_t(next())), fixed(int32_t(next())));
+        st.set(slot, so);
+    }
+    std::vector<ObjData::CollisionEvts> evts(State::nb_slots_);
+    Rules::Slots slots;
+    slots.build(st);
+    ProximityIndex near;
+
+    for (const char *source : sources)
+    {
+        Rules::Rule rule;
+        std::string error;
+        if (!Rules::compile(source, names, rule, error))
+        {
+            std::printf("%s : %s\n", source, error.c_str());
+            return 1;
+        }
+        const int nb_runs = 20000;
+        State copy = st;
+        near.update(copy);
+        auto start = std::chrono::steady_clock::now();
+        for (int run = 0; run != nb_runs; ++run)
+            Rules::run(rule, copy, evts, slots, near);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        std::printf("%9.0f rules/s  %s\n", nb_runs / elapsed.count(), source);
+    }
+    return 0;
+}
@@ -0,0 +1,132 @@
+#include "proximity.h"
+#include "rules.h"
+#include "tests/test.h"
+#include "objectdata.h"
+
+#include <string>
+#include <vector>
+
+namespace
+{
+    StateObject object(int type, int x)
+    {
+        StateObject so{};
+        so.type_ = type;
+        so.pos_ = Point2D(fixed(x), fixed(0));
+        return so;
+    }
+
+    Rules::Names names()
+    {
+        Rules::Names result;
+        result.types_ = {{"hero", 0}, {"coin", 1}};
+        result.vars_ = {{"score", 3}};
+        return result;
+    }
+
+    /* the rule run once on a subject at x = 90 among five coins, returns
+       the subject's x */
+    int run(const std::string &source, State &st)
+    {
+        Rules::Rule rule;
+        std::string error;
+        CHECK(Rules::compile(source, names(), rule, error));
+
+        st.clear();
+        st.set(0, object(0, 90));
+        for (int slot = 1; slot <= 5; ++slot)
+            st.set(slot, object(1, 200 + slot));
+        std::vector<ObjData::CollisionEvts> evts(State::nb_slots_);
+        Rules::Slots slots;
+        slots.build(st);
+        ProximityIndex near;
+        near.update(st);
+        Rules::run(rule, st, evts, slots, near);
+        return st.slots_[0].pos_.real().roundin();
+    }
+
+    /* a condition on a field the effect writes is checked for every pair */
+    void written_field()
+    {
+        State st;
+        CHECK(run("Lambda(Every(hero), Every(coin), Less(X, 100), Set(X, '+5'))", st) == 100);
+        // still hoisted when the effect leaves the field alone
+        CHECK(run("Lambda(Every(hero), Every(coin), Less(X, 100), Set(Y, '+5'))", st) == 90);
+        CHECK(st.slots_[0].pos_.imag().roundin() == 25);
+
+        Rules::Rule rule;
+        std::string error;
+        CHECK(Rules::compile("Lambda(Every(hero), Every(coin), Less(X, 100), Set(X, '+5'))", names(), rule, error));
+        CHECK(rule.subject_.empty());
+        CHECK(Rules::compile("Lambda(Every(hero), Every(coin), Less(X, 100), Set(VX, 1))", names(), rule, error));
+        CHECK(!rule.subject_.empty());
+    }
+
+    void written_var()
+    {
+        State st;
+        run("Lambda(Every(hero), Every(coin), Less(score, 2), Set(score, '+1'))", st);
+        CHECK(st.var_[3] == 2);
+    }
+
+    /* a relative Set moves by whole pixels, the fraction staying */
+    void subpixel()
+    {
+        Rules::Rule rule;
+        std::string error;
+        CHECK(Rules::compile("Lambda(Every(hero), Every(coin), Less(X, 100), Set(X, '+5'))", names(), rule, error));
+
+        State st;
+        st.clear();
+        auto so = object(0, 90);
+        so.pos_.real(fixed(90) + fixed(1, fixed::raw));
+        st.set(0, so);
+        st.set(1, object(1, 200));
+        std::vector<ObjData::CollisionEvts> evts(State::nb_slots_);
+        Rules::Slots slots;
+        slots.build(st);
+        ProximityIndex near;
+        near.update(st);
+        Rules::run(rule, st, evts, slots, near);
+        CHECK(st.slots_[0].pos_.real() == fixed(95) + fixed(1, fixed::raw));
+    }
+
+    /* a radius whose square overflows int32_t holds everywhere, as the
+       distance saturates too */
+    void far()
+    {
+        State st;
+        CHECK(run("Lambda(Every(hero), Every(coin), Near(50000), Set(X, '+1'))", st) == 95);
+        CHECK(run("Lambda(Every(hero), Every(coin), Near(Add(Var(0), 50000)), Set(X, '+1'))", st) == 95);
+        Rules::Rule rule;
+        std::string error;
+        CHECK(Rules::compile("Lambda(Every(hero), Every(coin), Near(50000), Set(X, 1))", names(), rule, error));
+        CHECK(rule.near_ < 0);
+        CHECK(Rules::compile("Lambda(Every(hero), Every(coin), Near(100), Set(X, 1))", names(), rule, error));
+        CHECK(rule.near_ == 101);
+    }
+
+    /* numbers past int32_t are refused rather than wrapped */
+    void out_of_range()
+    {
+        Rules::Rule rule;
+        std::string error;
+        CHECK(Rules::compile("Lambda(Every(hero), Every(coin), Less(X, 2147483647), Set(X, -2147483648))", names(), rule, error));
+        CHECK(!Rules::compile("Lambda(Every(hero), Every(coin), Less(X, 2147483648), Set(X, 1))", names(), rule, error));
+        CHECK(error.find("number out of range") == 0);
+        CHECK(!Rules::compile("Lambda(Every(hero), Every(coin), Less(X, 1), Set(X, -9999999999))", names(), rule, error));
+        CHECK(error.find("number out of range") == 0);
+        CHECK(!Rules::compile("Lambda(Every(hero), Every(coin), Less(X, 1), Set(X, '+4294967296'))", names(), rule, error));
+        CHECK(error == "value out of range +4294967296");
+    }
+}
+
+int main()
+{
+    written_field();
+    written_var();
+    subpixel();
+    far();
+    out_of_range();
+    return failures() != 0;
+}
@@ -0,0 +1,47 @@
+#include "stepper.h"
+#include "tests/toy_level.h"
+#include "thread_pool.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+using namespace Toy;
+
+/* ticks per second of the crowd without a pool, then with 1 to N
+   threads, N being the number of cores unless given. Each drift costs
+   work steps of a generator, 20000 by default, the collision pass
+   staying sequential */
+int main(int argc, char **argv)
+{
+    int max_threads = argc > 1 ? std::atoi(argv[1]) : std::thread::hardware_concurrency();
+    int work = argc > 2 ? std::atoi(argv[2]) : 20000;
+    const int nb_ticks = 500;
+    World world(work);
+    std::vector<KeyStrokes> no_keys(State::nb_players_);
+
+    auto measure = [&](ThreadPool *pool)
+    {
+        State st = *World::crowd();
+        Stepper stepper(world.level_, pool);
+        auto start = std::chrono::steady_clock::now();
+        for (int tick = 0; tick != nb_ticks; ++tick)
+            stepper.step(st, no_keys.data(), no_keys.size());
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        return std::make_pair(nb_ticks / elapsed.count(), st.hash());
+    };
+
+    auto [reference, hash] = measure(nullptr);
+    std::printf("threads  ticks/s  speedup  same\n");
+    std::printf("      -  %7.0f     1.00  yes\n", reference);
+    for (int nb_threads = 1; nb_threads <= std::max(max_threads, 1); ++nb_threads)
+    {
+        ThreadPool pool(nb_threads);
+        auto [ticks, result] = measure(&pool);
+        std::printf("%7d  %7.0f  %7.2f  %s\n",
+                    nb_threads, ticks, ticks / reference, result == hash ? "yes" : "no");
+    }
+    return 0;
+}
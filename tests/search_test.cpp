@@ -0,0 +1,64 @@
+#include "search.h"
+#include "stepper.h"
+#include "tests/test.h"
+#include "tests/toy_level.h"
+#include "thread_pool.h"
+
+#include <memory>
+#include <vector>
+
+using namespace Toy;
+
+namespace
+{
+    /* a player walking, the score preferring the left and the goal on
+       the right */
+    SearchResult walk(int beam_width, int goal_x, ThreadPool &pool)
+    {
+        World world;
+        auto root = std::make_unique<State>();
+        root->clear();
+        root->set(0, World::object(PLAYER, at(100, 0)));
+
+        Search::Options options;
+        options.beam_width_ = beam_width;
+        options.max_depth_ = 5;
+        options.table_bytes_ = 1 << 16;
+        options.goal_ = [goal_x](const State &st) { return st.slots_[0].pos_.real() >= fixed(goal_x); };
+        auto score = [](const State &st) { return -int64_t(st.slots_[0].pos_.real().value_); };
+        auto result = Search::run(world.level_, *root, score, options, pool);
+
+        // the inputs found lead to the state found
+        Stepper stepper(world.level_);
+        for (const auto &k : result.inputs_)
+            stepper.step(*root, k.data(), k.size());
+        CHECK(root->hash() == result.state_->hash());
+        return result;
+    }
+
+    /* a goal scored out of the beam is still found */
+    void goal_out_of_beam(ThreadPool &pool)
+    {
+        auto result = walk(1, 103, pool);
+        CHECK(result.inputs_.size() == 1);
+        CHECK(!result.inputs_.empty() && result.inputs_[0][0].right_);
+        CHECK(result.state_->slots_[0].pos_.real() == fixed(103));
+    }
+
+    /* with a beam wide enough, the goal several moves away */
+    void goal_in_beam(ThreadPool &pool)
+    {
+        auto result = walk(64, 109, pool);
+        CHECK(result.inputs_.size() == 3);
+        for (const auto &k : result.inputs_)
+            CHECK(k[0].right_ && !k[0].left_);
+    }
+}
+
+int main()
+{
+    ThreadPool pool(4);
+    goal_out_of_beam(pool);
+    goal_in_beam(pool);
+    return failures() != 0;
+}
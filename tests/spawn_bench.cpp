@@ -0,0 +1,127 @@
+#include "objectdata.h"
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+using namespace ObjData;
+
+namespace
+{
+    /* a constant initialiser of a few fields */
+    class Constant : public Action
+    {
+    public:
+        explicit Constant(int phase)
+            : Action("constant", phase)
+        {
+        }
+
+        void newobject(State &, StateObject &so) const override
+        {
+            so.speed_ += Point2D(fixed(1), fixed(phase()));
+            so.mvt_[1] = so.mvt_[1] * 31 + phase();
+            so.state_ = phase();
+        }
+
+        bool spawn_constant() const override
+        {
+            return true;
+        }
+    };
+
+    /* a draw per spawn */
+    class Varying : public Action
+    {
+    public:
+        explicit Varying(int phase)
+            : Action("varying", phase)
+        {
+        }
+
+        void newobject(State &st, StateObject &so) const override
+        {
+            so.mvt_[0] = st.rnd();
+        }
+    };
+}
+
+/* spawns per second of an object with six constant initialisers, with
+   and without a varying one after them : the uncompiled path running
+   every initialiser, newobject and newobjects by 16 */
+int main()
+{
+    const int nb_rounds = 4000;
+    std::printf("initialisers        uncompiled/s  newobject/s  newobjects/s  speedup\n");
+    for (bool varying : {false, true})
+    {
+        GraphicData graphic;
+        Object object(1, graphic);
+        std::vector<const Action *> actions;
+        for (int phase = 0; phase != 6; ++phase)
+        {
+            auto action = std::make_unique<Constant>(phase);
+            actions.push_back(action.get());
+            object.add_action(std::move(action));
+        }
+        if (varying)
+        {
+            auto action = std::make_unique<Varying>(6);
+            actions.push_back(action.get());
+            object.add_action(std::move(action));
+        }
+        object.prepare();
+
+        auto st = std::make_unique<State>();
+        std::vector<Point2D> pos(State::nb_slots_);
+        for (int i = 0; i != State::nb_slots_; ++i)
+            pos[i] = Point2D(fixed(i), fixed(0));
+
+        auto measure = [&](auto spawn)
+        {
+            auto start = std::chrono::steady_clock::now();
+            for (int round = 0; round != nb_rounds; ++round)
+            {
+                st->clear();
+                spawn();
+            }
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            return double(nb_rounds) * State::nb_slots_ / elapsed.count();
+        };
+        double uncompiled = measure(
+            [&]
+            {
+                for (int i = 0; i != State::nb_slots_; ++i)
+                {
+                    StateObject so{};
+                    so.pos_ = pos[i];
+                    so.type_ = 1;
+                    so.src_ = -1;
+                    for (const Action *action : actions)
+                        action->newobject(*st, so);
+                    st->allocate(so);
+                }
+            });
+        double one = measure(
+            [&]
+            {
+                for (int i = 0; i != State::nb_slots_; ++i)
+                    object.newobject(*st, -1, pos[i]);
+            });
+        double many = measure(
+            [&]
+            {
+                int slots[16];
+                for (int i = 0; i != State::nb_slots_; i += 16)
+                    object.newobjects(*st, -1, &pos[i], 16, slots);
+            });
+        std::printf("%-18s  %12.0f  %11.0f  %12.0f  %7.2f\n",
+                    varying ? "6 constant, 1 rnd" : "6 constant",
+                    uncompiled,
+                    one,
+                    many,
+                    one / uncompiled);
+    }
+    return 0;
+}
@@ -0,0 +1,168 @@
+#include "objectdata.h"
+#include "tests/test.h"
+
+#include <cstring>
+#include <memory>
+#include <vector>
+
+using namespace ObjData;
+
+namespace
+{
+    Point2D at(int x, int y)
+    {
+        return {fixed(x), fixed(y)};
+    }
+
+    /* writes a constant field, or pos_ itself */
+    class Constant : public Action
+    {
+        bool pos_;
+
+    public:
+        Constant(int phase, bool pos)
+            : Action("constant", phase), pos_(pos)
+        {
+        }
+
+        void newobject(State &, StateObject &so) const override
+        {
+            if (pos_)
+                so.pos_ = at(7, 7);
+            else
+                so.speed_ = at(3, -1);
+            so.mvt_[1] += 5;
+        }
+
+        bool spawn_constant() const override
+        {
+            return true;
+        }
+    };
+
+    /* draws a number and reads pos_ and src_ */
+    class Varying : public Action
+    {
+    public:
+        explicit Varying(int phase)
+            : Action("varying", phase)
+        {
+        }
+
+        void newobject(State &st, StateObject &so) const override
+        {
+            so.mvt_[0] = st.rnd() ^ uint32_t(so.pos_.real().value_) ^ so.src_;
+            so.mvt_[1] *= 3;
+        }
+    };
+
+    /* an object and its actions, in phase order, for the uncompiled
+       path : every initialiser on every spawn, after pos_ and src_ */
+    struct Spawned
+    {
+        int type_;
+        GraphicData graphic_;
+        Object object_;
+        std::vector<const Action *> actions_;
+
+        Spawned(int type, const std::vector<std::pair<int, bool>> &actions)
+            : type_(type), object_(type, graphic_)
+        {
+            // (phase, constant writing pos_) or (phase, varying) when
+            // the phase is odd
+            for (auto [phase, pos] : actions)
+            {
+                std::unique_ptr<Action> action;
+                if (phase % 2)
+                    action = std::make_unique<Varying>(phase);
+                else
+                    action = std::make_unique<Constant>(phase, pos);
+                actions_.push_back(action.get());
+                object_.add_action(std::move(action));
+            }
+            object_.prepare();
+        }
+
+        int uncompiled(State &st, int src, Point2D pos) const
+        {
+            StateObject so{};
+            so.pos_ = pos;
+            so.type_ = type_;
+            so.src_ = src;
+            for (const Action *action : actions_)
+                action->newobject(st, so);
+            int slot = st.allocate(so);
+            if (slot >= 0 && src >= 0 && src < State::nb_slots_)
+                st.wake(src);
+            return slot;
+        }
+    };
+
+    bool same_bytes(const State &st1, const State &st2)
+    {
+        return !std::memcmp(&st1, &st2, sizeof(State));
+    }
+
+    /* newobject and newobjects against the uncompiled path, until the
+       state is full and past it */
+    void prefab(const std::vector<std::pair<int, bool>> &actions)
+    {
+        Spawned spawned(2, actions);
+        const Object &object = spawned.object_;
+        auto start = std::make_unique<State>();
+        start->clear();
+        start->rnd_ = 77;
+        start->set(5, StateObject{});
+        start->slots_[5].type_ = 1;
+        start->set(5, start->slots_[5]);
+        for (int slot = 10; slot != State::nb_slots_; ++slot)
+            start->set(slot, start->slots_[5]);
+
+        auto expected = std::make_unique<State>(*start);
+        auto one = std::make_unique<State>(*start);
+        auto many = std::make_unique<State>(*start);
+        std::vector<Point2D> pos;
+        std::vector<int> expected_slots, one_slots;
+        for (int i = 0; i != 12; ++i)
+        {
+            pos.push_back(at(i * 10, -i));
+            expected->slots_[5].idle_ = one->slots_[5].idle_ = 9;
+            expected_slots.push_back(spawned.uncompiled(*expected, 5, pos.back()));
+            one_slots.push_back(object.newobject(*one, 5, pos.back()));
+            CHECK(same_bytes(*expected, *one));
+        }
+        CHECK(expected_slots == one_slots);
+        CHECK(expected_slots.back() == -1);
+        // full : the spawner stays as it was
+        CHECK(one->slots_[5].idle_ == 9);
+
+        int slots[12];
+        many->slots_[5].idle_ = 9;
+        int nb = object.newobjects(*many, 5, pos.data(), 6, slots);
+        CHECK(nb == 6);
+        CHECK(std::vector<int>(slots, slots + 6) == std::vector<int>(expected_slots.begin(), expected_slots.begin() + 6));
+        CHECK(many->slots_[5].idle_ == 0);
+        nb = object.newobjects(*many, 5, pos.data() + 6, 6, slots);
+        CHECK(nb == 3);
+        CHECK(std::vector<int>(slots, slots + 6) == std::vector<int>(expected_slots.begin() + 6, expected_slots.end()));
+        many->slots_[5].idle_ = 9;
+        CHECK(same_bytes(*expected, *many));
+
+        nb = object.newobjects(*many, 5, pos.data(), 2, slots);
+        CHECK(nb == 0 && slots[0] == -1 && slots[1] == -1);
+        CHECK(many->slots_[5].idle_ == 9);
+    }
+}
+
+int main()
+{
+    // constants only, one writing pos_
+    prefab({{0, false}, {2, true}});
+    // a varying initialiser first : every one runs per spawn
+    prefab({{1, false}, {2, true}});
+    // constants, then a varying one reading pos_, then a constant
+    prefab({{0, true}, {2, false}, {3, false}, {4, false}});
+    // no initialiser at all
+    prefab({});
+    return failures() != 0;
+}
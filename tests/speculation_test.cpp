@@ -0,0 +1,82 @@
+#include "speculation.h"
+#include "stepper.h"
+#include "tests/test.h"
+#include "tests/toy_level.h"
+#include "thread_pool.h"
+
+#include <memory>
+#include <vector>
+
+using namespace Toy;
+
+namespace
+{
+    std::vector<KeyStrokes> no_keys(State::nb_players_);
+
+    /* a hit needs the same parent and the same keys */
+    void cache()
+    {
+        World world;
+        auto parent = World::crowd();
+        auto next = std::make_unique<State>(compute(world.level_, *parent, no_keys));
+        auto right = no_keys;
+        right[0].right_ = 1;
+
+        StateCache cache(2);
+        cache.insert(*parent, no_keys, *next);
+        auto found = std::make_unique<State>();
+        CHECK(cache.find(*parent, no_keys, *found) && found->hash() == next->hash());
+        CHECK(!cache.find(*parent, right, *found));
+        CHECK(!cache.contains(*parent, right));
+
+        auto other = std::make_unique<State>(*parent);
+        other->slots_[0].pos_ += at(1, 0);
+        CHECK(!cache.find(*other, no_keys, *found));
+
+        // a hit in place
+        *found = *parent;
+        CHECK(cache.find(*found, no_keys, *found) && found->hash() == next->hash());
+
+        // the least recently used goes first
+        cache.insert(*other, no_keys, *next);
+        cache.find(*parent, no_keys, *found);
+        cache.insert(*parent, right, *next);
+        CHECK(cache.contains(*parent, no_keys));
+        CHECK(cache.contains(*parent, right));
+        CHECK(!cache.contains(*other, no_keys));
+    }
+
+    /* the speculator, computing without a pool in the background, gives
+       what a stepper with one does */
+    void pooled()
+    {
+        World world;
+        ThreadPool pool(3);
+        Speculator speculator(world.level_, pool, 256, 30);
+        Stepper stepper(world.level_, &pool);
+
+        auto start = World::crowd();
+        start->rng_ = RNG_COUNTER;
+        speculator.cursor(*start, no_keys);
+        for (int pass = 0; pass != 2; ++pass)
+        {
+            auto speculated = std::make_unique<State>(*start);
+            auto stepped = std::make_unique<State>(*start);
+            for (int tick = 0; tick != 30; ++tick)
+            {
+                speculator.compute(*speculated, no_keys);
+                stepper.step(*stepped, no_keys.data(), no_keys.size());
+                CHECK(speculated->hash() == stepped->hash());
+            }
+        }
+        // the second pass at least
+        CHECK(speculator.stats().hits_ >= 30);
+    }
+}
+
+int main()
+{
+    cache();
+    pooled();
+    return failures() != 0;
+}
@@ -0,0 +1,92 @@
+#include "objectdata.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+using namespace ObjData;
+
+/* 50000 decorations over a level of 32000x4000 pixels, one in ten
+   with parallax, seen by a 1920x1080 camera panning across it : frames
+   per second of SpriteIndex::query against testing every sprite, and
+   the sprites found per frame */
+int main()
+{
+    const int nb_sprites = 50000;
+    const int nb_frames = 2000;
+    Image image;
+    image.w_ = image.h_ = image.stride_ = 64;
+    image.content_.assign(64 * 64, Pixel{});
+    std::vector<FrameData> frames;
+    for (int size : {16, 32, 64})
+        frames.push_back({Sprite(&image, 0, {{0, 0}, {size - 1, size - 1}}), {}});
+    const Point2D coeffs[] = {{-fixed(1, fixed::raw) * 512, fixed(0)},
+                              {fixed(1, fixed::raw) * 256, fixed(1, fixed::raw) * 256}};
+
+    uint32_t seed = 1;
+    auto next = [&seed](int n)
+    {
+        seed = seed * 1103515245u + 12345u;
+        return int(seed >> 8) % n;
+    };
+    std::vector<SpriteInstance> sprites;
+    SpriteIndex index;
+    for (int id = 0; id != nb_sprites; ++id)
+    {
+        SpriteInstance si{};
+        si.frame_ = &frames[next(3)];
+        si.coor_ = {fixed(next(32000)), fixed(next(4000))};
+        si.id_ = id;
+        si.has_parallax_ = next(10) == 0;
+        if (si.has_parallax_)
+            si.parallax_coeff_ = coeffs[next(2)];
+        sprites.push_back(si);
+        index.insert(si);
+    }
+
+    const Point2D size(fixed(1920), fixed(1080));
+    auto camera = [](int frame)
+    {
+        return Point2D(fixed(frame * 15), fixed(1500 + frame % 200));
+    };
+    std::vector<SpriteInstance> result;
+    std::vector<int> found;
+
+    size_t indexed = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame != nb_frames; ++frame)
+    {
+        result.clear();
+        index.query(camera(frame), size, result, found);
+        indexed += result.size();
+    }
+    std::chrono::duration<double> index_time = std::chrono::steady_clock::now() - start;
+
+    size_t scanned = 0;
+    start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame != nb_frames; ++frame)
+    {
+        result.clear();
+        for (const auto &si : sprites)
+        {
+            auto pos = si.pos(camera(frame)) - camera(frame);
+            auto extent = si.extent();
+            if (pos.real() + extent.real() > 0 && pos.imag() + extent.imag() > 0
+                && pos.real() <= size.real() && pos.imag() <= size.imag())
+                result.push_back(si);
+        }
+        scanned += result.size();
+    }
+    std::chrono::duration<double> scan_time = std::chrono::steady_clock::now() - start;
+
+    std::printf("sprites  sprites/frame  query frames/s  scan frames/s  speedup  same\n");
+    std::printf("%7d  %13.0f  %14.0f  %13.0f  %7.1f  %s\n",
+                nb_sprites,
+                double(indexed) / nb_frames,
+                nb_frames / index_time.count(),
+                nb_frames / scan_time.count(),
+                scan_time.count() / index_time.count(),
+                indexed == scanned ? "yes" : "no");
+    return 0;
+}
@@ -0,0 +1,148 @@
+#include "objectdata.h"
+#include "tests/test.h"
+
+#include <cstdint>
+#include <vector>
+
+using namespace ObjData;
+
+namespace
+{
+    Point2D at(int x, int y)
+    {
+        return {fixed(x), fixed(y)};
+    }
+
+    /* a 64x64 image and frames of a few sizes over it */
+    struct Frames
+    {
+        Image image_;
+        std::vector<FrameData> frames_;
+
+        Frames()
+        {
+            image_.w_ = image_.h_ = image_.stride_ = 64;
+            image_.content_.assign(64 * 64, Pixel{});
+            for (int size : {1, 16, 40})
+                frames_.push_back({Sprite(&image_, 0, {{0, 0}, {size - 1, size - 1}}), {}});
+            frames_.push_back({Sprite(&image_, 0, {{8, 4}, {39, 11}}), {}});
+        }
+    };
+
+    SpriteInstance sprite(const FrameData &frame, Point2D coor, int id, const Point2D *coeff = nullptr)
+    {
+        SpriteInstance si{};
+        si.frame_ = &frame;
+        si.coor_ = coor;
+        si.id_ = id;
+        si.has_parallax_ = coeff;
+        si.parallax_coeff_ = coeff ? *coeff : Point2D();
+        return si;
+    }
+
+    /* what the index must find : every sprite in turn, covering from
+       its position to one past its last pixel, both corners of its
+       rectangle being pixels of it, and meeting [camera, camera + size] */
+    std::vector<int> brute_force(const std::vector<SpriteInstance> &sprites, Point2D camera, Point2D size)
+    {
+        std::vector<int> result;
+        for (const auto &si : sprites)
+        {
+            auto first = si.pos(camera) - camera;
+            const auto &coor = si.frame_->sprite_.coor_;
+            Point2D end = first + Point2D(fixed(coor.second.real() - coor.first.real() + 1),
+                                          fixed(coor.second.imag() - coor.first.imag() + 1));
+            if (end.real() > 0 && end.imag() > 0 && first.real() <= size.real() && first.imag() <= size.imag())
+                result.push_back(si.id_);
+        }
+        return result;
+    }
+
+    std::vector<int> ids(const std::vector<SpriteInstance> &sis)
+    {
+        std::vector<int> result;
+        for (const auto &si : sis)
+            result.push_back(si.id_);
+        return result;
+    }
+
+    /* sprites spread at random, with parallax, down to -2, against the
+       same sprites scanned one by one, from cameras all over them */
+    void spread()
+    {
+        Frames frames;
+        const Point2D coeffs[] = {{fixed(0), fixed(0)},
+                                  {fixed(1, fixed::raw) * 512, fixed(1, fixed::raw) * 256},
+                                  {-fixed(1, fixed::raw) * 512, -fixed(1, fixed::raw) * 512},
+                                  {fixed(-1), fixed(-1)},
+                                  {fixed(-1), fixed(1, fixed::raw) * 512},
+                                  {fixed(-2), -fixed(1, fixed::raw) * 768}};
+        uint32_t seed = 12345;
+        auto next = [&seed](int n)
+        {
+            seed = seed * 1103515245u + 12345u;
+            return int(seed >> 8) % n;
+        };
+
+        SpriteIndex index(64);
+        std::vector<SpriteInstance> sprites;
+        for (int id = 0; id != 3000; ++id)
+        {
+            Point2D coor(fixed(next(4000 << 10) - (2000 << 10), fixed::raw),
+                         fixed(next(4000 << 10) - (2000 << 10), fixed::raw));
+            int parallax = next(int(std::size(coeffs)) + 1);
+            const Point2D *coeff = parallax == std::size(coeffs) ? nullptr : &coeffs[parallax];
+            sprites.push_back(sprite(frames.frames_[next(int(frames.frames_.size()))], coor, id, coeff));
+            index.insert(sprites.back());
+        }
+
+        std::vector<SpriteInstance> result;
+        std::vector<int> found;
+        for (int query = 0; query != 200; ++query)
+        {
+            Point2D camera(fixed(next(3000 << 10) - (1500 << 10), fixed::raw),
+                           fixed(next(3000 << 10) - (1500 << 10), fixed::raw));
+            Point2D size = at(64 + next(400), 64 + next(300));
+            result.clear();
+            index.query(camera, size, result, found);
+            CHECK(ids(result) == brute_force(sprites, camera, size));
+        }
+    }
+
+    /* sprites whose last pixel lies on the first row or column of the
+       view and whose first lies on the last are in, one pixel further
+       out they are not */
+    void edges()
+    {
+        Frames frames;
+        const auto &frame = frames.frames_[1];
+        const Point2D camera = at(100, 200);
+        const Point2D size = at(320, 240);
+        std::vector<SpriteInstance> sprites;
+        int id = 0;
+        for (int out : {0, 1})
+        {
+            sprites.push_back(sprite(frame, at(100 - 15 - out, 300), id++));
+            sprites.push_back(sprite(frame, at(200, 200 - 15 - out), id++));
+            sprites.push_back(sprite(frame, at(420 + out, 300), id++));
+            sprites.push_back(sprite(frame, at(200, 440 + out), id++));
+            sprites.push_back(sprite(frame, at(100 - 15 - out, 200 - 15 - out), id++));
+        }
+        SpriteIndex index(64);
+        for (const auto &si : sprites)
+            index.insert(si);
+
+        std::vector<SpriteInstance> result;
+        std::vector<int> found;
+        index.query(camera, size, result, found);
+        CHECK((ids(result) == std::vector<int>{0, 1, 2, 3, 4}));
+        CHECK(ids(result) == brute_force(sprites, camera, size));
+    }
+}
+
+int main()
+{
+    spread();
+    edges();
+    return failures() != 0;
+}
@@ -0,0 +1,83 @@
+#include "memory.h"
+#include "stepper.h"
+#include "tests/toy_level.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+using namespace Toy;
+
+/* ticks per second of compute, a State by value per tick, against
+   Stepper::run in place, on an empty state and on the crowd with and
+   without a pool. Also the bytes allocated under MEMORY_TICK per tick
+   once warm, by the stepper itself, the actions of the toy level
+   allocating nothing */
+int main()
+{
+    const int nb_ticks = 2000;
+    const int warm = 2000;
+    World world;
+    ThreadPool pool(4);
+    std::vector<KeyStrokes> no_keys(State::nb_players_);
+    std::vector<std::vector<KeyStrokes>> inputs(std::max(warm, nb_ticks), no_keys);
+
+    struct Measure
+    {
+        double ticks_;
+        double bytes_;
+        uint64_t hash_;
+    };
+    auto measure = [&](const State &first, ThreadPool *p, bool in_place)
+    {
+        auto st = std::make_unique<State>(first);
+        Stepper stepper(world.level_, p);
+        auto tick = [&](int n)
+        {
+            if (in_place)
+                stepper.run(*st, inputs.begin(), n);
+            else
+                for (int i = 0; i != n; ++i)
+                    *st = compute(world.level_, *st, no_keys, p);
+        };
+        tick(warm);
+        int64_t allocated = MemoryCounters::allocated_[MEMORY_TICK];
+        auto start = std::chrono::steady_clock::now();
+        tick(nb_ticks);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        return Measure{nb_ticks / elapsed.count(),
+                       double(MemoryCounters::allocated_[MEMORY_TICK] - allocated) / nb_ticks,
+                       st->hash()};
+    };
+
+    // on the heap, for -DSTATE_SLOTS=65536
+    auto empty = std::make_unique<State>();
+    empty->clear();
+    auto crowd = World::crowd();
+    struct Case
+    {
+        const char *name_;
+        const State &st_;
+        ThreadPool *pool_;
+    };
+    std::printf("state           compute ticks/s  B/tick  step ticks/s  B/tick  speedup  same\n");
+    for (const auto &[name, st, p] : {Case{"empty", *empty, nullptr},
+                                      Case{"crowd", *crowd, nullptr},
+                                      Case{"crowd, 4 threads", *crowd, &pool}})
+    {
+        auto value = measure(st, p, false);
+        auto in_place = measure(st, p, true);
+        std::printf("%-16s %15.0f  %6.0f  %12.0f  %6.0f  %7.2f  %s\n",
+                    name,
+                    value.ticks_,
+                    value.bytes_,
+                    in_place.ticks_,
+                    in_place.bytes_,
+                    in_place.ticks_ / value.ticks_,
+                    value.hash_ == in_place.hash_ ? "yes" : "no");
+    }
+    return 0;
+}
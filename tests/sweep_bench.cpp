@@ -0,0 +1,52 @@
+#include "tests/toy_map.h"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace ToyMap;
+
+/* falls per second onto sparse GROUND, Map::sweep against one probe per
+   pixel, for a few speeds in pixels per tick */
+int main()
+{
+    World world(40, 40, 0.01);
+    const auto &map = world.map_;
+    std::mt19937 rng(1);
+    std::vector<Point2D> starts;
+    for (int i = 0; i != 1000; ++i)
+        starts.emplace_back(fixed(int(rng() % (40 * cell_size))), fixed(int(rng() % (40 * cell_size))));
+
+    auto measure = [&](auto fall)
+    {
+        int64_t total = 0;
+        int nb_falls = 0;
+        auto start = std::chrono::steady_clock::now();
+        std::chrono::duration<double> elapsed{0};
+        while (elapsed.count() < 0.2)
+        {
+            for (const auto &pos : starts)
+                total += fall(pos);
+            nb_falls += starts.size();
+            elapsed = std::chrono::steady_clock::now() - start;
+        }
+        return std::make_pair(nb_falls / elapsed.count(), total / nb_falls);
+    };
+
+    std::printf("speed    swept/s  stepped/s  speedup  same\n");
+    for (int64_t speed : {4, 16, 64, 480})
+    {
+        auto [swept, swept_total] = measure([&](Point2D pos)
+        {
+            return map.sweep(0, GROUND, pos, SWEEP_DOWN, speed);
+        });
+        auto [stepped, stepped_total] = measure([&](Point2D pos)
+        {
+            return pixel_steps(map, 0, GROUND, pos, SWEEP_DOWN, speed);
+        });
+        std::printf("%5d  %9.0f  %9.0f  %7.2f  %s\n",
+                    int(speed), swept, stepped, swept / stepped, swept_total == stepped_total ? "yes" : "no");
+    }
+    return 0;
+}
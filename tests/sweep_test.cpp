@@ -0,0 +1,56 @@
+#include "tests/test.h"
+#include "tests/toy_map.h"
+
+#include <random>
+
+using namespace ToyMap;
+
+namespace
+{
+    /* Map::sweep against the pixel steps, from whole and fractional
+       positions, in and out of the map, every direction, mask and tick */
+    void pixel_equivalence(double density, uint32_t seed)
+    {
+        World world(12, 10, density, seed);
+        const auto &map = world.map_;
+        std::mt19937 rng(seed);
+        const int w = 12 * cell_size, h = 10 * cell_size;
+        int mismatches = 0;
+        for (int i = 0; i != 20000; ++i)
+        {
+            Point2D pos(fixed(int(rng() % (w + 80)) - 40), fixed(int(rng() % (h + 80)) - 40));
+            if (i % 2)
+                pos += Point2D(fixed(int(rng() % 1024)) / 1024, fixed(int(rng() % 1024)) / 1024);
+            auto sweep = ID_SWEEP(rng() % NUMBER_SWEEPS);
+            auto mask = ID_MASK(WALL + rng() % 3);
+            int64_t length = rng() % 300;
+            uint32_t timestamp = rng() % 4;
+            if (map.sweep(timestamp, mask, pos, sweep, length)
+                != pixel_steps(map, timestamp, mask, pos, sweep, length))
+                mismatches++;
+        }
+        CHECK(mismatches == 0);
+    }
+
+    /* a fall through a map of single pixels of GROUND stops on the first */
+    void thin()
+    {
+        World world(4, 40, 0.002, 7);
+        const auto &map = world.map_;
+        for (int x = 0; x != 4 * cell_size; ++x)
+        {
+            Point2D pos(fixed(x), fixed(0));
+            CHECK(map.sweep(0, GROUND, pos, SWEEP_DOWN, 40 * cell_size)
+                  == pixel_steps(map, 0, GROUND, pos, SWEEP_DOWN, 40 * cell_size));
+        }
+    }
+}
+
+int main()
+{
+    pixel_equivalence(0.05, 1);
+    pixel_equivalence(0.3, 2);
+    pixel_equivalence(0.9, 3);
+    thin();
+    return failures() != 0;
+}
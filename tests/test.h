@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdio>
+
+/* checks go on after a failure, main returns failures() */
+inline int &failures()
+{
+    static int count = 0;
+    return count;
+}
+
+#define CHECK(condition)                                                  \
+    do                                                                    \
+    {                                                                     \
+        if (!(condition))                                                 \
+        {                                                                 \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n",             \
+                         __FILE__, __LINE__, #condition);                 \
+            failures()++;                                                 \
+        }                                                                 \
+    } while (0)
@@ -0,0 +1,53 @@
+#include "tests/test.h"
+#include "thread_pool.h"
+
+#include <atomic>
+#include <thread>
+
+namespace
+{
+    /* run leaves the posted tasks to the workers, and the pool runs
+       them all before it goes */
+    void groups()
+    {
+        std::atomic<bool> started{false}, release{false}, ran{false};
+        {
+            ThreadPool pool(1);
+            pool.post([&]()
+            {
+                started = true;
+                while (!release)
+                    std::this_thread::yield();
+            });
+            while (!started)
+                std::this_thread::yield();
+            pool.post([&]() { ran = true; });
+
+            std::atomic<int> sum{0};
+            pool.run(8, [&](int i) { sum += i; });
+            CHECK(sum == 28);
+            CHECK(!ran);
+            release = true;
+        }
+        CHECK(ran);
+    }
+
+    /* a task may run tasks of its own */
+    void nested()
+    {
+        ThreadPool pool(2);
+        std::atomic<int> count{0};
+        pool.run(4, [&](int)
+        {
+            pool.run(4, [&](int) { count++; });
+        });
+        CHECK(count == 16);
+    }
+}
+
+int main()
+{
+    groups();
+    nested();
+    return failures() != 0;
+}
@@ -0,0 +1,159 @@
+#include "objectdata.h"
+#include "tests/test.h"
+#include "thread_pool.h"
+#include "tile_map.h"
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace ObjData;
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    const int w = 100, h = 70, chunk_size = 16;
+
+    /* empty in the chunks of the left column and on the diagonal */
+    std::vector<uint16_t> cells()
+    {
+        std::vector<uint16_t> result(w * h);
+        for (int y = 0; y != h; ++y)
+            for (int x = 0; x != w; ++x)
+                if (x >= chunk_size && x / chunk_size != y / chunk_size)
+                    result[x + y * w] = 1 + (x + y) % 3;
+        return result;
+    }
+
+    std::string path(const char *name)
+    {
+        return (fs::temp_directory_path() / name).string();
+    }
+
+    void patch(const std::string &path, long at, const void *data, size_t size)
+    {
+        FILE *file = std::fopen(path.c_str(), "r+b");
+        std::fseek(file, at, SEEK_SET);
+        std::fwrite(data, size, 1, file);
+        std::fclose(file);
+    }
+
+    /* every cell read back, from several threads evicting each other */
+    void cells_back()
+    {
+        std::vector<AnimationData> animations(3);
+        std::vector<const AnimationData *> palette{&animations[0], &animations[1], &animations[2]};
+        auto file = path("tile_map_test.map");
+        auto expected = cells();
+        CHECK(ChunkedMap::write(file, w, h, chunk_size, expected));
+
+        std::optional<ChunkedMap> opened;
+        auto &map = opened.emplace();
+        CHECK(map.open(file, palette, 2));
+        CHECK(map.w() == w && map.h() == h);
+        ThreadPool pool(4);
+        std::vector<int> errors(h);
+        pool.run(h, [&](int y)
+        {
+            for (int pass = 0; pass != 3; ++pass)
+                for (int x = 0; x != w; ++x)
+                {
+                    auto cell = expected[x + y * w];
+                    errors[y] += map.at(x, y) != (cell ? palette[cell - 1] : nullptr);
+                }
+        });
+        for (int y = 0; y != h; ++y)
+            CHECK(errors[y] == 0);
+        CHECK(map.resident() <= 2);
+
+        // another map at the same address, read by the same thread
+        CHECK(map.at(40, 20) == palette[0]);
+        std::vector<uint16_t> other(w * h, 3);
+        CHECK(ChunkedMap::write(file, w, h, chunk_size, other));
+        auto &again = opened.emplace();
+        CHECK(&again == &map);
+        CHECK(again.open(file, palette, 2));
+        CHECK(again.at(40, 20) == palette[2]);
+        fs::remove(file);
+    }
+
+    /* a header too large for its file, or a chunk out of it, fail */
+    void corrupt()
+    {
+        auto file = path("tile_map_corrupt.map");
+        std::vector<const AnimationData *> palette(3);
+        ChunkedMap map;
+
+        auto header = [&](uint32_t w, uint32_t h, uint32_t chunk_size)
+        {
+            CHECK(ChunkedMap::write(file, 100, 70, 16, cells()));
+            ChunkedMap::Header header{ChunkedMap::magic_, w, h, chunk_size};
+            patch(file, 0, &header, sizeof(header));
+            return map.open(file, palette, 4);
+        };
+        CHECK(header(100, 70, 16));
+        CHECK(!header(0xffffffff, 70, 16));
+        CHECK(!header(100, 0x80000000, 16));
+        CHECK(!header(100, 70, 0x80000000));
+        CHECK(!header(0x7fffffff, 0x7fffffff, 1));
+        CHECK(!header(100, 70, 0));
+        // a single chunk, the first of the directory, empty
+        CHECK(header(100, 70, 0x7fffffff));
+        CHECK(map.at(99, 69) == nullptr);
+
+        // the second chunk of the top row, past the end then in the directory
+        auto offset = [&](uint64_t value)
+        {
+            CHECK(ChunkedMap::write(file, 100, 70, 16, cells()));
+            patch(file, sizeof(ChunkedMap::Header) + sizeof(uint64_t), &value, sizeof(value));
+            return map.open(file, palette, 4);
+        };
+        CHECK(!offset(fs::file_size(file)));
+        CHECK(!offset(fs::file_size(file) - 2));
+        CHECK(!offset(sizeof(ChunkedMap::Header)));
+        CHECK(!offset(~uint64_t(0)));
+        fs::remove(file);
+    }
+
+    /* the chunks around the camera come without being read */
+    void focus()
+    {
+        auto file = path("tile_map_focus.map");
+        CHECK(ChunkedMap::write(file, w, h, chunk_size, cells()));
+        std::vector<const AnimationData *> palette(3);
+        ThreadPool pool(2);
+        ChunkedMap map;
+        CHECK(map.open(file, palette, 64, &pool));
+
+        auto wait = [&](size_t resident)
+        {
+            auto start = std::chrono::steady_clock::now();
+            while (map.resident() < resident && std::chrono::steady_clock::now() - start < std::chrono::seconds(5))
+                std::this_thread::yield();
+            return map.resident();
+        };
+
+        // around chunk (2, 2) : all but (1, 1), (2, 2) and (3, 3), and
+        // (4, 4) ahead is empty too
+        for (int i = 0; i != 10; ++i)
+            map.focus(40, 40);
+        CHECK(wait(6) == 6);
+        // moving right to (3, 2) : column 4, and column 5 ahead
+        map.focus(56, 40);
+        CHECK(wait(6 + 3 + 3) == 6 + 3 + 3);
+        fs::remove(file);
+    }
+}
+
+int main()
+{
+    cells_back();
+    corrupt();
+    focus();
+    return failures() != 0;
+}
@@ -0,0 +1,279 @@
+#pragma once
+
+#include <memory>
+
+#include "objectdata.h"
+
+/* A small level built in code for the tests and benchmarks : 16x16
+   sprites whose every pixel is GROUND and TARGET, all the spots at the
+   centre but FEET, at the bottom. */
+namespace Toy
+{
+    using namespace ObjData;
+
+    enum ID_TYPE
+    {
+        DRIFT,
+        PUSHER,
+        SPAWNER,
+        CRATE,
+        FLOOR,
+        PLAYER,
+        ASSIGN,
+        TELEPORT,
+        TICKET,
+        NUMBER_TYPES
+    };
+
+    inline Point2D at(int x, int y)
+    {
+        return {fixed(x), fixed(y)};
+    }
+
+    /* moves by speed_, turns back now and then, counts in var_[1] and
+       goes away past x = 300. work stands for the cost of a real action,
+       in draws of a local generator */
+    class Drift : public Action
+    {
+        int work_;
+
+    public:
+        explicit Drift(int work = 0)
+            : Action("drift", 0), work_(work)
+        {
+        }
+
+        void newobject(State &, StateObject &so) const override
+        {
+            so.speed_ = at(5, 0);
+        }
+
+        bool spawn_constant() const override
+        {
+            return true;
+        }
+
+        void execute(State &st, int self, const CollisionEvts &, const ProximityIndex &) const override
+        {
+            auto &so = st.slots_[self];
+            uint32_t x = so.mvt_[1];
+            for (int i = 0; i != work_; ++i)
+                x = x * 22695477 + 1;
+            so.mvt_[1] = x;
+            so.pos_ += so.speed_;
+            if (st.rnd() % 32 == 0)
+                so.speed_ = -so.speed_;
+            st.var_[1]++;
+            if (so.pos_.real() > 300 || so.pos_.real() < -300)
+                st.free(self);
+        }
+    };
+
+    /* moves what its SPAWN spot finds in TARGET by a pixel, pushers
+       aside, counting in var_[0] */
+    class Push : public Action
+    {
+    public:
+        Push()
+            : Action("push", 0)
+        {
+        }
+
+        void execute(State &st, int self, const CollisionEvts &evts, const ProximityIndex &) const override
+        {
+            for (const auto &evt : evts)
+            {
+                if (evt.obj_spot_ != self || evt.obj_mask_ < 0 || evt.contact_ == CONTACT_EXIT
+                    || evt.id_spot_ != SPAWN || evt.id_mask_ != TARGET
+                    || st.slots_[evt.obj_mask_].type_ == PUSHER)
+                    continue;
+                st.slots_[evt.obj_mask_].pos_ += at(1, 0);
+                st.var_[0]++;
+            }
+        }
+    };
+
+    /* every 8 ticks, a drift below, its slot going into mvt_[0] */
+    class Spawn : public Action
+    {
+        const Level &level_;
+
+    public:
+        explicit Spawn(const Level &level)
+            : Action("spawn", 1), level_(level)
+        {
+        }
+
+        void execute(State &st, int self, const CollisionEvts &, const ProximityIndex &) const override
+        {
+            if (st.timestamp_ % 8)
+                return;
+            auto pos = st.slots_[self].pos_ + at(0, 32);
+            st.slots_[self].mvt_[0] = level_.object(DRIFT).newobject(st, self, pos);
+        }
+
+        bool can_sleep() const override
+        {
+            return false;
+        }
+    };
+
+    /* falls until FEET touches GROUND */
+    class Fall : public Action
+    {
+    public:
+        Fall()
+            : Action("fall", 0)
+        {
+        }
+
+        void execute(State &st, int self, const CollisionEvts &evts, const ProximityIndex &) const override
+        {
+            auto &so = st.slots_[self];
+            bool ground = false;
+            for (const auto &evt : evts)
+                ground = ground || (evt.obj_spot_ == self && evt.id_spot_ == FEET
+                                    && evt.id_mask_ == GROUND && evt.contact_ != CONTACT_EXIT);
+            if (ground)
+                so.speed_ = {};
+            else
+                so.pos_ += so.speed_ += at(0, 1);
+        }
+    };
+
+    /* left and right by 3 pixels, the first player's keys */
+    class Walk : public Action
+    {
+    public:
+        Walk()
+            : Action("walk", 0)
+        {
+        }
+
+        void execute(State &st, int self, const CollisionEvts &, const ProximityIndex &) const override
+        {
+            const auto &keys = st.keys_[0];
+            st.slots_[self].pos_ += at(3 * (keys.right_ - keys.left_), 0);
+        }
+
+        int reads() const override
+        {
+            return READ_KEYS;
+        }
+    };
+
+    /* var_[2] = 7, whatever it was */
+    class Assign : public Action
+    {
+    public:
+        Assign()
+            : Action("assign", 0)
+        {
+        }
+
+        void execute(State &st, int, const CollisionEvts &, const ProximityIndex &) const override
+        {
+            st.var_[2] = 7;
+        }
+    };
+
+    /* sends what its SPAWN spot finds in TARGET to (-200, -200) */
+    class Teleport : public Action
+    {
+    public:
+        Teleport()
+            : Action("teleport", 0)
+        {
+        }
+
+        void execute(State &st, int self, const CollisionEvts &evts, const ProximityIndex &) const override
+        {
+            for (const auto &evt : evts)
+                if (evt.obj_spot_ == self && evt.obj_mask_ >= 0 && evt.contact_ != CONTACT_EXIT
+                    && evt.id_spot_ == SPAWN && evt.id_mask_ == TARGET)
+                    st.slots_[evt.obj_mask_].pos_ = at(-200, -200);
+        }
+    };
+
+    /* takes the next ticket of var_[3] into mvt_[0] */
+    class Ticket : public Action
+    {
+    public:
+        Ticket()
+            : Action("ticket", 0)
+        {
+        }
+
+        void execute(State &st, int self, const CollisionEvts &, const ProximityIndex &) const override
+        {
+            st.slots_[self].mvt_[0] = st.var_[3]++;
+        }
+
+        void vars(std::vector<int> &vars) const override
+        {
+            vars.push_back(3);
+        }
+    };
+
+    struct World
+    {
+        Image image_;
+        Level level_;
+        // the one graphic every type shares
+        const GraphicData *graphic_;
+
+        explicit World(int work = 0)
+        {
+            image_.w_ = image_.h_ = image_.stride_ = 16;
+            Pixel pixel{255, 255, 255, 255, 1 << GROUND | 1 << TARGET, 0};
+            image_.content_.assign(16 * 16, pixel);
+
+            FrameData frame{Sprite(&image_, 0, {{0, 0}, {15, 15}}), {}};
+            frame.spots_.fill(at(8, 8));
+            frame.spots_[FEET] = at(8, 15);
+            auto &graphic = level_.add_graphic();
+            graphic_ = &graphic;
+            auto &animation = graphic.add(0);
+            animation.frames_.push_back(level_.frames().intern(frame));
+            animation.loop_ = true;
+
+            level_.add_object(graphic).add_action(std::make_unique<Drift>(work));
+            level_.add_object(graphic).add_action(std::make_unique<Push>());
+            level_.add_object(graphic).add_action(std::make_unique<Spawn>(level_));
+            level_.add_object(graphic).add_action(std::make_unique<Fall>());
+            level_.add_object(graphic);
+            level_.add_object(graphic).add_action(std::make_unique<Walk>());
+            level_.add_object(graphic).add_action(std::make_unique<Assign>());
+            level_.add_object(graphic).add_action(std::make_unique<Teleport>());
+            level_.add_object(graphic).add_action(std::make_unique<Ticket>());
+            level_.prepare();
+        }
+
+        World(const World &) = delete;
+        World &operator=(const World &) = delete;
+
+        static StateObject object(int type, Point2D pos, Point2D speed = {})
+        {
+            StateObject so{};
+            so.type_ = type;
+            so.pos_ = pos;
+            so.speed_ = speed;
+            return so;
+        }
+
+        /* drifts in every block, overlapping their neighbours, pushers
+           and spawners among them */
+        static std::unique_ptr<State> crowd()
+        {
+            auto st = std::make_unique<State>();
+            st->clear();
+            for (int i = 0; i != 120; ++i)
+                st->set(2 * i, object(DRIFT, at(i % 12 * 12, i / 12 * 12), at(i % 3 - 1, 0)));
+            for (int slot : {1, 65, 129, 193})
+                st->set(slot, object(PUSHER, at(slot % 12 * 12 + 4, slot / 24 * 12)));
+            for (int slot : {3, 99, 201})
+                st->set(slot, object(SPAWNER, at(slot % 7 * 20, -40)));
+            return st;
+        }
+    };
+}
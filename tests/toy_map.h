@@ -0,0 +1,94 @@
+#pragma once
+
+#include <filesystem>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "objectdata.h"
+
+/* A random tile map for the sweep tests and benchmarks : 16x16 cells of
+   four tiles, WALL, GROUND and TARGET scattered over their pixels. Two
+   tiles are animated, one has a sprite smaller than its cell */
+namespace ToyMap
+{
+    using namespace ObjData;
+
+    const int cell_size = 16;
+
+    inline Point2D step(ID_SWEEP sweep)
+    {
+        const Point2D steps[NUMBER_SWEEPS] = {{0, 1}, {0, -1}, {-1, 0}, {1, 0}};
+        return steps[sweep];
+    }
+
+    /* the first i below length such that the pixel at pos + i in the
+       direction of sweep is in mask, one pixel at a time */
+    inline int64_t pixel_steps(const Map &map,
+                               uint32_t timestamp,
+                               ID_MASK mask,
+                               Point2D pos,
+                               ID_SWEEP sweep,
+                               int64_t length)
+    {
+        for (int64_t i = 0; i != length; ++i)
+        {
+            auto [in_cell, cell] = map.get(pos + step(sweep) * fixed(i));
+            if (cell && cell->get(timestamp).sprite_.contains(in_cell, mask))
+                return i;
+        }
+        return length;
+    }
+
+    struct World
+    {
+        std::vector<std::unique_ptr<Image>> images_;
+        std::vector<std::unique_ptr<FrameData>> frames_;
+        std::vector<AnimationData> animations_;
+        Map map_;
+
+        /* w x h cells, density the chance of a pixel to be in a mask */
+        World(int w, int h, double density, uint32_t seed = 1)
+            : animations_(4)
+        {
+            std::mt19937 rng(seed);
+            std::bernoulli_distribution in(density);
+            auto image = [&]()
+            {
+                auto &result = *images_.emplace_back(std::make_unique<Image>());
+                result.w_ = result.stride_ = result.h_ = cell_size;
+                result.content_.resize(cell_size * cell_size);
+                for (auto &pixel : result.content_)
+                    pixel.masks_ = in(rng) << WALL | in(rng) << GROUND | in(rng) << TARGET;
+                return &result;
+            };
+            auto frame = [&](Image *image, IRectangle coor)
+            {
+                return frames_.emplace_back(std::make_unique<FrameData>(FrameData{Sprite(image, 0, coor), {}})).get();
+            };
+
+            IRectangle whole{{0, 0}, {cell_size - 1, cell_size - 1}};
+            animations_[0].frames_ = {frame(image(), whole)};
+            animations_[1].frames_ = {frame(image(), whole), frame(image(), whole)};
+            animations_[2].frames_ = {frame(image(), {{3, 5}, {11, 9}})};
+            animations_[3].frames_ = {frame(image(), whole), frame(image(), {{0, 0}, {7, 15}})};
+            for (auto &animation : animations_)
+                animation.loop_ = true;
+
+            std::vector<uint16_t> cells(w * h);
+            for (auto &cell : cells)
+                cell = rng() % 6 < 4 ? 1 + rng() % 4 : 0;
+            auto path = (std::filesystem::temp_directory_path() / ("toy_map_" + std::to_string(seed))).string();
+            ChunkedMap::write(path, w, h, 4, cells);
+            std::vector<const AnimationData *> palette;
+            for (const auto &animation : animations_)
+                palette.push_back(&animation);
+            map_.load(path, cell_size, cell_size, palette, w * h);
+            std::filesystem::remove(path);
+        }
+
+        World(const World &) = delete;
+        World &operator=(const World &) = delete;
+    };
+}
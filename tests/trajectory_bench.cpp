@@ -0,0 +1,97 @@
+#include "stepper.h"
+#include "tests/toy_level.h"
+#include "trajectory.h"
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+using namespace Toy;
+
+/* ticks per second with and without the store observing the stepper,
+   its bytes per tick against a State per tick, and queries per second
+   of the position of a slot at a tick and of the first tick a drift is
+   far enough, against stepping again from the start to the tick */
+int main()
+{
+    using Clock = std::chrono::steady_clock;
+    const int nb_ticks = 2000;
+    World world;
+    std::vector<std::vector<KeyStrokes>> inputs(nb_ticks, std::vector<KeyStrokes>(State::nb_players_));
+    const State first = *World::crowd();
+
+    auto seconds = [](Clock::time_point begin)
+    {
+        return std::chrono::duration<double>(Clock::now() - begin).count();
+    };
+
+    State plain = first;
+    auto begin = Clock::now();
+    Stepper(world.level_).run(plain, inputs.begin(), nb_ticks);
+    double plain_rate = nb_ticks / seconds(begin);
+
+    TrajectoryStore store;
+    State recorded = first;
+    begin = Clock::now();
+    Stepper(world.level_).run(recorded, inputs.begin(), nb_ticks, store);
+    double store_rate = nb_ticks / seconds(begin);
+
+    std::printf("step ticks/s  with store  store B/tick  State B/tick\n");
+    std::printf("%12.0f  %10.0f  %12.0f  %12zu\n\n",
+                plain_rate,
+                store_rate,
+                double(store.bytes()) / nb_ticks,
+                sizeof(State));
+
+    // slots and ticks spread over the history
+    const int nb_queries = 200;
+    auto slot_of = [](int i) { return i * 37 % 240; };
+    auto tick_of = [&](int i) { return store.first_tick() + i * 997 % nb_ticks; };
+
+    std::vector<TrajectoryStore::Sample> samples;
+    uint64_t check = 0;
+    begin = Clock::now();
+    for (int i = 0; i != nb_queries; ++i)
+    {
+        samples.clear();
+        store.range(slot_of(i), tick_of(i), tick_of(i) + 1, samples);
+        check += samples.front().pos_.real().value_;
+    }
+    double range_rate = nb_queries / seconds(begin);
+
+    TrajectoryStore::Query query;
+    query.min_[TrajectoryStore::TYPE] = query.max_[TrajectoryStore::TYPE] = DRIFT;
+    begin = Clock::now();
+    for (int i = 0; i != nb_queries; ++i)
+    {
+        query.min_[TrajectoryStore::X] = first.slots_[slot_of(i) & ~1].pos_.real().value_ + fixed(i % 50).value_;
+        check += store.find_first(slot_of(i) & ~1, store.first_tick(), store.end_tick(), query).value_or(-1);
+    }
+    double find_rate = nb_queries / seconds(begin);
+
+    // stepping again, a few queries only
+    const int nb_steps = 4;
+    uint64_t stepped = 0;
+    begin = Clock::now();
+    for (int i = 0; i != nb_steps; ++i)
+    {
+        State st = first;
+        Stepper(world.level_).run(st, inputs.begin(), tick_of(i) - first.timestamp_);
+        stepped += st.slots_[slot_of(i)].pos_.real().value_;
+    }
+    double step_rate = nb_steps / seconds(begin);
+
+    uint64_t same = 0;
+    for (int i = 0; i != nb_steps; ++i)
+    {
+        samples.clear();
+        store.range(slot_of(i), tick_of(i), tick_of(i) + 1, samples);
+        same += samples.front().pos_.real().value_;
+    }
+
+    std::printf("query            store queries/s  stepping queries/s  speedup\n");
+    std::printf("%-15s  %15.0f  %18.1f  %7.0f\n", "position", range_rate, step_rate, range_rate / step_rate);
+    std::printf("%-15s  %15.0f  %18.1f  %7.0f\n", "first far tick", find_rate, step_rate, find_rate / step_rate);
+    std::printf("same answers : %s (%llu)\n", same == stepped ? "yes" : "no", (unsigned long long)check);
+    return 0;
+}
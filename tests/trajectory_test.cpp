@@ -0,0 +1,157 @@
+#include "stepper.h"
+#include "tests/test.h"
+#include "tests/toy_level.h"
+#include "trajectory.h"
+
+#include <memory>
+#include <optional>
+#include <vector>
+
+using namespace Toy;
+
+namespace
+{
+    using Inputs = std::vector<std::vector<KeyStrokes>>;
+    const int nb_ticks = 150;
+
+    /* the states of every tick, stepped without the store */
+    std::vector<State> states(const World &world, const State &first, const Inputs &inputs)
+    {
+        std::vector<State> result;
+        auto st = std::make_unique<State>(first);
+        Stepper stepper(world.level_);
+        stepper.run(*st, inputs.begin(), inputs.size(), [&result](const State &s) { result.push_back(s); });
+        return result;
+    }
+
+    bool same(const TrajectoryStore::Sample &sample, const State &st, int slot)
+    {
+        const auto &so = st.slots_[slot];
+        return sample.tick_ == int32_t(st.timestamp_)
+               && sample.pos_ == so.pos_
+               && sample.state_ == so.state_
+               && sample.type_ == (st.live(slot) ? so.type_ : 255)
+               && sample.contacts_ == so.contacts_;
+    }
+
+    /* every slot read back as the stepper left it, over several blocks,
+       and the searches agreeing with a scan of the states */
+    void round_trip()
+    {
+        World world;
+        Inputs inputs(nb_ticks, std::vector<KeyStrokes>(State::nb_players_));
+        auto st = World::crowd();
+        auto expected = states(world, *st, inputs);
+
+        TrajectoryStore store(16);
+        Stepper stepper(world.level_);
+        stepper.run(*st, inputs.begin(), nb_ticks, store);
+        CHECK(store.first_tick() == int32_t(expected.front().timestamp_));
+        CHECK(store.end_tick() == int32_t(expected.back().timestamp_) + 1);
+
+        std::vector<TrajectoryStore::Sample> samples;
+        for (int slot = 0; slot != State::nb_slots_; ++slot)
+        {
+            samples.clear();
+            store.range(slot, store.first_tick(), store.end_tick(), samples);
+            CHECK(samples.size() == expected.size());
+            for (size_t i = 0; i != samples.size() && i != expected.size(); ++i)
+                if (!same(samples[i], expected[i], slot))
+                {
+                    CHECK(same(samples[i], expected[i], slot));
+                    break;
+                }
+        }
+
+        // a part of a block, then a window across blocks
+        samples.clear();
+        store.range(4, store.first_tick() + 20, store.first_tick() + 53, samples);
+        CHECK(samples.size() == 33);
+        CHECK(!samples.empty() && same(samples.front(), expected[20], 4));
+
+        // a drift having moved 30 to the right
+        int found = 0;
+        for (int slot : {0, 2, 4, 40, 238})
+        {
+            TrajectoryStore::Query query;
+            query.min_[TrajectoryStore::X] = expected.front().slots_[slot].pos_.real().value_ + fixed(30).value_;
+            query.min_[TrajectoryStore::TYPE] = query.max_[TrajectoryStore::TYPE] = DRIFT;
+            std::optional<int32_t> scan;
+            for (const auto &s : expected)
+                if (s.live(slot) && s.slots_[slot].type_ == DRIFT
+                    && s.slots_[slot].pos_.real().value_ >= query.min_[TrajectoryStore::X])
+                {
+                    scan = s.timestamp_;
+                    break;
+                }
+            CHECK(store.find_first(slot, store.first_tick(), store.end_tick(), query) == scan);
+            found += scan.has_value();
+        }
+        CHECK(found != 0 && found != 5);
+    }
+
+    /* forgetting the last ticks, then recording them again, or going
+       back by recording an earlier tick */
+    void truncate()
+    {
+        World world;
+        Inputs inputs(nb_ticks, std::vector<KeyStrokes>(State::nb_players_));
+        auto st = World::crowd();
+        st->rng_ = RNG_COUNTER;
+        auto expected = states(world, *st, inputs);
+
+        TrajectoryStore store(16);
+        Stepper stepper(world.level_);
+        stepper.run(*st, inputs.begin(), nb_ticks, store);
+
+        const int kept = 37;
+        int32_t tick = store.first_tick() + kept;
+        store.truncate(tick);
+        CHECK(store.end_tick() == tick);
+        std::vector<TrajectoryStore::Sample> samples;
+        store.range(0, tick, tick + 10, samples);
+        CHECK(samples.empty());
+
+        *st = expected[kept - 1];
+        stepper.run(*st, inputs.begin(), nb_ticks - kept, store);
+        CHECK(store.end_tick() == int32_t(expected.back().timestamp_) + 1);
+        for (int slot : {0, 1, 3, 100, 255})
+        {
+            samples.clear();
+            store.range(slot, store.first_tick(), store.end_tick(), samples);
+            CHECK(samples.size() == expected.size());
+            bool all = samples.size() == expected.size();
+            for (size_t i = 0; all && i != samples.size(); ++i)
+                all = same(samples[i], expected[i], slot);
+            CHECK(all);
+        }
+
+        CHECK(store.record(expected[10]));
+        CHECK(store.end_tick() == int32_t(expected[10].timestamp_) + 1);
+        CHECK(!store.record(expected[12]));
+    }
+
+    /* the store counts under MEMORY_HISTORY, and gives it all back */
+    void memory()
+    {
+        World world;
+        Inputs inputs(nb_ticks, std::vector<KeyStrokes>(State::nb_players_));
+        int64_t before = MemoryCounters::current_[MEMORY_HISTORY];
+        {
+            TrajectoryStore store(16);
+            auto st = World::crowd();
+            Stepper stepper(world.level_);
+            stepper.run(*st, inputs.begin(), nb_ticks, store);
+            CHECK(MemoryCounters::current_[MEMORY_HISTORY] > before);
+        }
+        CHECK(MemoryCounters::current_[MEMORY_HISTORY] == before);
+    }
+}
+
+int main()
+{
+    round_trip();
+    truncate();
+    memory();
+    return failures() != 0;
+}
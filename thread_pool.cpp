@@ -0,0 +1,109 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(int nb_threads)
+{
+    nb_threads = std::max(1, nb_threads);
+    for (int i = 0; i != nb_threads; ++i)
+        queues_.emplace_back(std::make_unique<Queue>());
+    for (int i = 0; i != nb_threads; ++i)
+        threads_.emplace_back([this, i]() { work(i); });
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    for (auto &thread : threads_)
+        thread.join();
+}
+
+bool ThreadPool::pop(int worker, Task &task)
+{
+    int nb_queues = queues_.size();
+    for (int i = 0; i != nb_queues; ++i)
+    {
+        auto &queue = *queues_[(worker + i) % nb_queues];
+        std::lock_guard lock(queue.mutex_);
+        if (queue.tasks_.empty())
+            continue;
+        if (i == 0)
+        {
+            task = std::move(queue.tasks_.front());
+            queue.tasks_.pop_front();
+        }
+        else
+        {
+            task = std::move(queue.tasks_.back());
+            queue.tasks_.pop_back();
+        }
+        pending_--;
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::work(int worker)
+{
+    Task task;
+    while (true)
+    {
+        if (pop(worker, task))
+        {
+            task();
+            continue;
+        }
+
+        std::unique_lock lock(mutex_);
+        cv_.wait(lock, [this]() { return stop_ || pending_ > 0; });
+        if (stop_ && pending_ == 0)
+            return;
+    }
+}
+
+void ThreadPool::post(Task task)
+{
+    int worker = next_queue_++ % queues_.size();
+    {
+        auto &queue = *queues_[worker];
+        std::lock_guard lock(queue.mutex_);
+        queue.tasks_.emplace_back(std::move(task));
+        pending_++;
+    }
+    {
+        std::lock_guard lock(mutex_);
+    }
+    cv_.notify_one();
+}
+
+void ThreadPool::run(int nb_tasks, const std::function<void (int)> &task)
+{
+    /* the indices of this call only : the caller and the helpers take
+       them in turn, the caller never runs a task of someone else. A
+       helper dequeued after the end finds nothing left and returns */
+    struct Group
+    {
+        std::atomic<int> next_{0};
+        std::atomic<int> done_{0};
+    };
+    auto group = std::make_shared<Group>();
+    auto take = [group, nb_tasks, &task]()
+    {
+        for (int i = group->next_++; i < nb_tasks; i = group->next_++)
+        {
+            task(i);
+            group->done_++;
+        }
+    };
+
+    int nb_helpers = std::min<int>(nb_tasks - 1, threads_.size());
+    for (int i = 0; i < nb_helpers; ++i)
+        post(take);
+    take();
+    while (group->done_ != nb_tasks)
+        std::this_thread::yield();
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* work stealing pool : each worker pops from the front of its own queue,
+   and steals from the back of the others' when empty. The queues are
+   drained before the workers stop */
+class ThreadPool
+{
+    using Task = std::function<void ()>;
+
+    struct Queue
+    {
+        std::mutex mutex_;
+        std::deque<Task> tasks_;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> threads_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::atomic<int> pending_{0};
+    std::atomic<int> next_queue_{0};
+    bool stop_{false};
+
+    bool pop(int worker, Task &task);
+    void work(int worker);
+
+public:
+    explicit ThreadPool(int nb_threads = std::thread::hardware_concurrency());
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    int size() const
+    {
+        return threads_.size();
+    }
+
+    /* fire and forget */
+    void post(Task task);
+
+    /* calls task(i) for every i in [0, nb_tasks), returns once all are done.
+       The calling thread takes part, on these tasks only, so it may be
+       called from a task */
+    void run(int nb_tasks, const std::function<void (int)> &task);
+};
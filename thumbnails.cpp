@@ -0,0 +1,177 @@
+#include "thumbnails.h"
+#include "rasterizer.h"
+#include "thread_pool.h"
+
+#include <thread>
+
+namespace
+{
+    std::vector<uint32_t> encode(const std::vector<uint32_t> &pixels)
+    {
+        std::vector<uint32_t> runs;
+        for (size_t i = 0; i != pixels.size();)
+        {
+            size_t j = i + 1;
+            while (j != pixels.size() && pixels[j] == pixels[i])
+                ++j;
+            runs.push_back(j - i);
+            runs.push_back(pixels[i]);
+            i = j;
+        }
+        return runs;
+    }
+
+    std::vector<uint32_t> decode(const std::vector<uint32_t> &runs)
+    {
+        std::vector<uint32_t> pixels;
+        for (size_t i = 0; i + 1 < runs.size(); i += 2)
+            pixels.insert(pixels.end(), runs[i], runs[i + 1]);
+        return pixels;
+    }
+}
+
+ThumbnailCache::ThumbnailCache(const ObjData::Level &level,
+                               ThreadPool &pool,
+                               int w,
+                               int h,
+                               int scale,
+                               size_t budget,
+                               MemoryMonitor *monitor)
+    : level_(level), pool_(pool), w_(w), h_(h), scale_(scale), budget_(budget), monitor_(monitor)
+{
+    if (monitor_)
+        probe_ = monitor_->track(MEMORY_CACHES, [this] { return bytes(); });
+}
+
+ThumbnailCache::~ThumbnailCache()
+{
+    if (monitor_)
+        monitor_->untrack(probe_);
+    while (pending_)
+        std::this_thread::yield();
+}
+
+std::vector<uint32_t> ThumbnailCache::render(const State &st) const
+{
+    Point2D camera(st.xscreen_, st.yscreen_);
+    Point2D size(w_ * scale_, h_ * scale_);
+    // render() runs on the pool's threads
+    ObjData::SpriteIndex live;
+    std::vector<ObjData::SpriteInstance> sis;
+    level_.graphic(st, camera, size, live, sis);
+
+    Rasterizer rasterizer(w_ * scale_, h_ * scale_);
+    rasterizer.render(std::move(sis), camera);
+    const auto &fb = rasterizer.framebuffer();
+
+    // box filter
+    std::vector<uint32_t> pixels(w_ * h_);
+    int area = scale_ * scale_;
+    for (int y = 0; y != h_; ++y)
+    {
+        for (int x = 0; x != w_; ++x)
+        {
+            uint32_t sums[4] = {0, 0, 0, 0};
+            for (int j = 0; j != scale_; ++j)
+            {
+                for (int i = 0; i != scale_; ++i)
+                {
+                    uint32_t color = fb.color_[x * scale_ + i + (y * scale_ + j) * fb.w_];
+                    for (int c = 0; c != 4; ++c)
+                        sums[c] += color >> (8 * c) & 255;
+                }
+            }
+            uint32_t result = 0;
+            for (int c = 0; c != 4; ++c)
+                result |= (sums[c] / area) << (8 * c);
+            pixels[x + y * w_] = result;
+        }
+    }
+    return encode(pixels);
+}
+
+void ThumbnailCache::store(int tick, uint64_t epoch, std::vector<uint32_t> runs)
+{
+    std::lock_guard lock(mutex_);
+    for (const auto &invalidation : invalidations_)
+        if (invalidation.epoch_ >= epoch && invalidation.from_ <= tick)
+            return;
+
+    auto [it, inserted] = entries_.try_emplace(tick);
+    if (!inserted)
+    {
+        bytes_ -= it->second.runs_.size() * sizeof(uint32_t);
+        lru_.erase(it->second.lru_);
+    }
+    it->second.runs_ = std::move(runs);
+    bytes_ += it->second.runs_.size() * sizeof(uint32_t);
+    lru_.push_front(tick);
+    it->second.lru_ = lru_.begin();
+
+    while (bytes_ > budget_ && !lru_.empty())
+    {
+        auto victim = entries_.find(lru_.back());
+        bytes_ -= victim->second.runs_.size() * sizeof(uint32_t);
+        entries_.erase(victim);
+        lru_.pop_back();
+    }
+}
+
+void ThumbnailCache::request(int tick, std::shared_ptr<const State> st)
+{
+    uint64_t epoch;
+    {
+        std::lock_guard lock(mutex_);
+        if (entries_.count(tick))
+            return;
+        epoch = epoch_;
+        // counted along with the epoch : invalidate_from only forgets
+        // the invalidations no request in flight predates
+        pending_++;
+    }
+    pool_.post([this, tick, epoch, st = std::move(st)]()
+    {
+        store(tick, epoch, render(*st));
+        pending_--;
+    });
+}
+
+std::chrono::nanoseconds ThumbnailCache::populate(const std::vector<std::pair<int, std::shared_ptr<const State>>> &keyframes)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (const auto &[tick, st] : keyframes)
+        request(tick, st);
+    while (pending_)
+        std::this_thread::yield();
+    return std::chrono::steady_clock::now() - start;
+}
+
+void ThumbnailCache::invalidate_from(int tick)
+{
+    std::lock_guard lock(mutex_);
+    if (!pending_)
+        invalidations_.clear();
+    invalidations_.push_back({epoch_++, tick});
+    for (auto it = entries_.lower_bound(tick); it != entries_.end();)
+    {
+        bytes_ -= it->second.runs_.size() * sizeof(uint32_t);
+        lru_.erase(it->second.lru_);
+        it = entries_.erase(it);
+    }
+}
+
+std::optional<std::vector<uint32_t>> ThumbnailCache::get(int tick) const
+{
+    std::lock_guard lock(mutex_);
+    auto it = entries_.find(tick);
+    if (it == entries_.end())
+        return {};
+    lru_.splice(lru_.begin(), lru_, it->second.lru_);
+    return decode(it->second.runs_);
+}
+
+size_t ThumbnailCache::bytes() const
+{
+    std::lock_guard lock(mutex_);
+    return bytes_;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#include "data.h"
+#include "memory.h"
+
+class ThreadPool;
+
+/* downscaled renders of keyframes for the history scrubber, run length
+   encoded and kept within a memory budget */
+class ThumbnailCache
+{
+    struct Entry
+    {
+        std::vector<uint32_t> runs_; // count, color, count, color...
+        std::list<int>::iterator lru_;
+    };
+
+    struct Invalidation
+    {
+        uint64_t epoch_;
+        int from_;
+    };
+
+    const ObjData::Level &level_;
+    ThreadPool &pool_;
+    int w_, h_, scale_;
+    size_t budget_;
+
+    mutable std::mutex mutex_;
+    std::map<int, Entry> entries_;
+    mutable std::list<int> lru_;
+    size_t bytes_{0};
+    uint64_t epoch_{0};
+    std::vector<Invalidation> invalidations_;
+    std::atomic<int> pending_{0};
+    MemoryMonitor *monitor_;
+    int probe_{-1};
+
+    std::vector<uint32_t> render(const State &st) const;
+    void store(int tick, uint64_t epoch, std::vector<uint32_t> runs);
+
+public:
+    /* thumbnails of w * h, rendered at scale times their size, reported
+       to monitor under MEMORY_CACHES */
+    ThumbnailCache(const ObjData::Level &level,
+                   ThreadPool &pool,
+                   int w,
+                   int h,
+                   int scale,
+                   size_t budget,
+                   MemoryMonitor *monitor = nullptr);
+    ~ThumbnailCache();
+
+    /* renders in the background, unless already there. st is shared
+       with the render, not copied */
+    void request(int tick, std::shared_ptr<const State> st);
+
+    /* requests every keyframe and waits, returns the time it took */
+    std::chrono::nanoseconds populate(const std::vector<std::pair<int, std::shared_ptr<const State>>> &keyframes);
+
+    /* timeline edited at tick : drops every thumbnail from it on,
+       including the ones being rendered */
+    void invalidate_from(int tick);
+
+    /* w * h RGBA pixels */
+    std::optional<std::vector<uint32_t>> get(int tick) const;
+
+    size_t bytes() const;
+};
@@ -0,0 +1,293 @@
+#include "tile_map.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+    std::atomic<uint64_t> opened{0};
+
+    /* a thread's last chunk read */
+    struct Cursor
+    {
+        uint64_t map_{0};
+        int64_t index_{-1};
+        std::shared_ptr<const std::vector<uint16_t>> chunk_;
+    };
+
+    /* size bytes at offset, false on an error or the end of the file */
+    bool read_at(int fd, void *to, uint64_t size, uint64_t offset)
+    {
+        auto *bytes = static_cast<uint8_t *>(to);
+        while (size)
+        {
+            ssize_t got = pread(fd, bytes, size, offset);
+            if (got < 0 && errno == EINTR)
+                continue;
+            if (got <= 0)
+                return false;
+            bytes += got;
+            size -= got;
+            offset += got;
+        }
+        return true;
+    }
+}
+
+ChunkedMap::~ChunkedMap()
+{
+    close();
+}
+
+void ChunkedMap::close()
+{
+    while (prefetching_)
+        std::this_thread::yield();
+    {
+        std::lock_guard lock(mutex_);
+        lru_.clear();
+        resident_.clear();
+        in_flight_.clear();
+    }
+    if (fd_ >= 0)
+        ::close(fd_);
+    fd_ = -1;
+    directory_.clear();
+    w_ = h_ = 0;
+    w_chunks_ = h_chunks_ = 0;
+    chunk_bytes_ = 0;
+    id_ = 0;
+}
+
+bool ChunkedMap::open(const std::string &path,
+                      std::vector<const ObjData::AnimationData *> palette,
+                      size_t capacity,
+                      ThreadPool *pool)
+{
+    close();
+
+    fd_ = ::open(path.c_str(), O_RDONLY);
+    if (fd_ < 0)
+        return false;
+    struct stat info;
+    Header header;
+    if (fstat(fd_, &info) || static_cast<uint64_t>(info.st_size) < sizeof(Header)
+        || !read_at(fd_, &header, sizeof(header), 0))
+    {
+        close();
+        return false;
+    }
+    uint64_t size = info.st_size;
+    if (header.magic_ != magic_ || !header.chunk_size_
+        || header.w_ > INT_MAX || header.h_ > INT_MAX || header.chunk_size_ > INT_MAX)
+    {
+        close();
+        return false;
+    }
+
+    // below 2^62 chunks and 2^63 bytes a chunk, nothing overflows
+    uint64_t w_chunks = (uint64_t(header.w_) + header.chunk_size_ - 1) / header.chunk_size_;
+    uint64_t h_chunks = (uint64_t(header.h_) + header.chunk_size_ - 1) / header.chunk_size_;
+    uint64_t nb_chunks = w_chunks * h_chunks;
+    if (nb_chunks > (size - sizeof(Header)) / sizeof(uint64_t))
+    {
+        close();
+        return false;
+    }
+    directory_.resize(nb_chunks);
+    if (!read_at(fd_, directory_.data(), nb_chunks * sizeof(uint64_t), sizeof(Header)))
+    {
+        close();
+        return false;
+    }
+    chunk_bytes_ = uint64_t(header.chunk_size_) * header.chunk_size_ * sizeof(uint16_t);
+
+    // every chunk after the directory and inside the file
+    uint64_t first = sizeof(Header) + nb_chunks * sizeof(uint64_t);
+    for (uint64_t index = 0; index != nb_chunks; ++index)
+    {
+        uint64_t offset = directory_[index];
+        if (offset && (offset < first || offset > size || chunk_bytes_ > size - offset))
+        {
+            close();
+            return false;
+        }
+    }
+
+    w_ = header.w_;
+    h_ = header.h_;
+    chunk_size_ = header.chunk_size_;
+    w_chunks_ = w_chunks;
+    h_chunks_ = h_chunks;
+    id_ = ++opened;
+    palette_ = std::move(palette);
+    capacity_ = std::max<size_t>(1, capacity);
+    pool_ = pool;
+    return true;
+}
+
+bool ChunkedMap::write(const std::string &path,
+                       int w,
+                       int h,
+                       int chunk_size,
+                       const std::vector<uint16_t> &cells)
+{
+    int w_chunks = (w + chunk_size - 1) / chunk_size;
+    int h_chunks = (h + chunk_size - 1) / chunk_size;
+    Header header{magic_,
+                  static_cast<uint32_t>(w),
+                  static_cast<uint32_t>(h),
+                  static_cast<uint32_t>(chunk_size)};
+
+    std::vector<uint64_t> directory(w_chunks * h_chunks, 0);
+    std::vector<uint16_t> chunks;
+    uint64_t offset = sizeof(Header) + directory.size() * sizeof(uint64_t);
+    for (int y_chunk = 0; y_chunk != h_chunks; ++y_chunk)
+    {
+        for (int x_chunk = 0; x_chunk != w_chunks; ++x_chunk)
+        {
+            Chunk chunk(chunk_size * chunk_size, 0);
+            bool empty = true;
+            for (int y = 0; y != chunk_size; ++y)
+            {
+                for (int x = 0; x != chunk_size; ++x)
+                {
+                    int x_cell = x_chunk * chunk_size + x;
+                    int y_cell = y_chunk * chunk_size + y;
+                    if (x_cell >= w || y_cell >= h)
+                        continue;
+                    auto cell = cells[x_cell + y_cell * w];
+                    chunk[x + y * chunk_size] = cell;
+                    empty = empty && !cell;
+                }
+            }
+            if (empty)
+                continue;
+            directory[x_chunk + y_chunk * w_chunks] = offset;
+            offset += chunk.size() * sizeof(uint16_t);
+            chunks.insert(chunks.end(), chunk.begin(), chunk.end());
+        }
+    }
+
+    FILE *file = std::fopen(path.c_str(), "wb");
+    if (!file)
+        return false;
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1
+              && std::fwrite(directory.data(), sizeof(uint64_t), directory.size(), file) == directory.size()
+              && std::fwrite(chunks.data(), sizeof(uint16_t), chunks.size(), file) == chunks.size();
+    return std::fclose(file) == 0 && ok;
+}
+
+std::shared_ptr<const ChunkedMap::Chunk> ChunkedMap::chunk(int64_t index) const
+{
+    {
+        std::lock_guard lock(mutex_);
+        if (auto it = resident_.find(index); it != resident_.end())
+        {
+            lru_.splice(lru_.begin(), lru_, it->second);
+            return it->second->second;
+        }
+    }
+
+    // read outside of the lock, the disk is the slow part. A file cut
+    // short since open reads as an empty chunk
+    auto loaded = std::make_shared<Chunk>(chunk_bytes_ / sizeof(uint16_t));
+    if (!read_at(fd_, loaded->data(), chunk_bytes_, directory_[index]))
+        std::fill(loaded->begin(), loaded->end(), 0);
+
+    std::lock_guard lock(mutex_);
+    if (auto it = resident_.find(index); it != resident_.end())
+        return it->second->second;
+    lru_.emplace_front(index, loaded);
+    resident_[index] = lru_.begin();
+    while (lru_.size() > capacity_)
+    {
+        resident_.erase(lru_.back().first);
+        lru_.pop_back();
+    }
+    return loaded;
+}
+
+const ObjData::AnimationData *ChunkedMap::at(int x, int y) const
+{
+    thread_local Cursor cursor;
+    int64_t index = x / chunk_size_ + (y / chunk_size_) * w_chunks_;
+    if (cursor.map_ != id_ || cursor.index_ != index)
+    {
+        if (!directory_[index])
+            return nullptr;
+        cursor = {id_, index, chunk(index)};
+    }
+    auto cell = (*cursor.chunk_)[x % chunk_size_ + int64_t(y % chunk_size_) * chunk_size_];
+    if (!cell || cell > palette_.size())
+        return nullptr;
+    return palette_[cell - 1];
+}
+
+void ChunkedMap::prefetch(int64_t x_chunk, int64_t y_chunk) const
+{
+    if (x_chunk < 0 || y_chunk < 0 || x_chunk >= w_chunks_ || y_chunk >= h_chunks_)
+        return;
+    int64_t index = x_chunk + y_chunk * w_chunks_;
+    if (!directory_[index])
+        return;
+    {
+        // a resident chunk stays so, one already coming is not asked twice
+        std::lock_guard lock(mutex_);
+        if (auto it = resident_.find(index); it != resident_.end())
+        {
+            lru_.splice(lru_.begin(), lru_, it->second);
+            return;
+        }
+        if (!in_flight_.insert(index).second)
+            return;
+    }
+    prefetching_++;
+    pool_->post([this, index]()
+    {
+        chunk(index);
+        {
+            std::lock_guard lock(mutex_);
+            in_flight_.erase(index);
+        }
+        prefetching_--;
+    });
+}
+
+void ChunkedMap::focus(int x, int y) const
+{
+    if (!pool_ || directory_.empty())
+        return;
+    int dx, dy;
+    {
+        std::lock_guard lock(mutex_);
+        dx = (x > last_x_) - (x < last_x_);
+        dy = (y > last_y_) - (y < last_y_);
+        last_x_ = x;
+        last_y_ = y;
+    }
+
+    int64_t x_chunk = x / chunk_size_;
+    int64_t y_chunk = y / chunk_size_;
+    for (int j = -1; j <= 1; ++j)
+        for (int i = -1; i <= 1; ++i)
+            prefetch(x_chunk + i, y_chunk + j);
+    // one ring further where the camera goes
+    if (dx || dy)
+        for (int i = -1; i <= 1; ++i)
+            prefetch(x_chunk + 2 * dx + i * !dx, y_chunk + 2 * dy + i * !dy);
+}
+
+size_t ChunkedMap::resident() const
+{
+    std::lock_guard lock(mutex_);
+    return lru_.size();
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+class ThreadPool;
+
+namespace ObjData
+{
+    class AnimationData;
+}
+
+/* Tile map cut in chunks of chunk_size_ * chunk_size_ cells, read from a
+   file a chunk at a time. Empty chunks take no room, and only the most
+   recently used chunks stay resident : a chunk is read straight into its
+   cache entry, so evicting it frees its memory.
+
+   File layout :
+   Header, then one uint64_t offset per chunk (0 for an empty chunk),
+   then the chunks, chunk_size_ * chunk_size_ uint16_t each, row major.
+   A cell holds 0 when empty, 1 + its index in the palette otherwise.
+
+   Each thread keeps the last chunk it read, so that lookups in the same
+   chunk take neither the lock nor a reference. */
+class ChunkedMap
+{
+public:
+    static constexpr uint32_t magic_ = 0x50414d54; // TMAP
+
+    struct Header
+    {
+        uint32_t magic_;
+        uint32_t w_;
+        uint32_t h_;
+        uint32_t chunk_size_;
+    };
+
+private:
+    using Chunk = std::vector<uint16_t>;
+    using Entries = std::list<std::pair<int64_t, std::shared_ptr<const Chunk>>>;
+
+    int w_{0};
+    int h_{0};
+    int chunk_size_{1};
+    int64_t w_chunks_{0};
+    int64_t h_chunks_{0};
+    uint64_t chunk_bytes_{0};
+    // unique per open, tells the threads' last chunks apart
+    uint64_t id_{0};
+    std::vector<const ObjData::AnimationData *> palette_;
+
+    int fd_{-1};
+    std::vector<uint64_t> directory_;
+
+    size_t capacity_{0};
+    mutable std::mutex mutex_;
+    mutable Entries lru_;
+    mutable std::unordered_map<int64_t, Entries::iterator> resident_;
+    mutable std::unordered_set<int64_t> in_flight_;
+
+    ThreadPool *pool_{nullptr};
+    mutable std::atomic<int> prefetching_{0};
+    mutable int last_x_{0};
+    mutable int last_y_{0};
+
+    std::shared_ptr<const Chunk> chunk(int64_t index) const;
+    void prefetch(int64_t x_chunk, int64_t y_chunk) const;
+    void close();
+
+public:
+    ChunkedMap() = default;
+    ~ChunkedMap();
+
+    ChunkedMap(const ChunkedMap &) = delete;
+    ChunkedMap &operator=(const ChunkedMap &) = delete;
+
+    /* capacity is in chunks, pool is used for prefetching if any. Fails
+       on a header too large for the file or a chunk out of it */
+    bool open(const std::string &path,
+              std::vector<const ObjData::AnimationData *> palette,
+              size_t capacity,
+              ThreadPool *pool = nullptr);
+
+    static bool write(const std::string &path,
+                      int w,
+                      int h,
+                      int chunk_size,
+                      const std::vector<uint16_t> &cells);
+
+    int w() const
+    {
+        return w_;
+    }
+
+    int h() const
+    {
+        return h_;
+    }
+
+    /* nullptr for an empty cell, x and y must be inside the map */
+    const ObjData::AnimationData *at(int x, int y) const;
+
+    /* the camera is around cell (x, y) : keeps the chunks around it
+       resident, and loads ahead in the direction it moves to */
+    void focus(int x, int y) const;
+
+    size_t resident() const;
+};
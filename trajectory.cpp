@@ -0,0 +1,266 @@
+#include "trajectory.h"
+
+#include <algorithm>
+
+namespace
+{
+    using Bytes = TrajectoryStore::Buffer<uint8_t>;
+    using Values = TrajectoryStore::Buffer<int32_t>;
+
+    void put(Bytes &data, uint32_t value)
+    {
+        while (value >= 0x80)
+        {
+            data.push_back(value | 0x80);
+            value >>= 7;
+        }
+        data.push_back(value);
+    }
+
+    uint32_t get(const Bytes &data, size_t &offset)
+    {
+        uint32_t result = 0;
+        for (int shift = 0;; shift += 7)
+        {
+            uint8_t byte = data[offset++];
+            result |= uint32_t(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+                return result;
+        }
+    }
+
+    uint32_t zigzag(int32_t value)
+    {
+        return (uint32_t(value) << 1) ^ uint32_t(value >> 31);
+    }
+
+    int32_t unzigzag(uint32_t value)
+    {
+        return int32_t(value >> 1) ^ -int32_t(value & 1);
+    }
+
+    /* deltas, a zero delta being followed by the number of zeros after it */
+    void encode(const Values &values, Bytes &data)
+    {
+        uint32_t previous = 0;
+        for (size_t i = 0; i != values.size();)
+        {
+            uint32_t delta = zigzag(int32_t(uint32_t(values[i]) - previous));
+            previous = values[i];
+            put(data, delta);
+            ++i;
+            if (delta)
+                continue;
+            size_t run = 0;
+            while (i != values.size() && uint32_t(values[i]) == previous)
+            {
+                ++run;
+                ++i;
+            }
+            put(data, run);
+        }
+        data.shrink_to_fit();
+    }
+}
+
+TrajectoryStore::TrajectoryStore(int block_ticks)
+    : block_ticks_(block_ticks), tracks_(State::nb_slots_)
+{
+}
+
+void TrajectoryStore::decode(const Block &block, int column, Buffer<int32_t> &values)
+{
+    values.clear();
+    const auto &data = block.data_[column];
+    size_t offset = 0;
+    uint32_t previous = 0;
+    while (int(values.size()) != block.nb_ticks_)
+    {
+        uint32_t delta = get(data, offset);
+        previous += unzigzag(delta);
+        values.push_back(previous);
+        if (!delta)
+            values.insert(values.end(), get(data, offset), previous);
+    }
+}
+
+void TrajectoryStore::seal(Track &track)
+{
+    Block block;
+    block.first_tick_ = first_tick_ + int32_t(track.blocks_.size()) * block_ticks_;
+    block.nb_ticks_ = track.open_[0].size();
+    for (int column = 0; column != NUMBER_COLUMNS; ++column)
+    {
+        auto &values = track.open_[column];
+        auto [min, max] = std::minmax_element(values.begin(), values.end());
+        block.min_[column] = *min;
+        block.max_[column] = *max;
+        encode(values, block.data_[column]);
+        values.clear();
+    }
+
+    // union of the contacts rather than bounds
+    block.min_[CONTACTS] = 0;
+    block.max_[CONTACTS] = 0;
+    Buffer<int32_t> contacts;
+    decode(block, CONTACTS, contacts);
+    for (int32_t value : contacts)
+        block.max_[CONTACTS] |= value;
+
+    track.blocks_.push_back(std::move(block));
+}
+
+bool TrajectoryStore::record(const State &st)
+{
+    if (st.timestamp_ < end_tick() || !nb_ticks_)
+        truncate(st.timestamp_);
+    if (!nb_ticks_)
+        first_tick_ = st.timestamp_;
+    else if (st.timestamp_ != end_tick())
+        return false;
+
+    for (int slot = 0; slot != State::nb_slots_; ++slot)
+    {
+        const auto &so = st.slots_[slot];
+        auto &track = tracks_[slot];
+        track.open_[X].push_back(so.pos_.real().value_);
+        track.open_[Y].push_back(so.pos_.imag().value_);
+        track.open_[STATE].push_back(so.state_);
+        track.open_[TYPE].push_back(st.live(slot) ? so.type_ : 255);
+        track.open_[CONTACTS].push_back(so.contacts_);
+        if (int(track.open_[X].size()) == block_ticks_)
+            seal(track);
+    }
+    nb_ticks_++;
+    return true;
+}
+
+void TrajectoryStore::truncate(int32_t tick)
+{
+    if (tick >= end_tick())
+        return;
+    int32_t keep = std::max(tick - first_tick_, 0);
+    size_t nb_blocks = keep / block_ticks_;
+    size_t rest = keep % block_ticks_;
+
+    for (auto &track : tracks_)
+    {
+        if (rest && nb_blocks < track.blocks_.size())
+            for (int column = 0; column != NUMBER_COLUMNS; ++column)
+                decode(track.blocks_[nb_blocks], column, track.open_[column]);
+        for (auto &values : track.open_)
+            values.resize(rest);
+        track.blocks_.resize(nb_blocks);
+    }
+    nb_ticks_ = keep;
+}
+
+bool TrajectoryStore::may_match(const Block &block, const Query &query)
+{
+    for (int column = X; column != CONTACTS; ++column)
+        if (block.max_[column] < query.min_[column] || block.min_[column] > query.max_[column])
+            return false;
+    return (block.max_[CONTACTS] & query.contacts_) == query.contacts_;
+}
+
+void TrajectoryStore::range(int slot,
+                            int32_t from,
+                            int32_t to,
+                            std::vector<Sample> &result) const
+{
+    from = std::max(from, first_tick_);
+    to = std::min(to, end_tick());
+    if (from >= to)
+        return;
+
+    const auto &track = tracks_[slot];
+    std::array<Buffer<int32_t>, NUMBER_COLUMNS> values;
+    for (size_t b = (from - first_tick_) / block_ticks_; b <= track.blocks_.size(); ++b)
+    {
+        int32_t first = first_tick_ + int32_t(b) * block_ticks_;
+        if (first >= to)
+            break;
+        const auto &columns = b == track.blocks_.size() ? track.open_ : values;
+        if (b != track.blocks_.size())
+            for (int column = 0; column != NUMBER_COLUMNS; ++column)
+                decode(track.blocks_[b], column, values[column]);
+
+        int32_t begin = std::max(from, first) - first;
+        int32_t end = std::min<int32_t>(to - first, columns[X].size());
+        for (int32_t i = begin; i < end; ++i)
+            result.push_back({first + i,
+                              Point2D(fixed(columns[X][i], fixed::raw), fixed(columns[Y][i], fixed::raw)),
+                              uint8_t(columns[STATE][i]),
+                              uint8_t(columns[TYPE][i]),
+                              uint32_t(columns[CONTACTS][i])});
+    }
+}
+
+std::optional<int32_t> TrajectoryStore::find_first(int slot,
+                                                   int32_t from,
+                                                   int32_t to,
+                                                   const Query &query) const
+{
+    from = std::max(from, first_tick_);
+    to = std::min(to, end_tick());
+    if (from >= to)
+        return {};
+
+    // only the columns the query constrains are decoded
+    std::vector<int> constrained;
+    for (int column = X; column != CONTACTS; ++column)
+        if (query.min_[column] != std::numeric_limits<int64_t>::min()
+            || query.max_[column] != std::numeric_limits<int64_t>::max())
+            constrained.push_back(column);
+    if (query.contacts_)
+        constrained.push_back(CONTACTS);
+
+    const auto &track = tracks_[slot];
+    std::array<Buffer<int32_t>, NUMBER_COLUMNS> values;
+    for (size_t b = (from - first_tick_) / block_ticks_; b <= track.blocks_.size(); ++b)
+    {
+        int32_t first = first_tick_ + int32_t(b) * block_ticks_;
+        if (first >= to)
+            break;
+        bool open = b == track.blocks_.size();
+        if (!open && !may_match(track.blocks_[b], query))
+            continue;
+        const auto &columns = open ? track.open_ : values;
+        if (!open)
+            for (int column : constrained)
+                decode(track.blocks_[b], column, values[column]);
+
+        int32_t begin = std::max(from, first) - first;
+        int32_t end = std::min(to - first, open ? int32_t(track.open_[X].size()) : track.blocks_[b].nb_ticks_);
+        for (int32_t i = begin; i < end; ++i)
+        {
+            bool match = std::all_of(constrained.begin(),
+                                     constrained.end(),
+                                     [&](int column)
+                                     {
+                                         int64_t value = columns[column][i];
+                                         if (column == CONTACTS)
+                                             return (uint32_t(value) & query.contacts_) == query.contacts_;
+                                         return value >= query.min_[column] && value <= query.max_[column];
+                                     });
+            if (match)
+                return first + i;
+        }
+    }
+    return {};
+}
+
+size_t TrajectoryStore::bytes() const
+{
+    size_t result = sizeof(*this);
+    for (const auto &track : tracks_)
+    {
+        result += sizeof(Track) + track.blocks_.capacity() * sizeof(Block);
+        for (const auto &block : track.blocks_)
+            for (const auto &data : block.data_)
+                result += data.capacity();
+        for (const auto &values : track.open_)
+            result += values.capacity() * sizeof(int32_t);
+    }
+    return result;
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <vector>
+
+#include "data.h"
+#include "memory.h"
+
+/* History of every slot, one tick after the other, for ghost trails and
+   queries such as "when did object 12 first touch GROUND".
+
+   One track per slot, cut in blocks of block_ticks_ ticks. In a block,
+   every column is delta coded then packed in varints, a run of equal
+   values taking two bytes. Each block keeps the min and max of its
+   columns and the union of its contacts, so that searches skip the
+   blocks that cannot match without decoding them. Held under
+   MEMORY_HISTORY.
+
+   Fed by the stepper, as the observer of every tick :
+       stepper.run(st, inputs, nb_ticks, store); */
+class TrajectoryStore
+{
+public:
+    template <typename T>
+    using Buffer = std::vector<T, TaggedAllocator<T, MEMORY_HISTORY>>;
+
+    enum Column
+    {
+        X,        // raw fixed
+        Y,
+        STATE,
+        TYPE,     // 255 for a free slot
+        CONTACTS, // see StateObject::contacts_
+        NUMBER_COLUMNS
+    };
+
+    struct Sample
+    {
+        int32_t tick_;
+        Point2D pos_;
+        uint8_t state_;
+        uint8_t type_;
+        uint32_t contacts_;
+    };
+
+    /* every bound holds, and every bit of contacts_ is set */
+    struct Query
+    {
+        std::array<int64_t, NUMBER_COLUMNS> min_;
+        std::array<int64_t, NUMBER_COLUMNS> max_;
+        uint32_t contacts_{0};
+
+        Query()
+        {
+            min_.fill(std::numeric_limits<int64_t>::min());
+            max_.fill(std::numeric_limits<int64_t>::max());
+        }
+    };
+
+private:
+    struct Block
+    {
+        int32_t first_tick_;
+        int nb_ticks_;
+        std::array<int32_t, NUMBER_COLUMNS> min_;
+        std::array<int32_t, NUMBER_COLUMNS> max_;
+        std::array<Buffer<uint8_t>, NUMBER_COLUMNS> data_;
+    };
+
+    struct Track
+    {
+        Buffer<Block> blocks_;
+        // the last ticks, not packed yet
+        std::array<Buffer<int32_t>, NUMBER_COLUMNS> open_;
+    };
+
+    int block_ticks_;
+    int32_t first_tick_{0};
+    int32_t nb_ticks_{0};
+    Buffer<Track> tracks_;
+
+    void seal(Track &track);
+    static void decode(const Block &block, int column, Buffer<int32_t> &values);
+    static bool may_match(const Block &block, const Query &query);
+
+public:
+    explicit TrajectoryStore(int block_ticks = 256);
+
+    /* to be called after each compute. st.timestamp_ must follow the
+       last tick recorded ; an earlier one first truncates the history
+       there. False on a gap */
+    bool record(const State &st);
+
+    /* record, for Stepper::run. Every tick is to be observed */
+    void operator()(const State &st)
+    {
+        record(st);
+    }
+
+    /* forgets tick and the following ones */
+    void truncate(int32_t tick);
+
+    int32_t first_tick() const
+    {
+        return first_tick_;
+    }
+
+    /* one past the last tick recorded */
+    int32_t end_tick() const
+    {
+        return first_tick_ + nb_ticks_;
+    }
+
+    /* samples of slot for the ticks in [from, to) */
+    void range(int slot, int32_t from, int32_t to, std::vector<Sample> &result) const;
+
+    /* first tick in [from, to) where slot matches query */
+    std::optional<int32_t> find_first(int slot,
+                                      int32_t from,
+                                      int32_t to,
+                                      const Query &query) const;
+
+    size_t bytes() const;
+};